@@ -0,0 +1,39 @@
+# /****************************************************************************
+#             bench.sh
+#  *
+#  * Assignment: asmcoding
+#  * Authors: Jack Adkins, Seth Gellman
+#  * Date: 12/11/24
+#  *
+#  * Summary:
+#  * Assembles the RPN calculator and times it on a scaled up version of the
+#  * kind of input in test.ums, then on printing a 100,000-deep value stack.
+#  * Takes the number of input lines (default 1,000,000) and the number of
+#  * times to print the deep stack (default 10) as optional arguments.
+# ****************************************************************************/
+
+lines=${1:-1000000}
+prints=${2:-10}
+
+umasm urt0.ums calc40.ums printd.ums callmain.ums > calc40.um || exit 1
+
+# every line leaves the value stack empty, so all of the time is spent reading
+# numbers and dispatching operators rather than printing
+yes "12345 678 + 90 * 4321 - 17 / c d 255 & | 3 s - p z" | head -n $lines \
+        > bench.in
+
+echo "Input: $lines lines, $(wc -c < bench.in) bytes"
+time um calc40.um < bench.in > /dev/null
+
+# 100,000 numbers (every other one negated) followed by a newline per print
+awk -v prints=$prints 'BEGIN {
+        for (i = 1; i <= 100000; i++)
+                printf "%d%s ", i * 21474, (i % 2 ? "c" : "");
+        for (i = 0; i < prints; i++)
+                print "";
+}' > bench.in
+
+echo "Printing a 100000-deep stack $prints times"
+time um calc40.um < bench.in > /dev/null
+
+rm -f bench.in
@@ -1,13 +1,58 @@
-#include <string.h>
-#include <stdlib.h>
+/*
+*     40image.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*     
+*     Command line program to compress and decompress ppm images
+*/
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "assert.h"
 #include "compress40.h"
+#include "codec40.h"
+#include "tiled.h"
 
-static void (*compress_or_decompress)(FILE *input) = compress40;
+#define MAX_THREADS 256
 
+/********** main ********
+ *
+ * Handles and runs the compression and decompression
+ *
+ * Parameters:
+ *      int argc: the number of arguments provided
+ *      char *argv[]: array of the arguments provided           
+ *
+ * Return:
+ *      EXIT_SUCCESS if run to completion
+ * 
+ * Expects:
+ *      - A single file for compression or decompression is given
+ *      - A command specifying compression or decompression is given
+ *
+ * Notes: 
+ *      - "-j N" splits the work between N threads; the output is the same
+ *        for any N
+ *      - "-f" uses integers only (see fixed.h) instead of floats; the code
+ *        words are in the same format either way
+ *      - "--stats" prints how long each stage took to stderr
+ *      - "--tiled" compresses to format 3 (see tiled.h), and "--checksum"
+ *        does too, with a CRC-32C for every tile
+ *      - "--entropy" compresses to format 3 too, entropy coding every tile
+ *        (see entropy.h)
+ *      - "--crop WxH+X+Y" decompresses only that part of the image; only
+ *        the tiles it needs are read from a format 3 image
+ *      - "--preview" decompresses to half the width and height, a pixel 
+ *        per code word
+ *      - everything else is in compress40.c, which programs that hold 
+ *        their images in memory can use without this (see codec40.h)
+ *      
+ ************************/
 int main(int argc, char *argv[])
 {
+        void (*compress_or_decompress)(FILE *input) = compress40;
+        struct Codec40_options options = { .threads = 1 };
         int i;
 
         for (i = 1; i < argc; i++) {
@@ -15,20 +60,65 @@ int main(int argc, char *argv[])
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                } else if (strcmp(argv[i], "-j") == 0) {
+                        char *end = NULL;
+                        long n = i + 1 < argc ? strtol(argv[++i], &end, 10)
+                                              : 0;
+                        if (n < 1 || n > MAX_THREADS || *end != '\0') {
+                                fprintf(stderr, "%s: -j needs a number of "
+                                        "threads from 1 to %d\n", argv[0], 
+                                        MAX_THREADS);
+                                exit(1);
+                        }
+                        options.threads = n;
+                } else if (strcmp(argv[i], "-f") == 0) {
+                        options.fixedPoint = true;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        options.stats = true;
+                } else if (strcmp(argv[i], "--tiled") == 0) {
+                        options.tiled = true;
+                } else if (strcmp(argv[i], "--checksum") == 0) {
+                        options.tiled = true;
+                        options.tiledFlags |= TILED_CHECKSUMS;
+                } else if (strcmp(argv[i], "--entropy") == 0) {
+                        options.tiled = true;
+                        options.tiledFlags |= TILED_ENTROPY;
+                } else if (strcmp(argv[i], "--crop") == 0) {
+                        int end = 0;
+                        if (i + 1 >= argc || 
+                            sscanf(argv[++i], "%ux%u+%u+%u%n", 
+                                   &options.cropWidth, &options.cropHeight,
+                                   &options.cropX, &options.cropY, 
+                                   &end) != 4 ||
+                            argv[i][end] != '\0' || 
+                            options.cropWidth == 0 || 
+                            options.cropHeight == 0) {
+                                fprintf(stderr, "%s: --crop needs a "
+                                        "rectangle like 64x48+0+16\n", 
+                                        argv[0]);
+                                exit(1);
+                        }
+                        options.cropping = true;
+                } else if (strcmp(argv[i], "--preview") == 0) {
+                        options.preview = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
+                        fprintf(stderr, "Usage: %s -d [-j N] [-f] [--stats] "
+                                "[--crop WxH+X+Y] [--preview] [filename]\n"
+                                "       %s -c [-j N] [-f] [--stats] "
+                                "[--tiled] [--checksum] [--entropy] "
+                                "[filename]\n",
                                 argv[0], argv[0]);
                         exit(1);
                 } else {
                         break;
                 }
         }
-        assert(argc - i <= 1);    /* at most one file on command line */
+        assert(argc - i <= 1);
+        Codec40_set(&options);
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
                 assert(fp != NULL);
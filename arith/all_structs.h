@@ -9,27 +9,113 @@
 #ifndef ALL_STRUCTS_H
 #define ALL_STRUCTS_H
 
+#include <stdio.h>
+#include <stdbool.h>
 #include <inttypes.h>
-#include "a2methods.h"
-#include "a2plain.h"
-#include "uarray2.h"
+#include "tiled.h"
 
-typedef struct cvc_closure *cvc_closure; 
 typedef struct cw_data *cw_data; 
 
-/*Struct to store useful data for converting between RBG and CVC
-colorspace format and vice versa*/
-struct cvc_closure{
-        A2Methods_UArray2 pix;
-        int rgb_denom;
-        A2Methods_T methods;
+/*Struct to represent a row of pixels in component video color format,
+one array per component so the row can be converted several pixels at a
+time*/
+struct cvc_row{
+        float *y;
+        float *b;
+        float *r;
 };
 
-/*Struct to represent a pixel in component video color format*/
-struct Pnm_cvc{
-        float y;
-        float b;
-        float r;
+/*Struct to represent a row of pixels in fixed point component video color
+format (see fixed.h), one array per component*/
+struct fixed_row{
+        int32_t *y;
+        int32_t *b;
+        int32_t *r;
+};
+
+/*Struct to hold the fields of a row of code words, one array per field
+so the whole row can be packed or unpacked at once*/
+struct cw_row{
+        uint32_t *a;
+        int32_t *b;
+        int32_t *c;
+        int32_t *d;
+        uint32_t *Pb;
+        uint32_t *Pr;
+};
+
+/*Struct to read a PPM image a few rows at a time during compression, so
+only the rows being packed are ever in memory*/
+struct ppm_reader{
+        FILE *fp;
+        unsigned width;
+        unsigned height;
+        unsigned denominator;
+        bool plain;
+};
+
+/*Stages of compression and decompression, timed for --stats*/
+enum stage{
+        STAGE_READ,
+        STAGE_COLOR,
+        STAGE_DCT,
+        STAGE_BITPACK,
+        STAGE_WRITE,
+        STAGES
+};
+
+/*Struct for the band of rows one thread works on. Compression turns the
+'rows' rows of samples at 'raw' into the bytes of codewords at 'packed';
+decompression turns the bytes at 'source' into pixels at 'raw', or into 
+half as many rows of half as many pixels for a 'preview'; an entropy coded
+tile is decoded into 'packed' first. The rest is the thread's own space,
+all carved out of 'scratch' (see carveBand)*/
+struct band{
+        unsigned rows;
+        unsigned char *raw;
+        unsigned char *packed;
+        const unsigned char *source;
+        bool preview;
+
+        unsigned width;
+        size_t stride;
+        bool wide;
+        float denominator;
+        bool fixedPoint;
+
+        unsigned char *scratch;
+        uint16_t *red;
+        uint16_t *green;
+        uint16_t *blue;
+        struct cvc_row top;
+        struct cvc_row bottom;
+        struct fixed_row fixedTop;
+        struct fixed_row fixedBottom;
+        struct cw_row fields;
+        uint32_t *words;
+        double seconds[STAGES];
+};
+
+/*Struct for a rectangle of pixels, like the part of an image --crop
+asks for*/
+struct rect{
+        unsigned x;
+        unsigned y;
+        unsigned width;
+        unsigned height;
+};
+
+/*Struct for the tiles of a row of tiles one thread decompresses: every
+'step'th one from 'first' up to 'end', into its columns of 'pixels'*/
+struct tile_job{
+        struct band *band;
+        Tiled_T tiles;
+        unsigned row;
+        unsigned first;
+        unsigned end;
+        unsigned step;
+        unsigned tileWidth;
+        unsigned char *pixels;
 };
 
 /*Struct to hold the values throughout the decompression step*/
@@ -0,0 +1,52 @@
+/*
+*     codec40.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for compressing and decompressing images that are already
+*     in memory, and for choosing how compress40 and decompress40 run; all
+*     of it is in compress40.c
+*/
+
+#ifndef CODEC40_INCLUDED
+#define CODEC40_INCLUDED
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*How compress40 and decompress40 run (see 40image.c for the options that
+set each one); the buffer functions below don't use any of it*/
+struct Codec40_options{
+        unsigned threads;
+        bool fixedPoint;
+        bool stats;
+        bool tiled;
+        unsigned tiledFlags;
+        bool cropping;
+        unsigned cropX;
+        unsigned cropY;
+        unsigned cropWidth;
+        unsigned cropHeight;
+        bool preview;
+};
+
+extern void Codec40_set(const struct Codec40_options *options);
+
+/*Pixels are rows 'stride' bytes apart of red, green and blue samples, one
+byte each, or two bytes big-endian when the denominator is over 255, like
+the rows of a raw PPM. Compressed images are in format 2, byte for byte
+what compress40 writes. 'scratch' is Codec40_scratch_size bytes the
+functions work in, or NULL to have them allocate it*/
+extern size_t Codec40_scratch_size(unsigned width);
+extern size_t Codec40_compressed_size(unsigned width, unsigned height);
+extern size_t Codec40_compress(const unsigned char *pixels, unsigned width,
+unsigned height, size_t stride, unsigned denominator, unsigned char *out,
+size_t size, void *scratch);
+
+/*Decompressed pixels are one byte a sample, with a denominator of 255*/
+extern bool Codec40_geometry(const unsigned char *in, size_t size,
+unsigned *width, unsigned *height);
+extern void Codec40_decompress(const unsigned char *in, size_t size,
+unsigned char *pixels, size_t stride, void *scratch);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+*     codeword.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for packing and unpacking rows of code words,
+*     4 at a time with SSE2 where there is SSE2
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "codeword.h"
+
+#if defined(__SSE2__)
+#define CODEWORD_SIMD
+#include <emmintrin.h>
+
+/*Same as CW_PUT, CW_GETU and CW_GETS, for 4 code words at once*/
+#define CW_PUT4(field, values) \
+        _mm_slli_epi32(_mm_and_si128(_mm_loadu_si128( \
+                (const __m128i *)(values)), _mm_set1_epi32(CW_MASK(field))), \
+                CW_##field##_LSB)
+#define CW_GETU4(field, words) \
+        _mm_and_si128(_mm_srli_epi32(words, CW_##field##_LSB), \
+                      _mm_set1_epi32(CW_MASK(field)))
+#define CW_GETS4(field, words) \
+        _mm_srai_epi32(_mm_slli_epi32(words, \
+                32 - CW_##field##_LSB - CW_##field##_WIDTH), \
+                32 - CW_##field##_WIDTH)
+#endif
+
+/********** Codeword_pack_many ********
+ *
+ * packs a row of code words
+ *
+ * Parameters:
+ *      const struct cw_row *fields:    the fields of each code word
+ *      unsigned count:                 how many code words to pack
+ *      uint32_t *codewords:            where to put the code words
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every array has room for 'count' values
+ *      - every value fits in its field: a, Pb and Pr unsigned, b, c and d
+ *        signed
+ *
+ * Notes:
+ *      - unlike Bitpack_newu and Bitpack_news, nothing is checked; bits of
+ *        a value that don't fit are dropped
+ *
+ ************************/
+void Codeword_pack_many(const struct cw_row *fields, unsigned count,
+uint32_t *codewords)
+{
+        unsigned i = 0;
+#ifdef CODEWORD_SIMD
+        for (; i + 4 <= count; i += 4) {
+                __m128i words = _mm_or_si128(
+                        _mm_or_si128(CW_PUT4(A, &fields->a[i]),
+                                     CW_PUT4(B, &fields->b[i])),
+                        _mm_or_si128(CW_PUT4(C, &fields->c[i]),
+                                     CW_PUT4(D, &fields->d[i])));
+                words = _mm_or_si128(words,
+                        _mm_or_si128(CW_PUT4(PB, &fields->Pb[i]),
+                                     CW_PUT4(PR, &fields->Pr[i])));
+                _mm_storeu_si128((__m128i *)&codewords[i], words);
+        }
+#endif
+        for (; i < count; i++) {
+                codewords[i] = Codeword_pack(fields->a[i], fields->b[i],
+                                             fields->c[i], fields->d[i],
+                                             fields->Pb[i], fields->Pr[i]);
+        }
+}
+
+/********** Codeword_unpack_many ********
+ *
+ * unpacks a row of code words
+ *
+ * Parameters:
+ *      const uint32_t *codewords:      the code words
+ *      unsigned count:                 how many code words to unpack
+ *      struct cw_row *fields:          where to put the fields
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every array has room for 'count' values
+ *
+ * Notes:
+ *      - b, c and d are sign extended
+ *
+ ************************/
+void Codeword_unpack_many(const uint32_t *codewords, unsigned count,
+struct cw_row *fields)
+{
+        unsigned i = 0;
+#ifdef CODEWORD_SIMD
+        for (; i + 4 <= count; i += 4) {
+                __m128i words = _mm_loadu_si128((const __m128i *)&codewords[i]);
+                _mm_storeu_si128((__m128i *)&fields->a[i], CW_GETU4(A, words));
+                _mm_storeu_si128((__m128i *)&fields->b[i], CW_GETS4(B, words));
+                _mm_storeu_si128((__m128i *)&fields->c[i], CW_GETS4(C, words));
+                _mm_storeu_si128((__m128i *)&fields->d[i], CW_GETS4(D, words));
+                _mm_storeu_si128((__m128i *)&fields->Pb[i],
+                                 CW_GETU4(PB, words));
+                _mm_storeu_si128((__m128i *)&fields->Pr[i],
+                                 CW_GETU4(PR, words));
+        }
+#endif
+        for (; i < count; i++) {
+                uint32_t word = codewords[i];
+                fields->a[i] = CW_GETU(A, word);
+                fields->b[i] = CW_GETS(B, word);
+                fields->c[i] = CW_GETS(C, word);
+                fields->d[i] = CW_GETS(D, word);
+                fields->Pb[i] = CW_GETU(PB, word);
+                fields->Pr[i] = CW_GETU(PR, word);
+        }
+}
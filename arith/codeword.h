@@ -0,0 +1,53 @@
+/*
+*     codeword.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Layout of a 32-bit code word, with packing and unpacking for one code
+*     word or a whole row of them
+*/
+
+#ifndef CODEWORD_INCLUDED
+#define CODEWORD_INCLUDED
+
+#include <stdint.h>
+#include "all_structs.h"
+
+/*Width and least significant bit of each field of a code word*/
+#define CW_A_WIDTH      6
+#define CW_A_LSB        26
+#define CW_B_WIDTH      6
+#define CW_B_LSB        20
+#define CW_C_WIDTH      6
+#define CW_C_LSB        14
+#define CW_D_WIDTH      6
+#define CW_D_LSB        8
+#define CW_PB_WIDTH     4
+#define CW_PB_LSB       4
+#define CW_PR_WIDTH     4
+#define CW_PR_LSB       0
+
+#define CW_MASK(field) ((UINT32_C(1) << CW_##field##_WIDTH) - 1)
+
+/*Puts a value in a field, gets an unsigned field and gets a signed field*/
+#define CW_PUT(field, value) \
+        (((uint32_t)(value) & CW_MASK(field)) << CW_##field##_LSB)
+#define CW_GETU(field, word) (((word) >> CW_##field##_LSB) & CW_MASK(field))
+#define CW_GETS(field, word) \
+        ((int32_t)((word) << (32 - CW_##field##_LSB - CW_##field##_WIDTH)) \
+         >> (32 - CW_##field##_WIDTH))
+
+/*Packs the fields of one code word; each value has to fit in its field*/
+static inline uint32_t Codeword_pack(uint32_t a, int32_t b, int32_t c,
+int32_t d, uint32_t Pb, uint32_t Pr)
+{
+        return CW_PUT(A, a) | CW_PUT(B, b) | CW_PUT(C, c) | CW_PUT(D, d) |
+               CW_PUT(PB, Pb) | CW_PUT(PR, Pr);
+}
+
+extern void Codeword_pack_many(const struct cw_row *fields, unsigned count,
+uint32_t *codewords);
+extern void Codeword_unpack_many(const uint32_t *codewords, unsigned count,
+struct cw_row *fields);
+
+#endif
@@ -0,0 +1,449 @@
+/*
+*     color.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for converting rows of pixels between RGB and
+*     component video color (CVC), using SSE4.1 or AVX2 when the CPU has it
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "color.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COLOR_SIMD
+#include <immintrin.h>
+#endif
+
+static void rgbToCVC_scalar(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr);
+static void cvcToRGB_scalar(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb);
+
+#ifdef COLOR_SIMD
+static void rgbToCVC_sse41(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr);
+static void cvcToRGB_sse41(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb);
+static void rgbToCVC_avx2(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr);
+static void cvcToRGB_avx2(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb);
+#endif
+
+
+/********** Color_rgb_to_cvc ********
+ *
+ * converts a row of RGB pixels to CVC
+ *
+ * Parameters:
+ *      const uint16_t *red, *green, *blue: the pixels' RGB values
+ *      unsigned count:                     how many pixels to convert
+ *      float dnm:                          denominator of the RGB values
+ *      float *y, *pb, *pr:                 where to put the CVC values
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every array has room for 'count' values
+ *      - 'dnm' is not 0
+ *
+ * Notes:
+ *      - picks the widest version the CPU supports; all of them give the
+ *        same answers, bit for bit
+ *
+ ************************/
+void Color_rgb_to_cvc(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr)
+{
+#ifdef COLOR_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                rgbToCVC_avx2(red, green, blue, count, dnm, y, pb, pr);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                rgbToCVC_sse41(red, green, blue, count, dnm, y, pb, pr);
+                return;
+        }
+#endif
+        rgbToCVC_scalar(red, green, blue, count, dnm, y, pb, pr);
+}
+
+/********** Color_cvc_to_rgb ********
+ *
+ * converts a row of CVC pixels to RGB
+ *
+ * Parameters:
+ *      const float *y, *pb, *pr: the pixels' CVC values
+ *      unsigned count:           how many pixels to convert
+ *      float dnm:                denominator to scale RGB values
+ *      unsigned char *rgb:       where to put the red, green and blue bytes
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'rgb' has room for 3 * 'count' bytes
+ *      - 'dnm' is at most 255, so each value fits in a byte
+ *
+ * Notes:
+ *      - picks the widest version the CPU supports; all of them give the
+ *        same answers, bit for bit
+ *
+ ************************/
+void Color_cvc_to_rgb(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb)
+{
+#ifdef COLOR_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                cvcToRGB_avx2(y, pb, pr, count, dnm, rgb);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                cvcToRGB_sse41(y, pb, pr, count, dnm, rgb);
+                return;
+        }
+#endif
+        cvcToRGB_scalar(y, pb, pr, count, dnm, rgb);
+}
+
+/********** rgbToCVC_scalar ********
+ *
+ * converts a row of RGB pixels to CVC one pixel at a time
+ *
+ * Parameters: see Color_rgb_to_cvc
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - the same as Color_rgb_to_cvc
+ *
+ * Notes:
+ *      - the vector versions use this for the pixels left over at the end
+ *        of a row
+ *
+ ************************/
+static void rgbToCVC_scalar(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr)
+{
+        for (unsigned i = 0; i < count; i++) {
+                float r = red[i] / dnm;
+                float g = green[i] / dnm;
+                float b = blue[i] / dnm;
+
+                y[i] = 0.299 * r + 0.587 * g + 0.114 * b;
+                pb[i] = -0.168736 * r - 0.331264 * g + 0.5 * b;
+                pr[i] = 0.5 * r - 0.418688 * g - 0.081312 * b;
+        }
+}
+
+/********** cvcToRGB_scalar ********
+ *
+ * converts a row of CVC pixels to RGB one pixel at a time
+ *
+ * Parameters: see Color_cvc_to_rgb
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - the same as Color_cvc_to_rgb
+ *
+ * Notes:
+ *      - the vector versions use this for the pixels left over at the end
+ *        of a row
+ *
+ ************************/
+static void cvcToRGB_scalar(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb)
+{
+        for (unsigned i = 0; i < count; i++) {
+                float toR = (1.0 * y[i] + 0.0 * pb[i] + 1.402 * pr[i]);
+                float toG = (1.0 * y[i] - 0.344136 * pb[i] - 0.714136 * pr[i]);
+                float toB = (1.0 * y[i] + 1.772 * pb[i] + 0.0 * pr[i]);
+
+                /*Check for edge cases where RGB values get our of range*/
+                if (toR < 0) {
+                        toR = 0.0;
+                }
+                if (toR > 1) {
+                        toR = 1.0;
+                }
+                if (toG < 0) {
+                        toG = 0.0;
+                }
+                if (toG > 1) {
+                        toG = 1.0;
+                }
+                if (toB < 0) {
+                        toB = 0.0;
+                }
+                if (toB > 1) {
+                        toB = 1.0;
+                }
+
+                rgb[i * 3] = (int)(toR * dnm);
+                rgb[i * 3 + 1] = (int)(toG * dnm);
+                rgb[i * 3 + 2] = (int)(toB * dnm);
+        }
+}
+
+#ifdef COLOR_SIMD
+
+/*
+ * The vector versions do the same operations in the same order as the
+ * scalar ones: samples are divided by the denominator as floats, the sums
+ * are done in double (c0 * u + c1 * v) + c2 * w and rounded back to float,
+ * so the output doesn't depend on which version ran. 'a - c * v' is done
+ * as 'a + (-c) * v', which is exactly the same in IEEE arithmetic.
+ */
+
+/********** sumOf2 ********
+ *
+ * computes (c0 * u + c1 * v) + c2 * w for 2 doubles at once
+ *
+ ************************/
+__attribute__((target("sse4.1")))
+static inline __m128d sumOf2(__m128d u, __m128d v, __m128d w, double c0,
+double c1, double c2)
+{
+        __m128d uv = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(c0), u),
+                                _mm_mul_pd(_mm_set1_pd(c1), v));
+        return _mm_add_pd(uv, _mm_mul_pd(_mm_set1_pd(c2), w));
+}
+
+/********** sumOf4 ********
+ *
+ * computes (c0 * u + c1 * v) + c2 * w in double for 4 floats at once
+ *
+ ************************/
+__attribute__((target("sse4.1")))
+static inline __m128 sumOf4(__m128 u, __m128 v, __m128 w, double c0,
+double c1, double c2)
+{
+        __m128d low = sumOf2(_mm_cvtps_pd(u), _mm_cvtps_pd(v),
+                             _mm_cvtps_pd(w), c0, c1, c2);
+        __m128d high = sumOf2(_mm_cvtps_pd(_mm_movehl_ps(u, u)),
+                              _mm_cvtps_pd(_mm_movehl_ps(v, v)),
+                              _mm_cvtps_pd(_mm_movehl_ps(w, w)), c0, c1, c2);
+        return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+}
+
+/********** packRGB4 ********
+ *
+ * packs 4 pixels' red, green and blue values (one per 32-bit lane) into 12
+ * bytes of RGB at 'rgb'
+ *
+ ************************/
+__attribute__((target("sse4.1")))
+static inline void packRGB4(__m128i r, __m128i g, __m128i b,
+unsigned char *rgb)
+{
+        __m128i lanes = _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 8),
+                                                     _mm_slli_epi32(b, 16)));
+        __m128i packed = _mm_shuffle_epi8(lanes, _mm_setr_epi8(0, 1, 2, 4,
+                                5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+        uint32_t last = _mm_extract_epi32(packed, 2);
+        _mm_storel_epi64((__m128i *)rgb, packed);
+        memcpy(rgb + 8, &last, 4);
+}
+
+/********** rgbToCVC_sse41 ********
+ *
+ * converts a row of RGB pixels to CVC 4 pixels at a time
+ *
+ * Parameters: see Color_rgb_to_cvc
+ *
+ ************************/
+__attribute__((target("sse4.1")))
+static void rgbToCVC_sse41(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr)
+{
+        __m128 d = _mm_set1_ps(dnm);
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(
+                        _mm_loadl_epi64((const __m128i *)&red[i]))), d);
+                __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(
+                        _mm_loadl_epi64((const __m128i *)&green[i]))), d);
+                __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(
+                        _mm_loadl_epi64((const __m128i *)&blue[i]))), d);
+
+                _mm_storeu_ps(&y[i], sumOf4(r, g, b, 0.299, 0.587, 0.114));
+                _mm_storeu_ps(&pb[i], sumOf4(r, g, b, -0.168736, -0.331264,
+                                             0.5));
+                _mm_storeu_ps(&pr[i], sumOf4(r, g, b, 0.5, -0.418688,
+                                             -0.081312));
+        }
+        rgbToCVC_scalar(red + i, green + i, blue + i, count - i, dnm, y + i,
+                        pb + i, pr + i);
+}
+
+/********** cvcToRGB_sse41 ********
+ *
+ * converts a row of CVC pixels to RGB 4 pixels at a time
+ *
+ * Parameters: see Color_cvc_to_rgb
+ *
+ ************************/
+__attribute__((target("sse4.1")))
+static void cvcToRGB_sse41(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb)
+{
+        __m128 d = _mm_set1_ps(dnm);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128 luma = _mm_loadu_ps(&y[i]);
+                __m128 b = _mm_loadu_ps(&pb[i]);
+                __m128 r = _mm_loadu_ps(&pr[i]);
+
+                __m128 toR = sumOf4(luma, b, r, 1.0, 0.0, 1.402);
+                __m128 toG = sumOf4(luma, b, r, 1.0, -0.344136, -0.714136);
+                __m128 toB = sumOf4(luma, b, r, 1.0, 1.772, 0.0);
+
+                /*Clamp to [0, 1], then scale and truncate like (int) does*/
+                toR = _mm_mul_ps(_mm_min_ps(_mm_max_ps(toR, zero), one), d);
+                toG = _mm_mul_ps(_mm_min_ps(_mm_max_ps(toG, zero), one), d);
+                toB = _mm_mul_ps(_mm_min_ps(_mm_max_ps(toB, zero), one), d);
+
+                packRGB4(_mm_cvttps_epi32(toR), _mm_cvttps_epi32(toG),
+                         _mm_cvttps_epi32(toB), &rgb[i * 3]);
+        }
+        cvcToRGB_scalar(y + i, pb + i, pr + i, count - i, dnm, rgb + i * 3);
+}
+
+/********** sumOf8 ********
+ *
+ * computes (c0 * u + c1 * v) + c2 * w in double for 8 floats at once
+ *
+ ************************/
+__attribute__((target("avx2")))
+static inline __m256 sumOf8(__m256 u, __m256 v, __m256 w, double c0,
+double c1, double c2)
+{
+        __m256d k0 = _mm256_set1_pd(c0);
+        __m256d k1 = _mm256_set1_pd(c1);
+        __m256d k2 = _mm256_set1_pd(c2);
+        __m128 halves[2];
+
+        for (int h = 0; h < 2; h++) {
+                __m256d u2 = _mm256_cvtps_pd(h ? _mm256_extractf128_ps(u, 1)
+                                               : _mm256_castps256_ps128(u));
+                __m256d v2 = _mm256_cvtps_pd(h ? _mm256_extractf128_ps(v, 1)
+                                               : _mm256_castps256_ps128(v));
+                __m256d w2 = _mm256_cvtps_pd(h ? _mm256_extractf128_ps(w, 1)
+                                               : _mm256_castps256_ps128(w));
+                __m256d uv = _mm256_add_pd(_mm256_mul_pd(k0, u2),
+                                           _mm256_mul_pd(k1, v2));
+                halves[h] = _mm256_cvtpd_ps(_mm256_add_pd(uv,
+                                                _mm256_mul_pd(k2, w2)));
+        }
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(halves[0]),
+                                    halves[1], 1);
+}
+
+/********** loadSamples8 ********
+ *
+ * loads 8 samples and divides them by the denominator
+ *
+ ************************/
+__attribute__((target("avx2")))
+static inline __m256 loadSamples8(const uint16_t *samples, __m256 d)
+{
+        __m128i words = _mm_loadu_si128((const __m128i *)samples);
+        return _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(words)),
+                             d);
+}
+
+/********** rgbToCVC_avx2 ********
+ *
+ * converts a row of RGB pixels to CVC 8 pixels at a time
+ *
+ * Parameters: see Color_rgb_to_cvc
+ *
+ ************************/
+__attribute__((target("avx2")))
+static void rgbToCVC_avx2(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr)
+{
+        __m256 d = _mm256_set1_ps(dnm);
+        unsigned i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256 r = loadSamples8(&red[i], d);
+                __m256 g = loadSamples8(&green[i], d);
+                __m256 b = loadSamples8(&blue[i], d);
+
+                _mm256_storeu_ps(&y[i], sumOf8(r, g, b, 0.299, 0.587, 0.114));
+                _mm256_storeu_ps(&pb[i], sumOf8(r, g, b, -0.168736,
+                                                -0.331264, 0.5));
+                _mm256_storeu_ps(&pr[i], sumOf8(r, g, b, 0.5, -0.418688,
+                                                -0.081312));
+        }
+        /*The scalar tail is SSE code, so leave the AVX state clean first*/
+        _mm256_zeroupper();
+        rgbToCVC_scalar(red + i, green + i, blue + i, count - i, dnm, y + i,
+                        pb + i, pr + i);
+}
+
+/********** cvcToRGB_avx2 ********
+ *
+ * converts a row of CVC pixels to RGB 8 pixels at a time
+ *
+ * Parameters: see Color_cvc_to_rgb
+ *
+ ************************/
+__attribute__((target("avx2")))
+static void cvcToRGB_avx2(const float *y, const float *pb, const float *pr,
+unsigned count, float dnm, unsigned char *rgb)
+{
+        __m256 d = _mm256_set1_ps(dnm);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.0f);
+        unsigned i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256 luma = _mm256_loadu_ps(&y[i]);
+                __m256 b = _mm256_loadu_ps(&pb[i]);
+                __m256 r = _mm256_loadu_ps(&pr[i]);
+
+                __m256 toR = sumOf8(luma, b, r, 1.0, 0.0, 1.402);
+                __m256 toG = sumOf8(luma, b, r, 1.0, -0.344136, -0.714136);
+                __m256 toB = sumOf8(luma, b, r, 1.0, 1.772, 0.0);
+
+                /*Clamp to [0, 1], then scale and truncate like (int) does*/
+                toR = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(toR, zero),
+                                                  one), d);
+                toG = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(toG, zero),
+                                                  one), d);
+                toB = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(toB, zero),
+                                                  one), d);
+
+                __m256i rs = _mm256_cvttps_epi32(toR);
+                __m256i gs = _mm256_cvttps_epi32(toG);
+                __m256i bs = _mm256_cvttps_epi32(toB);
+                packRGB4(_mm256_castsi256_si128(rs),
+                         _mm256_castsi256_si128(gs),
+                         _mm256_castsi256_si128(bs), &rgb[i * 3]);
+                packRGB4(_mm256_extracti128_si256(rs, 1),
+                         _mm256_extracti128_si256(gs, 1),
+                         _mm256_extracti128_si256(bs, 1), &rgb[i * 3 + 12]);
+        }
+        /*The scalar tail is SSE code, so leave the AVX state clean first*/
+        _mm256_zeroupper();
+        cvcToRGB_scalar(y + i, pb + i, pr + i, count - i, dnm, rgb + i * 3);
+}
+
+#endif
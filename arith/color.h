@@ -0,0 +1,23 @@
+/*
+*     color.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for converting rows of pixels between RGB and component
+*     video color (CVC)
+*/
+
+#ifndef COLOR_INCLUDED
+#define COLOR_INCLUDED
+
+#include <stdint.h>
+
+/*Rows are kept as separate arrays (one per color component) so that
+several pixels can be converted at once*/
+extern void Color_rgb_to_cvc(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, float dnm, float *y, float *pb,
+float *pr);
+extern void Color_cvc_to_rgb(const float *y, const float *pb,
+const float *pr, unsigned count, float dnm, unsigned char *rgb);
+
+#endif
@@ -3,7 +3,8 @@
 *     jadkin05, alall01, 10/22/2024
 *     arith
 *     
-*     Program to compress and decompress ppm images
+*     Compresses and decompresses ppm images, as files (compress40.h) or 
+*     in memory (codec40.h); 40image.c is the command line program
 */
 
 #include <stdio.h>
@@ -13,430 +14,1223 @@
 #include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <inttypes.h>
+#include <time.h>
 #include "assert.h"
-#include "pnm.h"
-#include "a2methods.h"
-#include "a2plain.h"
-#include "uarray2.h"
 #include "compress40.h"
+#include "codec40.h"
 #include "arith40.h"
 #include "all_structs.h"
-#include "bitpack.h"
+#include "codeword.h"
+#include "fixed.h"
+#include "color.h"
+#include "pool.h"
+#include "cwstream.h"
+#include "tiled.h"
+
+
+/*Rows of pixels each thread works on at a time (always even)*/
+#define BAND_ROWS 16
+#define FORMAT2_HEADER "COMP40 Compressed image format 2\n%u %u\n"
+
+/*Set with Codec40_set*/
+static unsigned threads = 1;
+static bool fixedPoint = false;
+static bool showStats = false;
+static bool tiled = false;
+static unsigned tiledFlags = 0;
+static bool cropping = false;
+static struct rect crop;
+static bool preview = false;
+
+/*Y of each a, and Pb or Pr of each chroma index, for --preview*/
+static float previewLuma[64];
+static float previewChroma[16];
+
+/*Stats Definitions*/
+static double now(void);
+static void printStats(const char *what, double seconds[STAGES], double total);
+static void addBandStats(struct band *bands, unsigned count, 
+double seconds[STAGES]);
+
+/*Band Definitions*/
+static struct band *newBands(unsigned count, unsigned width, size_t stride, 
+bool wide, float denominator);
+static void freeBands(struct band *bands, unsigned count);
+static size_t bandBytes(unsigned width);
+static void carveBand(struct band *band, unsigned width, 
+unsigned char *scratch);
+static void *carve(unsigned char **scratch, size_t count, size_t size);
+static void splitBatch(struct band *bands, unsigned count, unsigned rows, 
+unsigned char *raw, unsigned char *packed, const unsigned char *source);
+
+/*Buffer Definitions*/
+static size_t headerBytes(unsigned width, unsigned height);
+static size_t parseHeader(const unsigned char *in, size_t size, 
+unsigned *width, unsigned *height);
+static bool parseNumber(const unsigned char *in, size_t size, size_t *at, 
+unsigned *n);
 
+/*Compression Definitions*/
+static void readPPMHeader(FILE *fp, struct ppm_reader *reader);
+static unsigned readNumber(FILE *fp);
+static void readRows(struct ppm_reader *reader, unsigned char *raw, 
+unsigned rows);
+static void compressBand(void *cl);
+static void splitRow(struct band *band, unsigned char *raw);
+static void quantizeBlock(struct cvc_row *top, struct cvc_row *bottom, 
+unsigned col, struct cw_row *fields);
+static void DCT(float y1, float y2, float y3, float y4, int qz[4]);
+static void writeOut_C(const unsigned char *packed, unsigned count);
 
-static void (*compress_or_decompress)(FILE *input) = compress40;
+/*Decompression Definitions*/
+static unsigned readFormat(FILE *input);
+static void readHeader(FILE *input, unsigned *width, unsigned *height);
+static struct rect cropArea(unsigned width, unsigned height);
+static void decompressTiled(FILE *fp, double start);
+static void decompressTiles(void *cl);
+static void decompressBand(void *cl);
+static void previewSetup(void);
+static void previewRow(const struct cw_row *fields, unsigned blocks, 
+struct cvc_row *row);
+static void floatConvert(cw_data curr);
+static void inverseDCT(cw_data x);
+static void writeOut_D(const unsigned char *pixels, size_t stride, 
+unsigned first, unsigned rows, const struct rect *area);
 
-/*Compression Definitions*/
-Pnm_ppm trimBorders(Pnm_ppm untrimmed, A2Methods_T methods);
-Pnm_ppm RGBtoCVC(Pnm_ppm rgb, A2Methods_T methods, A2Methods_mapfun *map);
-void apply_convert_to_cvc(int i, int j, void *array2D, void *elem, void *cl);
-uint32_t *packWords(Pnm_ppm cvcPPM, A2Methods_mapfun *map);
-void apply_block_packing(int i, int j, void *array2D, void *elem, void *cl);
-int *DCT(float y1, float y2, float y3, float y4);
-void writeOut_C(uint32_t *all_cw, int width, int height);
 
-/*Decompression Definitions*/
-A2Methods_UArray2 readHeader(FILE *input, A2Methods_T methods, 
-A2Methods_mapfun *map);
-A2Methods_UArray2 setupPixmap(int width, int height, A2Methods_T methods, 
-A2Methods_mapfun *map,  FILE *fp);
-void apply_handle_codewords(int i, int j, void *array2D, void *elem, void *cl);
-A2Methods_UArray2 unpackCW(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map);
-void apply_unpack_codewords(int i, int j, void *array2D, void *elem, void *cl);
-A2Methods_UArray2 floatConvert(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map);
-void apply_float_conversions(int i, int j, void *array2D, void *elem, void *cl);
-void inverseDCT(cw_data x);
-Pnm_ppm blocks_to_cvcPixels(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map);
-void apply_make_cvc_pixelmap(int i, int j, void *array2D, void *elem, void *cl);
-Pnm_ppm CVCtoRGB(Pnm_ppm cvc, A2Methods_T methods, A2Methods_mapfun *map, 
-int dnm);
-void apply_convert_to_rgb(int i, int j, void *array2D, void *elem, void *cl);
-void writeOut_D(Pnm_ppm final);
-
-
-
-/********** main ********
- *
- * Handles and runs the compression and decompression
+
+/********** compress40 ********
+ *
+ * Reads in pixel data a batch of rows at a time, converts to CVC form, 
+ * performs DCT and packs into 32-bit code words to ultimately compress PPM 
+ * image
+ *
+ * Parameters:
+ *      File *fp: pointer to PPM image file               
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - fp should be a pointer to a valid PPM file 
+ *
+ * Notes: 
+ *      - each batch is split into one band of BAND_ROWS rows per thread;
+ *        every band packs its code words into its own part of the batch's
+ *        code words, which are written out before the next batch is read
+ *      - only a batch of rows is ever in memory, however big the image is
+ *      - odd borders are trimmed: the last column is skipped and the last
+ *        row is never read
+ *      
+ ************************/
+void compress40(FILE *fp)
+{
+        double start = now();
+        double seconds[STAGES] = { 0 };
+        struct ppm_reader reader;
+        readPPMHeader(fp, &reader);
+        unsigned width = reader.width - reader.width % 2;
+        unsigned height = reader.height - reader.height % 2;
+
+        /*Samples over 255 take two bytes each*/
+        bool wide = reader.denominator > 255;
+        size_t stride = (size_t)reader.width * (wide ? 6 : 3);
+        struct band *bands = newBands(threads, width, stride, wide, 
+        reader.denominator);
+
+        /*Room for one more block so nothing is ever malloc(0)*/
+        unsigned batch = threads * BAND_ROWS;
+        unsigned char *raw = malloc(batch * stride + 1);
+        unsigned char *packed = malloc((batch / 2 * (width / 2) + 1) * 4);
+        if (raw == NULL || packed == NULL) {  
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+
+        if (fixedPoint) {
+                Fixed_setup();
+        }
+        Pool_T pool = Pool_new(threads);
+        Tiled_T out = NULL;
+        if (tiled) {
+                out = Tiled_writer(stdout, width, height, TILE_SIZE, 
+                tiledFlags);
+        } else {
+                printf(FORMAT2_HEADER, width, height);
+        }
+        for (unsigned row = 0; row < height; row += batch) {
+                unsigned rows = height - row < batch ? height - row : batch;
+                double t = now();
+                readRows(&reader, raw, rows);
+                seconds[STAGE_READ] += now() - t;
+
+                splitBatch(bands, threads, rows, raw, packed, NULL);
+                Pool_run(pool, compressBand, bands, sizeof(struct band));
+
+                t = now();
+                if (out != NULL) {
+                        Tiled_write_rows(out, packed, rows / 2);
+                } else {
+                        writeOut_C(packed, rows / 2 * (width / 2));
+                }
+                seconds[STAGE_WRITE] += now() - t;
+        }
+        if (out != NULL) {
+                double t = now();
+                Tiled_finish(&out);
+                seconds[STAGE_WRITE] += now() - t;
+        }
+
+        if (showStats) {
+                fflush(stdout);
+                addBandStats(bands, threads, seconds);
+                printStats("compress", seconds, now() - start);
+        }
+        Pool_free(&pool);
+        freeBands(bands, threads);
+        free(raw);
+        free(packed);
+}
+
+/********** decompress40 ********
+ *
+ * Reads in 32-bit code words a batch of rows at a time and unpacks them; 
+ * uses inverse DCT and converts back to RGB to decompress an image
+ *
+ * Parameters:
+ *      File *fp: pointer to input compressed image file               
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - fp should be a valid pointer to compressed image data
+ *
+ * Notes: 
+ *      - each batch is split into one band of BAND_ROWS rows per thread;
+ *        every band writes its pixels into its own part of the batch's 
+ *        pixels, which are written out before the next batch is read
+ *      - only a batch of rows is ever in memory, however big the image is
+ *      - format 3 images go to decompressTiled instead
+ *      - with --preview, each code word becomes one pixel
+ *      - We found a denominator value of 255 to be best for flowers.ppm
+ *      
+ ************************/
+void decompress40(FILE *fp)
+{
+        double start = now();
+        if (readFormat(fp) == 3) {
+                decompressTiled(fp, start);
+                return;
+        }
+
+        double seconds[STAGES] = { 0 };
+        unsigned width, height;
+        readHeader(fp, &width, &height);
+        unsigned blocks = width / 2;
+
+        /*A preview is half as wide and half as tall*/
+        unsigned scale = preview ? 2 : 1;
+        struct rect area = cropArea(width / scale, height / scale);
+        int denominator = 255;
+        size_t stride = (size_t)width / scale * 3;
+        struct band *bands = newBands(threads, width, stride, false, 
+        denominator);
+        for (unsigned i = 0; i < threads; i++) {
+                bands[i].preview = preview;
+        }
+
+        /*Room for one more block so nothing is ever malloc(0)*/
+        unsigned batch = threads * BAND_ROWS;
+        unsigned char *pixels = malloc(batch / scale * stride + 1);
+        if (pixels == NULL) {  
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+
+        if (fixedPoint) {
+                Fixed_setup();
+        }
+        if (preview) {
+                previewSetup();
+        }
+        CWStream_T input = CWStream_reader(fp);
+        Pool_T pool = Pool_new(threads);
+        printf("P6\n%u %u\n%u\n", area.width, area.height, denominator);
+        for (unsigned row = 0; row < height; row += batch) {
+                unsigned rows = height - row < batch ? height - row : batch;
+                double t = now();
+                const unsigned char *source = CWStream_read(input, 
+                                              rows / 2 * blocks);
+                seconds[STAGE_READ] += now() - t;
+
+                splitBatch(bands, threads, rows, pixels, NULL, source);
+                Pool_run(pool, decompressBand, bands, sizeof(struct band));
+
+                t = now();
+                writeOut_D(pixels, stride, row / scale, rows / scale, &area);
+                seconds[STAGE_WRITE] += now() - t;
+        }
+
+        if (showStats) {
+                fflush(stdout);
+                addBandStats(bands, threads, seconds);
+                printStats("decompress", seconds, now() - start);
+        }
+        Pool_free(&pool);
+        CWStream_free(&input);
+        freeBands(bands, threads);
+        free(pixels);
+}
+
+
+/********** Codec40_set ********
+ *
+ * chooses how compress40 and decompress40 run
+ *
+ * Parameters:
+ *      const struct Codec40_options *options:  the options
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - 'options' is not NULL and asks for at least 1 thread
+ *      - compress40 and decompress40 aren't running
+ *
+ * Notes: 
+ *      - the options are copied, so they can go away afterwards
+ *      
+ ************************/
+void Codec40_set(const struct Codec40_options *options)
+{
+        assert(options != NULL && options->threads >= 1);
+        threads = options->threads;
+        fixedPoint = options->fixedPoint;
+        showStats = options->stats;
+        tiled = options->tiled;
+        tiledFlags = options->tiledFlags;
+        cropping = options->cropping;
+        crop = (struct rect){ options->cropX, options->cropY, 
+                              options->cropWidth, options->cropHeight };
+        preview = options->preview;
+}
+
+/********** Codec40_scratch_size ********
+ *
+ * tells how much scratch the buffer functions need for an image
+ *
+ * Parameters:
+ *      unsigned width:         width of the image in pixels
+ *
+ * Return:
+ *      how many bytes of scratch to hand Codec40_compress or 
+ *      Codec40_decompress
+ * 
+ * Expects:
+ *
+ * Notes: 
+ *      - it only depends on the width, so scratch for the widest image 
+ *        does for all of them
+ *      
+ ************************/
+size_t Codec40_scratch_size(unsigned width)
+{
+        return bandBytes(width - width % 2);
+}
+
+/********** Codec40_compressed_size ********
+ *
+ * tells how big an image is once compressed
+ *
+ * Parameters:
+ *      unsigned width:         width of the image in pixels
+ *      unsigned height:        height of the image in pixels
+ *
+ * Return:
+ *      how many bytes Codec40_compress writes for the image
+ * 
+ * Expects:
+ *
+ * Notes: 
+ *      - exact, since every code word takes 4 bytes; odd borders are 
+ *        trimmed like they are by compress40
+ *      
+ ************************/
+size_t Codec40_compressed_size(unsigned width, unsigned height)
+{
+        width -= width % 2;
+        height -= height % 2;
+        return headerBytes(width, height) + 
+               (size_t)(width / 2) * (height / 2) * 4;
+}
+
+/********** Codec40_compress ********
+ *
+ * compresses an image in memory to format 2 in memory
+ *
+ * Parameters:
+ *      const unsigned char *pixels:    the first row of samples
+ *      unsigned width:                 width of the image in pixels
+ *      unsigned height:                height of the image in pixels
+ *      size_t stride:                  how many bytes apart the rows are
+ *      unsigned denominator:           denominator of the samples
+ *      unsigned char *out:             where to put the compressed image
+ *      size_t size:                    how many bytes 'out' has room for
+ *      void *scratch:                  Codec40_scratch_size bytes, or NULL
+ *
+ * Return:
+ *      how many bytes were written, or 0 if they don't fit in 'size'
+ * 
+ * Expects:
+ *      - 'denominator' is from 1 to 65535, and every row holds 'width' 
+ *        pixels
+ *
+ * Notes: 
+ *      - code words are packed straight from 'pixels' into 'out' on the
+ *        calling thread; nothing is copied, and nothing is allocated 
+ *        unless 'scratch' is NULL
+ *      - several images can be compressed at once on different threads,
+ *        each with its own scratch
+ *      
+ ************************/
+size_t Codec40_compress(const unsigned char *pixels, unsigned width,
+unsigned height, size_t stride, unsigned denominator, unsigned char *out,
+size_t size, void *scratch)
+{
+        bool wide = denominator > 255;
+        assert(denominator > 0 && denominator < 65536);
+        assert(height < 2 || (pixels != NULL && 
+                              stride >= (size_t)width * (wide ? 6 : 3)));
+        size_t bytes = Codec40_compressed_size(width, height);
+        if (out == NULL || size < bytes) {
+                return 0;
+        }
+
+        width -= width % 2;
+        height -= height % 2;
+        char header[64];
+        size_t headerSize = headerBytes(width, height);
+        snprintf(header, sizeof(header), FORMAT2_HEADER, width, height);
+        memcpy(out, header, headerSize);
+
+        unsigned char *memory = scratch;
+        if (memory == NULL) {
+                memory = malloc(bandBytes(width));
+                if (memory == NULL) {  
+                        fprintf(stderr, "Error allocating memory.\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        struct band band = { 0 };
+        carveBand(&band, width, memory);
+        band.stride = stride;
+        band.wide = wide;
+        band.denominator = denominator;
+        band.rows = height;
+
+        /*compressBand only reads the samples*/
+        band.raw = (unsigned char *)pixels;
+        band.packed = out + headerSize;
+        compressBand(&band);
+
+        if (scratch == NULL) {
+                free(memory);
+        }
+        return bytes;
+}
+
+/********** Codec40_geometry ********
+ *
+ * reads the width and height of a format 2 image in memory
+ *
+ * Parameters:
+ *      const unsigned char *in:        the compressed image
+ *      size_t size:                    how many bytes it takes up
+ *      unsigned *width:                where to put its width
+ *      unsigned *height:               where to put its height
+ *
+ * Return:
+ *      true if 'in' holds a whole format 2 image, or false
+ * 
+ * Expects:
+ *      - 'width' and 'height' are not NULL
+ *
+ * Notes: 
+ *      - the decompressed pixels take up 'height' rows of 3 * 'width' 
+ *        bytes
+ *      
+ ************************/
+bool Codec40_geometry(const unsigned char *in, size_t size,
+unsigned *width, unsigned *height)
+{
+        assert(width != NULL && height != NULL);
+        return parseHeader(in, size, width, height) != 0;
+}
+
+/********** Codec40_decompress ********
+ *
+ * decompresses a format 2 image in memory into pixels in memory
+ *
+ * Parameters:
+ *      const unsigned char *in:        the compressed image
+ *      size_t size:                    how many bytes it takes up
+ *      unsigned char *pixels:          where to put the first row of pixels
+ *      size_t stride:                  how many bytes apart the rows go
+ *      void *scratch:                  Codec40_scratch_size bytes, or NULL
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - Codec40_geometry says 'in' is a whole image, and 'pixels' has 
+ *        room for its rows
+ *
+ * Notes: 
+ *      - the code words are read where they are and the pixels written 
+ *        straight to 'pixels' on the calling thread; nothing is allocated
+ *        unless 'scratch' is NULL
+ *      
+ ************************/
+void Codec40_decompress(const unsigned char *in, size_t size,
+unsigned char *pixels, size_t stride, void *scratch)
+{
+        unsigned width, height;
+        size_t headerSize = parseHeader(in, size, &width, &height);
+        assert(headerSize != 0);
+        assert(height == 0 || (pixels != NULL && 
+                               stride >= (size_t)width * 3));
+
+        unsigned char *memory = scratch;
+        if (memory == NULL) {
+                memory = malloc(bandBytes(width));
+                if (memory == NULL) {  
+                        fprintf(stderr, "Error allocating memory.\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        struct band band = { 0 };
+        carveBand(&band, width, memory);
+        band.stride = stride;
+        band.denominator = 255;
+        band.rows = height;
+        band.raw = pixels;
+        band.source = in + headerSize;
+        decompressBand(&band);
+
+        if (scratch == NULL) {
+                free(memory);
+        }
+}
+
+
+/*START OF STATS FUNCTIONS*/
+
+/********** now ********
+ *
+ * tells the time, for timing the stages
+ *
+ * Parameters:
+ *      none
+ *
+ * Return:
+ *      double: seconds since some fixed point in the past
+ * 
+ * Expects:
+ *      - nothing
+ *
+ * Notes: 
+ *      - uses the monotonic clock, so it never goes backwards
+ *      
+ ************************/
+static double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/********** printStats ********
+ *
+ * prints how long each stage took to stderr
+ *
+ * Parameters:
+ *      const char *what:       "compress" or "decompress"
+ *      double seconds[STAGES]: seconds spent in each stage
+ *      double total:           seconds from start to finish
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - 'seconds' has the threads' times added in already
+ *
+ * Notes: 
+ *      - reading and writing are done by one thread, but the color, DCT
+ *        and bitpack times are added up over all threads, so with -j they
+ *        can add up to more than the total
+ *      
+ ************************/
+static void printStats(const char *what, double seconds[STAGES], double total)
+{
+        static const char *names[STAGES] = { "read", "color", "dct", 
+                                             "bitpack", "write" };
+        fprintf(stderr, "%s (%u thread%s%s):\n", what, threads, 
+                threads == 1 ? "" : "s", fixedPoint ? ", fixed point" : "");
+        for (int stage = 0; stage < STAGES; stage++) {
+                fprintf(stderr, "  %-8s %8.3fs\n", names[stage], 
+                        seconds[stage]);
+        }
+        fprintf(stderr, "  %-8s %8.3fs\n", "total", total);
+}
+
+/********** addBandStats ********
+ *
+ * adds up how long each band spent in each stage
+ *
+ * Parameters:
+ *      struct band *bands:     the bands
+ *      unsigned count:         how many bands there are
+ *      double seconds[STAGES]: where to add the time of each stage
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - no thread is working on the bands
+ *
+ * Notes: 
+ *      
+ ************************/
+static void addBandStats(struct band *bands, unsigned count, 
+double seconds[STAGES])
+{
+        for (unsigned i = 0; i < count; i++) {
+                for (int stage = 0; stage < STAGES; stage++) {
+                        seconds[stage] += bands[i].seconds[stage];
+                }
+        }
+}
+
+/*END OF STATS FUNCTIONS*/
+
+
+/*START OF BAND FUNCTIONS*/
+
+/********** newBands ********
+ *
+ * allocates the bands for each thread, along with their space to work in
+ *
+ * Parameters:
+ *      unsigned count:         how many bands to make
+ *      unsigned width:         how many pixels are in a row
+ *      size_t stride:          how many bytes are in a row of samples
+ *      bool wide:              whether samples take two bytes each
+ *      float denominator:      denominator of the RGB values
+ *
+ * Return:
+ *      struct band *: array of 'count' bands with no rows yet
+ * 
+ * Expects:
+ *      - 'count' is at least 1
+ *
+ * Notes: 
+ *      - the bands are freed with freeBands
+ *      
+ ************************/
+static struct band *newBands(unsigned count, unsigned width, size_t stride, 
+bool wide, float denominator)
+{
+        struct band *bands = calloc(count, sizeof(struct band));
+        if (bands == NULL) {  
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+
+        for (unsigned i = 0; i < count; i++) {
+                struct band *band = &bands[i];
+                unsigned char *scratch = malloc(bandBytes(width));
+                if (scratch == NULL) {  
+                        fprintf(stderr, "Error allocating memory.\n");
+                        exit(EXIT_FAILURE);
+                }
+                carveBand(band, width, scratch);
+                band->stride = stride;
+                band->wide = wide;
+                band->denominator = denominator;
+                band->fixedPoint = fixedPoint;
+        }
+        return bands;
+}
+
+/********** freeBands ********
+ *
+ * frees bands made by newBands
+ *
+ * Parameters:
+ *      struct band *bands:     the bands
+ *      unsigned count:         how many bands there are
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - 'bands' was made by newBands with the same 'count'
+ *
+ * Notes: 
+ *      
+ ************************/
+static void freeBands(struct band *bands, unsigned count)
+{
+        for (unsigned i = 0; i < count; i++) {
+                free(bands[i].scratch);
+        }
+        free(bands);
+}
+
+/********** bandBytes ********
+ *
+ * tells how much scratch carveBand needs
+ *
+ * Parameters:
+ *      unsigned width:         how many pixels are in a row
+ *
+ * Return:
+ *      size_t: how many bytes of scratch a band 'width' pixels wide takes
+ * 
+ * Expects:
+ *      - 'width' is even
+ *
+ * Notes: 
+ *      - every array has room for one more item, so none is ever empty, 
+ *        and for lining it up on a cache line
+ *      
+ ************************/
+static size_t bandBytes(unsigned width)
+{
+        size_t pixels = (size_t)width + 1;
+        size_t blocks = (size_t)width / 2 + 1;
+        return 3 * (pixels * sizeof(uint16_t) + 63) + 
+               6 * (pixels * sizeof(float) + 63) + 
+               6 * (pixels * sizeof(int32_t) + 63) +
+               7 * (blocks * sizeof(uint32_t) + 63);
+}
+
+/********** carveBand ********
+ *
+ * sets up a band's own space to work in, out of scratch memory
+ *
+ * Parameters:
+ *      struct band *band:      the band
+ *      unsigned width:         how many pixels are in a row
+ *      unsigned char *scratch: bandBytes('width') bytes
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - 'band' and 'scratch' are not NULL
+ *
+ * Notes: 
+ *      - the band's arrays all point into 'scratch', so it holds no memory
+ *        of its own; 'band->scratch' remembers where it starts
+ *      
+ ************************/
+static void carveBand(struct band *band, unsigned width, 
+unsigned char *scratch)
+{
+        assert(band != NULL && scratch != NULL);
+        size_t pixels = (size_t)width + 1;
+        size_t blocks = (size_t)width / 2 + 1;
+        band->width = width;
+        band->scratch = scratch;
+
+        band->red = carve(&scratch, pixels, sizeof(uint16_t));
+        band->green = carve(&scratch, pixels, sizeof(uint16_t));
+        band->blue = carve(&scratch, pixels, sizeof(uint16_t));
+        struct cvc_row *rows[2] = { &band->top, &band->bottom };
+        struct fixed_row *fixedRows[2] = { &band->fixedTop, 
+                                           &band->fixedBottom };
+        for (int i = 0; i < 2; i++) {
+                rows[i]->y = carve(&scratch, pixels, sizeof(float));
+                rows[i]->b = carve(&scratch, pixels, sizeof(float));
+                rows[i]->r = carve(&scratch, pixels, sizeof(float));
+                fixedRows[i]->y = carve(&scratch, pixels, sizeof(int32_t));
+                fixedRows[i]->b = carve(&scratch, pixels, sizeof(int32_t));
+                fixedRows[i]->r = carve(&scratch, pixels, sizeof(int32_t));
+        }
+        band->fields.a = carve(&scratch, blocks, sizeof(uint32_t));
+        band->fields.b = carve(&scratch, blocks, sizeof(int32_t));
+        band->fields.c = carve(&scratch, blocks, sizeof(int32_t));
+        band->fields.d = carve(&scratch, blocks, sizeof(int32_t));
+        band->fields.Pb = carve(&scratch, blocks, sizeof(uint32_t));
+        band->fields.Pr = carve(&scratch, blocks, sizeof(uint32_t));
+        band->words = carve(&scratch, blocks, sizeof(uint32_t));
+}
+
+/********** carve ********
+ *
+ * takes an array off the front of some scratch memory
+ *
+ * Parameters:
+ *      unsigned char **scratch: where the rest of the scratch starts
+ *      size_t count:           how many items the array holds
+ *      size_t size:            how big each item is
+ *
+ * Return:
+ *      void *: the array, on a 64-byte boundary
+ * 
+ * Expects:
+ *      - there are 'count' * 'size' + 63 bytes left
+ *
+ * Notes: 
+ *      - moves '*scratch' past the array
+ *      
+ ************************/
+static void *carve(unsigned char **scratch, size_t count, size_t size)
+{
+        uintptr_t at = ((uintptr_t)*scratch + 63) & ~(uintptr_t)63;
+        *scratch = (unsigned char *)at + count * size;
+        return (void *)at;
+}
+
+/********** splitBatch ********
+ *
+ * splits a batch of rows into bands of BAND_ROWS rows, one per thread
+ *
+ * Parameters:
+ *      struct band *bands:     the bands
+ *      unsigned count:         how many bands there are
+ *      unsigned rows:          how many rows of pixels are in the batch
+ *      unsigned char *raw:     the batch's samples, 'stride' bytes a row
+ *      unsigned char *packed:  where the batch's code words go, width / 2
+ *                              a row, or NULL when decompressing
+ *      const unsigned char *source: the batch's code words when
+ *                              decompressing, or NULL
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - 'rows' is even and at most count * BAND_ROWS
+ *
+ * Notes: 
+ *      - bands past the end of a short batch get no rows
+ *      
+ ************************/
+static void splitBatch(struct band *bands, unsigned count, unsigned rows, 
+unsigned char *raw, unsigned char *packed, const unsigned char *source)
+{
+        for (unsigned i = 0; i < count; i++) {
+                struct band *band = &bands[i];
+                unsigned first = i * BAND_ROWS < rows ? i * BAND_ROWS : rows;
+
+                band->rows = rows - first < BAND_ROWS ? rows - first 
+                                                      : BAND_ROWS;
+                band->raw = raw + (band->preview ? first / 2 : first) * 
+                            band->stride;
+
+                size_t skip = (size_t)first / 2 * (band->width / 2) * 4;
+                band->packed = packed == NULL ? NULL : packed + skip;
+                band->source = source == NULL ? NULL : source + skip;
+        }
+}
+
+/*END OF BAND FUNCTIONS*/
+
+
+/*START OF BUFFER FUNCTIONS*/
+
+/********** headerBytes ********
+ *
+ * tells how long the header of a format 2 image is
+ *
+ * Parameters:
+ *      unsigned width:         width of the image
+ *      unsigned height:        height of the image
+ *
+ * Return:
+ *      size_t: how many bytes the header takes up
+ * 
+ * Expects:
+ *
+ * Notes: 
+ *      - the header is the same one compress40 writes
+ *      
+ ************************/
+static size_t headerBytes(unsigned width, unsigned height)
+{
+        return snprintf(NULL, 0, FORMAT2_HEADER, width, height);
+}
+
+/********** parseHeader ********
+ *
+ * reads the header of a format 2 image in memory
  *
  * Parameters:
- *      int argc: the number of arguments provided
- *      char *argv[]: array of the arguments provided           
+ *      const unsigned char *in:  the image
+ *      size_t size:              how many bytes it takes up
+ *      unsigned *width:          where to put the width of the image
+ *      unsigned *height:         where to put the height of the image
  *
  * Return:
- *      EXIT_SUCCESS if run to completion
+ *      size_t: how many bytes the header takes up, or 0 if 'in' isn't a 
+ *      whole format 2 image
  * 
  * Expects:
- *      - A single file for compression or decompression is given
- *      - A command specifying compression or decompression is given
+ *      - 'width' and 'height' are not NULL
  *
  * Notes: 
+ *      - unlike readHeader, nothing past 'size' is ever read, and a bad
+ *        image is not an error, since it comes from whoever calls 
+ *        Codec40_geometry
  *      
  ************************/
-int main(int argc, char *argv[])
+static size_t parseHeader(const unsigned char *in, size_t size, 
+unsigned *width, unsigned *height)
 {
-        int i;
-
-        for (i = 1; i < argc; i++) {
-                if (strcmp(argv[i], "-c") == 0) {
-                        compress_or_decompress = compress40;
-                } else if (strcmp(argv[i], "-d") == 0) {
-                        compress_or_decompress = decompress40;
-                } else if (*argv[i] == '-') {
-                        fprintf(stderr, "%s: unknown option '%s'\n",
-                                argv[0], argv[i]);
-                        exit(1);
-                } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
-                        exit(1);
-                } else {
-                        break;
-                }
-        }
-        assert(argc - i <= 1);
-        if (i < argc) {
-                FILE *fp = fopen(argv[i], "r");
-                assert(fp != NULL);
-                compress_or_decompress(fp);
-                fclose(fp);
-        } else {
-                compress_or_decompress(stdin);
+        static const char magic[] = "COMP40 Compressed image format 2\n";
+        size_t at = sizeof(magic) - 1;
+        if (in == NULL || size < at || memcmp(in, magic, at) != 0 ||
+            !parseNumber(in, size, &at, width) || at >= size || 
+            in[at++] != ' ' || !parseNumber(in, size, &at, height) || 
+            at >= size || in[at++] != '\n') {
+                return 0;
         }
 
-        return EXIT_SUCCESS; 
+        /*Every 2x2 block is a code word, and all of them are there*/
+        unsigned blocks = *width / 2;
+        if (*width % 2 != 0 || *height % 2 != 0 || 
+            (blocks != 0 && (size - at) / 4 / blocks < *height / 2)) {
+                return 0;
+        }
+        return at;
 }
 
-/********** compress40 ********
+/********** parseNumber ********
  *
- * Reads in pixel data, converts to CVC form, performs DCT and packs into 
- * 32-bit code words to ultimately compress PPM image
+ * reads an unsigned decimal number from memory
  *
  * Parameters:
- *      File *fp: pointer to PPM image file               
+ *      const unsigned char *in:  the bytes
+ *      size_t size:              how many bytes there are
+ *      size_t *at:               where the number starts
+ *      unsigned *n:              where to put the number
  *
  * Return:
- *      none
+ *      bool: false if there are no digits at 'at' or the number is too big
+ *      for an unsigned
  * 
  * Expects:
- *      - fp should be a pointer to a valid PPM file 
+ *      - 'at' and 'n' are not NULL
  *
  * Notes: 
- *      - frees memory for pnm_ppm object and array of code words
+ *      - leaves '*at' just past the last digit
  *      
  ************************/
-void compress40(FILE *fp)
+static bool parseNumber(const unsigned char *in, size_t size, size_t *at, 
+unsigned *n)
 {
-        A2Methods_T methods = uarray2_methods_plain; 
-        assert(methods);
-        A2Methods_mapfun *map = methods->map_default; 
-        assert(map != NULL);
-
-        Pnm_ppm ppm_original = Pnm_ppmread(fp, methods);
-        ppm_original = trimBorders(ppm_original, methods);
-        ppm_original = RGBtoCVC(ppm_original, methods, map);
-        uint32_t *all_cw = packWords(ppm_original, map);
-        writeOut_C(all_cw, ppm_original->width, ppm_original->height);
-
-        free(all_cw);
-        Pnm_ppmfree(&ppm_original);
+        size_t start = *at;
+        *n = 0;
+        while (*at < size && in[*at] >= '0' && in[*at] <= '9') {
+                unsigned digit = in[(*at)++] - '0';
+                if (*n > (UINT_MAX - digit) / 10) {
+                        return false;
+                }
+                *n = *n * 10 + digit;
+        }
+        return *at > start;
 }
 
-/********** decompress40 ********
+/*END OF BUFFER FUNCTIONS*/
+
+
+/*START OF COMPRESSION FUNCTIONS*/
+
+/********** readPPMHeader ********
  *
- * Reads in 32-bit code words and unpacks it from input; converts to CVC form, 
- * uses inverse DCT, converts back to RGB to decompress an image
+ * Reads the header of a PPM image and sets up a reader for its rows
  *
  * Parameters:
- *      File *fp: pointer to input compressed image file               
+ *      FILE *fp:                   pointer to PPM image file
+ *      struct ppm_reader *reader:  reader to set up
  *
  * Return:
  *      none
  * 
  * Expects:
- *      - fp should be a valid pointer to compressed image data
+ *      - fp is at the start of a plain (P3) or raw (P6) PPM image
  *
  * Notes: 
- *      - frees memory for temp array and final ppm object 
+ *      - comments in the header are skipped, like Pnm_ppmread does
  *      
  ************************/
-void decompress40(FILE *fp)
+static void readPPMHeader(FILE *fp, struct ppm_reader *reader)
 {
-        A2Methods_T methods = uarray2_methods_plain; 
-        assert(methods);
-        A2Methods_mapfun *map = methods->map_default; 
-        assert(map != NULL);
-
-        A2Methods_UArray2 starter = readHeader(fp, methods, map);
-        A2Methods_UArray2 block_data = unpackCW(starter, methods, map);
-        block_data = floatConvert(block_data, methods, map);
-        Pnm_ppm toOutput = blocks_to_cvcPixels(block_data, methods, map);
-        toOutput = CVCtoRGB(toOutput, methods, map, toOutput->denominator);
-        writeOut_D(toOutput);
-
-        Pnm_ppmfree(&toOutput);
-        methods->free(&block_data);
-        methods->free(&starter);
-        
+        int p = getc(fp);
+        int kind = getc(fp);
+        assert(p == 'P' && (kind == '3' || kind == '6'));
+
+        reader->fp = fp;
+        reader->plain = (kind == '3');
+        reader->width = readNumber(fp);
+        reader->height = readNumber(fp);
+        reader->denominator = readNumber(fp);
+        assert(reader->denominator > 0 && reader->denominator < 65536);
 }
 
-
-/*START OF COMPRESSION FUNCTIONS*/
-
-/********** trimBorders ********
+/********** readNumber ********
  *
- * If width/height odd, function trims borders of PPM image to ensure
- * image dimensions remain even for compression
+ * Reads an unsigned decimal number from a PPM header or plain PPM image
  *
  * Parameters:
- *      Pnm_ppm untrimmed:   PPM image that must be trimmed
- *      A2Methods_T methods: methods to alter 2D array             
+ *      FILE *fp:                 pointer to PPM image file
  *
  * Return:
- *      Pnm_ppm: image with even dimensions 
+ *      unsigned: the number read
  * 
  * Expects:
- *      - 'untrimmed' is a PPM object
- *      - 'methods' is a valid 'A2Methods_T' object
+ *      - there is a number before the end of the file
  *
  * Notes: 
- *      - frees original pixel array if it must be trimmed
+ *      - skips whitespace and comments before the number and reads the one
+ *        whitespace character after it, which ends a raw PPM header
  *      
  ************************/
-Pnm_ppm trimBorders(Pnm_ppm untrimmed, A2Methods_T methods)
+static unsigned readNumber(FILE *fp)
 {
-        if (untrimmed->width % 2 == 0 && untrimmed->height % 2 == 0) {
-                return untrimmed;
-        } else {
-                int newWidth = untrimmed->width;
-                int newHeight = untrimmed->height;
-                if (newWidth % 2 != 0) {
-                        newWidth--;
-                }
-                if (newHeight % 2 != 0) {
-                        newHeight--;
-                }
-                A2Methods_UArray2 trimmed = methods->new(newWidth, newHeight, 
-                sizeof(struct Pnm_rgb));
-                for (int i = 0; i < newHeight; i++) {
-                        for (int j = 0; j < newWidth; j++) {
-                                Pnm_rgb toAdd = methods->at(trimmed, j, i);
-                                Pnm_rgb old = methods->at(untrimmed->pixels, 
-                                j, i);
-                                toAdd->red = old->red;
-                                toAdd->green = old->green;
-                                toAdd->blue = old->blue;
+        int c = getc(fp);
+        while (c == '#' || c == ' ' || c == '\t' || c == '\n' || 
+               c == '\r') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(fp);
                         }
                 }
-                methods->free(&untrimmed->pixels);
-                untrimmed->pixels = trimmed;
-                untrimmed->height = newHeight;
-                untrimmed->width = newWidth;
+                c = getc(fp);
         }
-        return untrimmed;
+        assert(c >= '0' && c <= '9');
+
+        unsigned n = 0;
+        while (c >= '0' && c <= '9') {
+                n = n * 10 + (c - '0');
+                c = getc(fp);
+        }
+        return n;
 }
 
-/********** RGBtoCVC ********
+/********** readRows ********
  *
- * Converts RGB PPM image to CVC
+ * Reads the next rows of a PPM image as they would be in a raw PPM
  *
  * Parameters:
- *      Pnm_ppm rgb: original RGB image
- *      A2Methods_T methods: methods to alter 2D array 
- *      A2Methods_mapfun:    mapping function to traverse 2D array             
+ *      struct ppm_reader *reader:  reader for the image
+ *      unsigned char *raw:         where to put the samples
+ *      unsigned rows:              how many rows to read
  *
  * Return:
- *      Pnm_ppm: altered image in CVC format
+ *      none
  * 
  * Expects:
- *      - 'rgb' must be a valid RGB PPM image
- *      - 'map' is a valid function pointer
- *      - 'methods' is a valid object
+ *      - 'raw' has room for 'rows' rows of samples
  *
  * Notes: 
- *      - frees memory for RGB pixel array
+ *      - samples of a plain image are stored like those of a raw one (one
+ *        byte each, or two bytes big-endian when the denominator is over
+ *        255), so the threads only ever see raw samples
  *      
  ************************/
-Pnm_ppm RGBtoCVC(Pnm_ppm rgb, A2Methods_T methods, A2Methods_mapfun *map)
+static void readRows(struct ppm_reader *reader, unsigned char *raw, 
+unsigned rows)
 {
-        int cvcWidth = rgb->width;
-        int cvcHeight = rgb->height;
-
-        A2Methods_UArray2 *cvcPixels = methods->new(cvcWidth, cvcHeight, 
-        sizeof(struct Pnm_cvc));
+        bool wide = reader->denominator > 255;
+        size_t samples = (size_t)reader->width * 3 * rows;
 
-
-        /*Custom struct storing all data we need access to in
-        the apply function*/
-        cvc_closure cl = (cvc_closure)malloc(sizeof(struct cvc_closure));
-        if (cl == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
+        if (!reader->plain) {
+                size_t read = fread(raw, wide ? 2 : 1, samples, reader->fp);
+                assert(read == samples);
+                return;
         }
-        cl->pix = cvcPixels;
-        cl->rgb_denom = rgb->denominator;
-        cl->methods = methods;
 
-        map(rgb->pixels, apply_convert_to_cvc, cl);
-        methods->free(&rgb->pixels);
-        rgb->pixels = cl->pix;
-
-        free(cl);
-        return rgb;
+        for (size_t i = 0; i < samples; i++) {
+                unsigned n = readNumber(reader->fp);
+                if (wide) {
+                        raw[i * 2] = n >> 8;
+                        raw[i * 2 + 1] = n & 255;
+                } else {
+                        raw[i] = n;
+                }
+        }
 }
 
-/********** apply_convert_to_cvc ********
+/********** compressBand ********
  *
- * takes single pixel and converts it from RGB to CVC
+ * packs the rows of a band into code words
  *
  * Parameters:
- *      int i: current row index in 2D array
- *      int j: current column index in 2D array
- *      void *array2D: unused 2D array
- *      void *elem: pointer to current RGB pixel
- *      void *cl: closure with information for transformation            
+ *      void *cl:       the band
  *
  * Return:
  *      none
  * 
  * Expects:
- *      - 'elem' points to valid RGB pixel
+ *      - cl points to a band set up by splitBatch
  *
  * Notes: 
- *      - frees memory for pnm_ppm object and array of code words
+ *      - runs on its own thread, and only touches its own band
+ *      - with -f, the rows go through the integer codec in fixed.c
  *      
  ************************/
-void apply_convert_to_cvc(int i, int j, void *array2D, void *elem, void *cl)
+static void compressBand(void *cl)
 {
-        (void) array2D;
-        cvc_closure cvc = cl;
-
-        struct Pnm_cvc cvc_pixel;
-        Pnm_rgb rgb_pixel = elem;
-
-        float dnm = cvc->rgb_denom;
+        struct band *band = cl;
+        unsigned blocks = band->width / 2;
+
+        for (unsigned row = 0; row < band->rows; row += 2) {
+                unsigned char *raw = band->raw + row * band->stride;
+                unsigned dnm = band->denominator;
+                struct cvc_row *top = &band->top;
+                struct cvc_row *bottom = &band->bottom;
+                double t0 = now();
+
+                splitRow(band, raw);
+                if (band->fixedPoint) {
+                        Fixed_rgb_to_cvc(band->red, band->green, band->blue,
+                        band->width, dnm, &band->fixedTop);
+                } else {
+                        Color_rgb_to_cvc(band->red, band->green, band->blue,
+                        band->width, dnm, top->y, top->b, top->r);
+                }
+                splitRow(band, raw + band->stride);
+                if (band->fixedPoint) {
+                        Fixed_rgb_to_cvc(band->red, band->green, band->blue,
+                        band->width, dnm, &band->fixedBottom);
+                } else {
+                        Color_rgb_to_cvc(band->red, band->green, band->blue,
+                        band->width, dnm, bottom->y, bottom->b, bottom->r);
+                }
+                double t1 = now();
 
-        float r = rgb_pixel->red / dnm;
-        float g = rgb_pixel->green / dnm;
-        float b = rgb_pixel->blue / dnm;
+                if (band->fixedPoint) {
+                        Fixed_quantize_row(&band->fixedTop, 
+                        &band->fixedBottom, blocks, &band->fields);
+                } else {
+                        for (unsigned col = 0; col < band->width; col += 2) {
+                                quantizeBlock(top, bottom, col, 
+                                &band->fields);
+                        }
+                }
+                double t2 = now();
 
-        cvc_pixel.y = 0.299 * r + 0.587 * g + 0.114 * b;
-        cvc_pixel.b = -0.168736 * r - 0.331264 * g + 0.5 * b;
-        cvc_pixel.r = 0.5 * r - 0.418688 * g - 0.081312 * b;
+                Codeword_pack_many(&band->fields, blocks, band->words);
+                CWStream_put(band->words, blocks, 
+                band->packed + (size_t)row / 2 * blocks * 4);
+                double t3 = now();
 
-        struct Pnm_cvc *temp = cvc->methods->at(cvc->pix, i, j);
-        *temp = cvc_pixel;
+                band->seconds[STAGE_COLOR] += t1 - t0;
+                band->seconds[STAGE_DCT] += t2 - t1;
+                band->seconds[STAGE_BITPACK] += t3 - t2;
+        }
 }
 
-/********** packWords ********
+/********** splitRow ********
  *
- * packs CVC pixels into 32-bit code words during compression step
+ * Splits a row of raw samples into band->red, green and blue
  *
  * Parameters:
- *      Pnm_ppm cvcPPM: image in CVC
- *      A2Methods_mapfun *map: mapping function to traverse
- * 
+ *      struct band *band:          the band the row is in
+ *      unsigned char *raw:         the row's samples
+ *
  * Return:
- *      uint32_T t*: array of packed 32-bit code words
+ *      none
  * 
  * Expects:
- *      - 'cvcPPM' must be a valid PPM object in CVC form
- *      - 'map' is valid function pointer
+ *      - 'raw' holds a whole row of samples
  *
  * Notes: 
- *      - frees memory for array of code words
- *      - each code word is a 2x2 block of pixels
+ *      - pixels past band->width (the odd border) are dropped
+ *      - split samples let a row be converted several pixels at a time
  *      
  ************************/
-uint32_t *packWords(Pnm_ppm cvcPPM, A2Methods_mapfun *map)
+static void splitRow(struct band *band, unsigned char *raw)
 {
-        int numBlocks = (int)ceil((float)cvcPPM->width * cvcPPM->height / 4);
-        //Mention it is freed elsewhere
-        uint32_t *codewords = malloc(numBlocks * sizeof(uint32_t));
-        if (codewords == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
+        unsigned char *p = raw;
+        if (band->wide) {
+                for (unsigned col = 0; col < band->width; col++) {
+                        band->red[col] = (p[0] << 8) | p[1];
+                        band->green[col] = (p[2] << 8) | p[3];
+                        band->blue[col] = (p[4] << 8) | p[5];
+                        p += 6;
+                }
+        } else {
+                for (unsigned col = 0; col < band->width; col++) {
+                        band->red[col] = p[0];
+                        band->green[col] = p[1];
+                        band->blue[col] = p[2];
+                        p += 3;
+                }
         }
-
-        map(cvcPPM->pixels, apply_block_packing, codewords);
-
-        return codewords;
 }
 
-/********** apply_block_packing ********
+/********** quantizeBlock ********
  *
- * packs 2x2 block of pixels into 32-bit code word
+ * quantizes a 2x2 block of pixels into the fields of its code word
  *
  * Parameters:
- *      int i: current row index in 2D array
- *      int j: current column index in 2D array
- *      void *array2D: 2D array with pixels
- *      void *elem: unused pointer to current pixel 
- *      void *cl: closure with array of code words        
+ *      struct cvc_row *top: top row of the block
+ *      struct cvc_row *bottom: bottom row of the block
+ *      unsigned col: column of the block's left pixels
+ *      struct cw_row *fields: row of fields to put the block's in
  *
  * Return:
  *      none
  * 
  * Expects:
- *      - 'array2D' is a valid array of pixels
+ *      - all four pixels are valid CVC pixels
  *
  * Notes: 
- *      - top-left pixels of every 2x2 block
+ *      - the block's fields go at index col / 2, ready for 
+ *        Codeword_pack_many
  *      
  ************************/
-void apply_block_packing(int i, int j, void *array2D, void *elem, void *cl)
+static void quantizeBlock(struct cvc_row *top, struct cvc_row *bottom, 
+unsigned col, struct cw_row *fields)
 {
-        (void) elem;
-        /*Looking for "top-left corners"*/
-        if (!(i % 2 == 0 && j % 2 == 0)) {
-                return;
-        }
-        uint32_t *all_codewords = cl;
-        struct Pnm_cvc *pix1 = UArray2_at(array2D, i, j);
-        struct Pnm_cvc *pix2 = UArray2_at(array2D, i+1, j);
-        struct Pnm_cvc *pix3 = UArray2_at(array2D, i, j+1);
-        struct Pnm_cvc *pix4 = UArray2_at(array2D, i+1, j+1);
-        float avg_Pb = (pix1->b + pix2->b + pix3->b + pix4->b) / 4.0;
-        float avg_Pr = (pix1->r + pix2->r + pix3->r + pix4->r) / 4.0;
-
-        unsigned qz_Pb = Arith40_index_of_chroma(avg_Pb);
-        unsigned qz_Pr = Arith40_index_of_chroma(avg_Pr);
-
-        int *abcd = DCT(pix1->y, pix2->y, pix3->y, pix4->y);
-
-        uint32_t codeword = 0;
-        /*Using Bitpack to pack the 32-bit codeword*/
-        codeword = Bitpack_newu(codeword, 4, 0, qz_Pr);
-        codeword = Bitpack_newu(codeword, 4, 4, qz_Pb);
-        codeword = Bitpack_news(codeword, 6, 8, abcd[3]);
-        codeword = Bitpack_news(codeword, 6, 14, abcd[2]);
-        codeword = Bitpack_news(codeword, 6, 20, abcd[1]);
-        codeword = Bitpack_newu(codeword, 6, 26, abcd[0]);
-
-        int index = ((j / 2) * UArray2_width(array2D) / 2) + (i / 2);
-        all_codewords[index] = codeword;
-
-        free(abcd);
+        float avg_Pb = (top->b[col] + top->b[col + 1] + bottom->b[col] + 
+                        bottom->b[col + 1]) / 4.0;
+        float avg_Pr = (top->r[col] + top->r[col + 1] + bottom->r[col] + 
+                        bottom->r[col + 1]) / 4.0;
+
+        unsigned i = col / 2;
+        fields->Pb[i] = Arith40_index_of_chroma(avg_Pb);
+        fields->Pr[i] = Arith40_index_of_chroma(avg_Pr);
+
+        int abcd[4];
+        DCT(top->y[col], top->y[col + 1], bottom->y[col], bottom->y[col + 1],
+            abcd);
+        fields->a[i] = abcd[0];
+        fields->b[i] = abcd[1];
+        fields->c[i] = abcd[2];
+        fields->d[i] = abcd[3];
 }
 
 /********** DCT ********
  *
  * calculates Discrete Cosine Transformation on 4 luminance values from 2x2 
- * block of pixels and returns quantized coefficient
+ * block of pixels and quantizes the coefficients
  *
  * Parameters:
  *      float y1: 1st Y value
  *      float y2: 2nd Y value
  *      float y3: 3rd Y value
  *      float y4: 4th Y value          
+ *      int qz[4]: where to put the 4 quantized DCT coeff
  *
  * Return:
- *      int *: pointer to array of 4 quantized DCT coeff
+ *      none
  * 
  * Expects:
  *      - all Y values must be valid floating point numbers
@@ -447,15 +1241,9 @@ void apply_block_packing(int i, int j, void *array2D, void *elem, void *cl)
  *        within range [-0.3 to 0.3]
  *      
  ************************/
-int *DCT(float y1, float y2, float y3, float y4)
+static void DCT(float y1, float y2, float y3, float y4, int qz[4])
 {
         float flts[4];
-        int *qz = malloc(4 * sizeof(int));
-        if (qz == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
-        }
-
 
         /*a, b, c, d values*/
         flts[0] = (y4 + y3 + y2 + y1) / 4.0;
@@ -475,45 +1263,31 @@ int *DCT(float y1, float y2, float y3, float y4)
                 }
                 qz[i] = (int)round((flts[i] / 0.3) * 31);
         }
-
-        return qz;
 }
 
 /********** writeOut_C ********
  *
- * writes the packed 32-bit codewords to output in Big-endian order 
- * along with a relevant header for the data
+ * writes a batch of codewords, already in big-endian order, to output
  *
  * Parameters:
- *      uint32_t *all_cw:         array pointer of the packed codewords
- *      int width:                width of the image that was compressed
- *      int height:               height of the image that was compressed
+ *      const unsigned char *packed:    the bytes of the codewords
+ *      unsigned count:                 how many codewords there are
  *
  * Return:
  *      none
  *
  * Expects:
- *      - 
+ *      - the header has already been written
  *
  * Notes: 
- *      - Uses the putchar() function to write to standard output
+ *      - each band puts its own codewords in order with CWStream_put, so
+ *        the whole batch goes out with one fwrite
  *      
  ************************/
-void writeOut_C(uint32_t *all_cw, int width, int height)
+static void writeOut_C(const unsigned char *packed, unsigned count)
 {
-        printf("COMP40 Compressed image format 2\n%u %u\n", width, height);
-        
-        int length = (width * height / 4);
-        for (int i = 0; i < length; i++) {
-                uint32_t codeword = all_cw[i];
-
-                uint32_t mask = 255; /*8 bits, all 1s mask*/
-                /*Big-endian order*/
-                putchar((codeword >> 24) & mask);
-                putchar((codeword >> 16) & mask);
-                putchar((codeword >> 8) & mask);
-                putchar(codeword & mask);
-        }
+        size_t written = fwrite(packed, 4, count, stdout);
+        assert(written == count);
 }
 
 /*END OF COMPRESSION FUNCTIONS*/
@@ -521,273 +1295,430 @@ void writeOut_C(uint32_t *all_cw, int width, int height)
 /*START OF DECOMPRESSION FUNCTIONS*/
 
 
+/********** readFormat ********
+ *
+ * reads the start of a compressed image, which says which format it is in
+ *
+ * Parameters:
+ *      FILE *input:              file pointer to an opened file for reading
+ *
+ * Return:
+ *      2 or 3
+ *
+ * Expects:
+ *      - the image starts with "COMP40 " (format 2) or "COMP40\0" "3"
+ *        (format 3)
+ *
+ * Notes: 
+ *      - format 2 is left just past "COMP40" for readHeader; format 3 is
+ *        left past the "3" for Tiled_reader
+ *      
+ ************************/
+static unsigned readFormat(FILE *input)
+{
+        char magic[6];
+        size_t read = fread(magic, 1, sizeof(magic), input);
+        assert(read == sizeof(magic) && memcmp(magic, "COMP40", 6) == 0);
+
+        int c = getc(input);
+        if (c == '\0') {
+                c = getc(input);
+                assert(c == '3');
+                return 3;
+        }
+        assert(c == ' ');
+        ungetc(c, input);
+        return 2;
+}
+
 /********** readHeader ********
  *
- * reads in the compressed 32-bit codewords along with the header 
+ * reads in the rest of the header of a format 2 compressed image
  *
  * Parameters:
  *      FILE *input:              file pointer to an opened file for reading
- *      A2Methods_T methods:      methods suite
- *      A2Methods_mapfun *map:    default mapping funciton (row-major)
+ *      unsigned *width:          where to put the width of the image
+ *      unsigned *height:         where to put the height of the image
  *
  * Return:
- *      A2Methods_UArray2:      UArray2 of all the 32-bit codewords 
+ *      none
  *
  * Expects:
- *      - Header includes a with and height and is followed by a newline then
- *        a sequence of codewords
+ *      - readFormat has read "COMP40", and the header goes on with the 
+ *        width and height followed by a newline then a sequence of 
+ *        codewords
  *
  * Notes: 
- *      - 
+ *      - input is left at the first codeword
  *      
  ************************/
-A2Methods_UArray2 readHeader(FILE *input, A2Methods_T methods, 
-A2Methods_mapfun *map)
+static void readHeader(FILE *input, unsigned *width, unsigned *height)
 {
-        unsigned height, width;
-        int read = fscanf(input, "COMP40 Compressed image format 2\n%u %u", 
-        &width, &height);
+        int read = fscanf(input, " Compressed image format 2\n%u %u", 
+        width, height);
         assert(read == 2);
         int c = getc(input);
         assert(c == '\n');
-
-        /*One codeword for 4 pixels*/
-        width /= 2;
-        height /= 2;
-
-        return setupPixmap(width, height, methods, map, input);
 }
 
-/********** setupPixmap ********
+/********** cropArea ********
  *
- * creates and fills a UArray2 of all the 32-bit codewords
+ * works out which part of the image to write out
  *
  * Parameters:
- *      int width:                width to make the codewords Uarray2
- *      int height:               height to make the codewords Uarray2
- *      A2Methods_T methods:      methods suite
- *      A2Methods_mapfun *map:    default mapping funciton (row-major)
- *      FILE *fp:                 file pointer to an opened file for reading
+ *      unsigned width:           width of the image
+ *      unsigned height:          height of the image
  *
  * Return:
- *      A2Methods_UArray2 cw_all: UArray2 of all the 32-bit codewords 
+ *      the --crop rectangle cut down to fit in the image, or the whole 
+ *      image without --crop
  *
  * Expects:
- *      - Width and height are set to hold the exact amount of codewords
- *        available
  *
  * Notes: 
- *      - Calls an apply function to read the codewords in Big Endian order
+ *      - exits with an error if the rectangle starts outside the image
  *      
  ************************/
-A2Methods_UArray2 setupPixmap(int width, int height, A2Methods_T methods, 
-A2Methods_mapfun *map, FILE *fp)
+static struct rect cropArea(unsigned width, unsigned height)
 {
-        A2Methods_UArray2 cw_all = methods->new(width, height, 
-        sizeof(uint64_t));
-        map(cw_all, apply_handle_codewords, fp);
+        struct rect area = { 0, 0, width, height };
+        if (!cropping) {
+                return area;
+        }
+        if (crop.x >= width || crop.y >= height) {
+                fprintf(stderr, "--crop %ux%u+%u+%u is outside the %ux%u "
+                        "image\n", crop.width, crop.height, crop.x, crop.y, 
+                        width, height);
+                exit(EXIT_FAILURE);
+        }
 
-        return cw_all;
+        area = crop;
+        area.width = width - crop.x < crop.width ? width - crop.x 
+                                                 : crop.width;
+        area.height = height - crop.y < crop.height ? height - crop.y 
+                                                    : crop.height;
+        return area;
 }
 
-/********** apply_handle_codewords ********
+/********** decompressTiled ********
  *
- * reads in a codeword in big endian order and stores it in the UArray2
+ * decompresses a format 3 image a row of tiles at a time
  *
  * Parameters:
- *      int i:                    current col index
- *      int j:                    current row index
- *      void *array2D:            pointer to codewords UA2
- *      void *elem:               pointer to the element at i, j in the UA2
- *      void *cl:                 closure pointing to the file being read
+ *      FILE *fp:         the image, just past "COMP40\0" "3"
+ *      double start:     when decompression started, for --stats
  *
  * Return:
- *      None 
- *
+ *      none
+ * 
  * Expects:
- *      - Elem and cl are pointing to uint64_ts and FILEs respectively
+ *      - fp holds a whole format 3 image
  *
  * Notes: 
- *      - array2D, i, j are all unused
- *      - updates the uint64_t objects in the all_cw UA2
+ *      - only rows of tiles and tiles the --crop rectangle touches are 
+ *        decompressed; the threads split each row of tiles between them
+ *      - each tile is decompressed by decompressBand, as a band as wide 
+ *        as the tile
  *      
  ************************/
-void apply_handle_codewords(int i, int j, void *array2D, void *elem, void *cl)
+static void decompressTiled(FILE *fp, double start)
 {
-        (void) array2D;
-        (void) i;
-        (void) j;
+        double seconds[STAGES] = { 0 };
+        Tiled_T tiles = Tiled_reader(fp);
+        seconds[STAGE_READ] += now() - start;
+
+        unsigned width, height, tileWidth, tileHeight;
+        Tiled_geometry(tiles, &width, &height, &tileWidth, &tileHeight);
+
+        /*From here on, sizes are of what is written out: a preview is half
+        as wide and half as tall, and so are its tiles*/
+        unsigned scale = preview ? 2 : 1;
+        unsigned blocks = tileWidth / 2;
+        width /= scale;
+        height /= scale;
+        tileWidth /= scale;
+        tileHeight /= scale;
+        struct rect area = cropArea(width, height);
+        int denominator = 255;
+        size_t stride = (size_t)width * 3;
+        struct band *bands = newBands(threads, blocks * 2, stride, false, 
+        denominator);
+        for (unsigned i = 0; i < threads; i++) {
+                bands[i].preview = preview;
+                if (Tiled_entropy(tiles)) {
+                        bands[i].packed = malloc((size_t)blocks * 
+                                                 (tileHeight * scale / 2) * 
+                                                 4);
+                        if (bands[i].packed == NULL) {
+                                fprintf(stderr, 
+                                        "Error allocating memory.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                }
+        }
 
-        uint64_t *cw = elem;
-        FILE *toRead = cl;
-        assert(toRead != NULL);
+        unsigned char *pixels = malloc(tileHeight * stride + 1);
+        struct tile_job *jobs = malloc(threads * sizeof(struct tile_job));
+        if (pixels == NULL || jobs == NULL) {  
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
 
-        uint64_t holder = 0;
-        uint64_t word_being_built = 0;
+        if (fixedPoint) {
+                Fixed_setup();
+        }
+        if (preview) {
+                previewSetup();
+        }
+        Pool_T pool = Pool_new(threads);
+        printf("P6\n%u %u\n%u\n", area.width, area.height, denominator);
+        unsigned first = area.x / tileWidth;
+        unsigned end = (area.x + area.width + tileWidth - 1) / tileWidth;
+        for (unsigned row = area.y / tileHeight; 
+             row * tileHeight < area.y + area.height; row++) {
+                for (unsigned i = 0; i < threads; i++) {
+                        jobs[i] = (struct tile_job){ &bands[i], tiles, row, 
+                                first + i, end, threads, tileWidth, pixels };
+                }
+                Pool_run(pool, decompressTiles, jobs, 
+                sizeof(struct tile_job));
+
+                double t = now();
+                unsigned top = row * tileHeight;
+                unsigned rows = height - top < tileHeight ? height - top 
+                                                          : tileHeight;
+                writeOut_D(pixels, stride, top, rows, &area);
+                seconds[STAGE_WRITE] += now() - t;
+        }
 
-        /*Reading in assuming that codewords are in Big Endian order*/
-        for (int x = 24; x >= 0; x = x - 8) {
-                holder = getc(toRead);
-                word_being_built = word_being_built | (holder << x);
+        if (showStats) {
+                fflush(stdout);
+                addBandStats(bands, threads, seconds);
+                printStats("decompress", seconds, now() - start);
+        }
+        Pool_free(&pool);
+        Tiled_free(&tiles);
+        for (unsigned i = 0; i < threads; i++) {
+                free(bands[i].packed);
         }
-        *cw = word_being_built;
+        freeBands(bands, threads);
+        free(pixels);
+        free(jobs);
 }
 
-/********** unpackCW ********
+/********** decompressTiles ********
  *
- * unpacks the codewords UArray2 into a Uarray2 of codeword data structs
+ * decompresses a thread's share of a row of tiles
  *
  * Parameters:
- *      A2Methods_UArray2 ua2:    UA2 of the codewords
- *      A2Methods_T methods:      methods suite
- *      A2Methods_mapfun *map:    default mapping funciton (row-major)
+ *      void *cl:       the thread's tile_job
  *
  * Return:
- *      A2Methods_UArray2 unpacked: UArray2 of structs containing the data from
- *                                  each codeword
- *
+ *      none
+ * 
  * Expects:
- *      - 'unpacked' is freed elesewhere after its done being used
+ *      - cl points to a tile_job set up by decompressTiled
  *
  * Notes: 
- *      - Calls an apply function to unpack each codeword
- *      - Uses the cw_data struct to store a, b, c, d, Pb, Pr as uint64_ts
+ *      - runs on its own thread; each tile goes to its own columns of the
+ *        pixels
+ *      - finding a tile (checking its CRC-32C and entropy decoding it) 
+ *        counts as reading it; an entropy coded tile is decoded into the
+ *        band's 'packed'
  *      
  ************************/
-A2Methods_UArray2 unpackCW(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map)
+static void decompressTiles(void *cl)
 {
-        struct cvc_closure *cl = malloc(sizeof(*cl));
-        if (cl == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
+        struct tile_job *job = cl;
+        struct band *band = job->band;
+
+        for (unsigned col = job->first; col < job->end; col += job->step) {
+                double t = now();
+                unsigned width, height;
+                band->source = Tiled_tile(job->tiles, col, job->row, &width, 
+                                          &height, band->packed);
+                band->seconds[STAGE_READ] += now() - t;
+
+                band->width = width;
+                band->rows = height;
+                band->raw = job->pixels + (size_t)col * job->tileWidth * 3;
+                decompressBand(band);
         }
+}
+
+/********** decompressBand ********
+ *
+ * turns the code words of a band into rows of RGB pixels
+ *
+ * Parameters:
+ *      void *cl:       the band
+ *
+ * Return:
+ *      none
+ * 
+ * Expects:
+ *      - cl points to a band set up by splitBatch
+ *
+ * Notes: 
+ *      - runs on its own thread, and only touches its own band
+ *      - both rows of a block share its chroma, so only band->top's 
+ *        chroma is used
+ *      - with -f, the rows go through the integer codec in fixed.c
+ *      - a preview band writes one row of pixels for each row of code 
+ *        words, a pixel per code word
+ *      
+ ************************/
+static void decompressBand(void *cl)
+{
+        struct band *band = cl;
+        struct cvc_row *top = &band->top;
+        struct cvc_row *bottom = &band->bottom;
+        unsigned blocks = band->width / 2;
+
+        for (unsigned row = 0; row < band->rows; row += 2) {
+                const unsigned char *source = band->source + 
+                                              (size_t)row / 2 * blocks * 4;
+                unsigned char *pixels = band->raw + 
+                                        (band->preview ? row / 2 : row) * 
+                                        band->stride;
+                double t0 = now();
+
+                CWStream_get(source, blocks, band->words);
+                Codeword_unpack_many(band->words, blocks, &band->fields);
+                double t1 = now();
+                band->seconds[STAGE_BITPACK] += t1 - t0;
+
+                /*A preview skips the inverse DCT: a is the block's Y*/
+                if (band->preview) {
+                        if (band->fixedPoint) {
+                                Fixed_preview_row(&band->fields, blocks, 
+                                band->denominator, pixels);
+                        } else {
+                                previewRow(&band->fields, blocks, top);
+                                Color_cvc_to_rgb(top->y, top->b, top->r, 
+                                blocks, band->denominator, pixels);
+                        }
+                        band->seconds[STAGE_COLOR] += now() - t1;
+                        continue;
+                }
 
-        A2Methods_UArray2 unpacked = methods->new(methods->width(ua2), 
-        methods->height(ua2), sizeof(struct cw_data));
+                /*The integer codec does the inverse DCT and color together*/
+                if (band->fixedPoint) {
+                        Fixed_decode_row(&band->fields, blocks, 
+                        band->denominator, pixels, pixels + band->stride);
+                        band->seconds[STAGE_DCT] += now() - t1;
+                        continue;
+                }
+
+                for (unsigned col = 0; col < blocks; col++) {
+                        struct cw_data block;
+                        block.a = band->fields.a[col];
+                        block.b = band->fields.b[col];
+                        block.c = band->fields.c[col];
+                        block.d = band->fields.d[col];
+                        block.Pb = band->fields.Pb[col];
+                        block.Pr = band->fields.Pr[col];
+                        floatConvert(&block);
+
+                        top->y[col * 2] = block.val1;
+                        top->y[col * 2 + 1] = block.val2;
+                        bottom->y[col * 2] = block.val3;
+                        bottom->y[col * 2 + 1] = block.val4;
+                        top->b[col * 2] = top->b[col * 2 + 1] = block.Pb1;
+                        top->r[col * 2] = top->r[col * 2 + 1] = block.Pr1;
+                }
 
-        /*Using a closure struct to be able to pass the apply function both the
-        methods suite and the new UA2, unapcked*/
-        cl->pix = unpacked;
-        cl->methods = methods;
+                double t2 = now();
 
-        map(ua2, apply_unpack_codewords, cl);
+                /*Top row of pixels first, then the bottom row*/
+                Color_cvc_to_rgb(top->y, top->b, top->r, band->width, 
+                band->denominator, pixels);
+                Color_cvc_to_rgb(bottom->y, top->b, top->r, band->width, 
+                band->denominator, pixels + band->stride);
+                double t3 = now();
 
-        free(cl);
-        return unpacked;
+                band->seconds[STAGE_DCT] += t2 - t1;
+                band->seconds[STAGE_COLOR] += t3 - t2;
+        }
 }
 
-/********** apply_unpack_codewords ********
+/********** previewSetup ********
  *
- * unpacks the data in a codeword and stores it in a separate struct
+ * fills in the tables previewRow uses
  *
  * Parameters:
- *      int i:                    current col index
- *      int j:                    current row index
- *      void *array2D:            pointer to codewords UA2
- *      void *elem:               pointer to the element at i, j in the UA2
- *      void *cl:                 closure pointer to the object containing
- *                                the Uarray2 of cw_data structs
+ *      none
  *
  * Return:
- *      None 
- *
+ *      none
+ * 
  * Expects:
- *      - elem and cl are pointing to initialized uint64_ts and cvc_closures 
- *        respectively
- *   
+ *      - no thread is running previewRow
+ *
  * Notes: 
- *      - array2D is unused
- *      - updates the cw_data objects in the cvc->pix UA2 (aka unpacked)
+ *      - the values are worked out the same way as in floatConvert
  *      
  ************************/
-void apply_unpack_codewords(int i, int j, void *array2D, void *elem, void *cl)
+static void previewSetup(void)
 {
-        (void) array2D;
-        
-        uint64_t currCW = *((uint64_t *)elem);
-        struct cvc_closure *closure = cl;
-        cw_data CWDATA = closure->methods->at(closure->pix, i, j);
-
-        CWDATA->Pr = Bitpack_getu(currCW, 4, 0);
-        CWDATA->Pb = Bitpack_getu(currCW, 4, 4);
-        CWDATA->d = Bitpack_gets(currCW, 6, 8);
-        CWDATA->c = Bitpack_gets(currCW, 6, 14);
-        CWDATA->b = Bitpack_gets(currCW, 6, 20);
-        CWDATA->a = Bitpack_getu(currCW, 6, 26);
+        for (unsigned a = 0; a < 64; a++) {
+                previewLuma[a] = (float)a / 63.0;
+        }
+        for (unsigned i = 0; i < 16; i++) {
+                previewChroma[i] = Arith40_chroma_of_index(i);
+        }
 }
 
-/********** floatConvert ********
+/********** previewRow ********
  *
- * converts the codeword data from uint64_ts to floats and applys an inverse
- * discrete cosine transformation
+ * turns a row of code words into a row of CVC pixels, one per code word
  *
  * Parameters:
- *      A2Methods_UArray2 ua2:    UA2 of the cw_data structs
- *      A2Methods_T methods:      methods suite
- *      A2Methods_mapfun *map:    default mapping funciton (row-major)
+ *      const struct cw_row *fields:  the fields of each code word
+ *      unsigned blocks:              how many code words there are
+ *      struct cvc_row *row:          where to put the pixels
  *
  * Return:
- *      A2Methods_UArray2 ua2: UArray2 of structs containing the data from
- *                             each codeword, now with float variables
- *
+ *      none
+ * 
  * Expects:
- *      - 
+ *      - previewSetup has been called
  *
  * Notes: 
- *      - Calls an apply function to convert each cw_data struct
+ *      - a is the average Y of the block, and Pb and Pr are its average 
+ *        chroma, so each pixel is the average of the block it stands for
  *      
  ************************/
-A2Methods_UArray2 floatConvert(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map)
+static void previewRow(const struct cw_row *fields, unsigned blocks, 
+struct cvc_row *row)
 {
-        void *cl = NULL;
-        (void) methods;
-
-        map(ua2, apply_float_conversions, cl);
-
-        return ua2;
+        for (unsigned col = 0; col < blocks; col++) {
+                row->y[col] = previewLuma[fields->a[col]];
+                row->b[col] = previewChroma[fields->Pb[col]];
+                row->r[col] = previewChroma[fields->Pr[col]];
+        }
 }
 
-/********** apply_float_conversions ********
+/********** floatConvert ********
  *
  * converts a, b, c, d, Pb, Pr in a cw_data struct to floats and sends them 
- * through an inverse DCT as needed
+ * through an inverse DCT
  *
  * Parameters:
- *      int i:                    current col index
- *      int j:                    current row index
- *      void *array2D:            pointer to the cw_data UA2
- *      void *elem:               pointer to the element at i, j in the UA2
- *      void *cl:                 closure void pointer 
+ *      cw_data curr:             the unpacked codeword
  *
  * Return:
  *      None 
  *
  * Expects:
- *      - elem is pointing to a cw_data struct with initialized uint64_t vals
+ *      - curr is pointing to a cw_data struct with initialized uint64_t vals
  *   
  * Notes: 
- *      - array2D, i, j, cl are all unused
  *      - calls the inverseDCT function for the float a, b, c, d values
- *      - updates the cw_data objects in the ua2
  *      
  ************************/
-void apply_float_conversions(int i, int j, void *array2D, void *elem, void *cl)
+static void floatConvert(cw_data curr)
 {
-        (void) i;
-        (void) j;
-        (void) array2D;
-        (void) cl;
-        
-        if (elem == NULL) {
-                fprintf(stderr, 
-                "Error: Null pointer in apply_float_conversions\n");
-                exit(EXIT_FAILURE);
-        }
-
-        cw_data curr = ((cw_data)elem);
-
         curr->Pb1 = Arith40_chroma_of_index(curr->Pb);
         curr->Pr1 = Arith40_chroma_of_index(curr->Pr);
         
@@ -821,7 +1752,7 @@ void apply_float_conversions(int i, int j, void *array2D, void *elem, void *cl)
  *        now represent luma values
  *      
  ************************/
-void inverseDCT(cw_data x)
+static void inverseDCT(cw_data x)
 {
         float y1 = x->val1 - x->val2 - x->val3 + x->val4;
         float y2 = x->val1 - x->val2 + x->val3 - x->val4;
@@ -836,252 +1767,50 @@ void inverseDCT(cw_data x)
         x->val4 = y4;
 }
 
-/********** blocks_to_cvcPixels ********
- *
- * creates and fills a pnm_ppm with pixels in cvc format from the 
- * Uarray2 of cw_data
- *
- * Parameters:
- *      A2Methods_UArray2 ua2:    UA2 of the cw_data structs
- *      A2Methods_T methods:      methods suite
- *      A2Methods_mapfun *map:    default mapping funciton (row-major)
- *
- * Return:
- *      Pnm_ppm final:  Pnm_ppm representing the full decompressed image 
- *                      with pixels in cvc format
- *
- * Expects:
- *      - The pnm_ppm being created is freed at the end of decompress40
- *
- * Notes: 
- *      - Calls an apply function to convert transfer the data from a single 
- *        cw_data struct into 4 different cvc pixels
- *      - We found a denominator value of 255 to be best for flowers.ppm
- *      
- ************************/
-Pnm_ppm blocks_to_cvcPixels(A2Methods_UArray2 ua2, A2Methods_T methods, 
-A2Methods_mapfun *map)
-{
-        int denominator = 255;
-        int cvcWidth = UArray2_width(ua2) * 2;
-        int cvcHeight = UArray2_height(ua2) * 2;
-        A2Methods_UArray2 cvcPixels = methods->new(cvcWidth, cvcHeight, 
-        sizeof(struct Pnm_cvc));
-
-        /*Using a closure struct to be able to pass the apply function both the
-        methods suite and the new cvcPixels UA2*/
-        cvc_closure cl = (cvc_closure)malloc(sizeof(struct cvc_closure));
-        if (cl == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
-        }
-        cl->pix = cvcPixels;
-        cl->methods = methods;
-
-        map(ua2, apply_make_cvc_pixelmap, cl);
-
-        Pnm_ppm final = (Pnm_ppm)malloc(sizeof(struct Pnm_ppm));
-        final->pixels = cl->pix;
-        final->denominator = denominator;
-        final->methods = methods;
-        final->width = cvcWidth;
-        final->height = cvcHeight;
-
-        free(cl);
-        return final;
-}
-
-/********** apply_make_cvc_pixelmap ********
- *
- * converts the floats in a cw_data struct to y, Pb, Pr vals for a 2x2 block
- *
- * Parameters:
- *      int i:                    current col index
- *      int j:                    current row index
- *      void *array2D:            pointer to the cw_data UA2
- *      void *elem:               pointer to the element at i, j in the UA2
- *      void *cl:                 closure pointer to the object containing
- *                                the cvc_pixel pixelmap
- *
- * Return:
- *      None 
- *
- * Expects:
- *      - elem is pointing to a cw_data struct with initialized float vals
- *      - the object cl points to has an allocated pix object of correct
- *        size
- *   
- * Notes: 
- *      - array2D is unused
- *      
- ************************/
-void apply_make_cvc_pixelmap(int i, int j, void *array2D, void *elem, void *cl)
-{
-        (void) array2D;
-        
-        cw_data currCW = ((cw_data)elem);
-        cvc_closure cvc = cl;
-
-        struct Pnm_cvc *pix1 = cvc->methods->at(cvc->pix, (i*2), (j*2));
-        struct Pnm_cvc *pix2 = cvc->methods->at(cvc->pix, (i*2)+1, (j*2));
-        struct Pnm_cvc *pix3 = cvc->methods->at(cvc->pix, (i*2), (j*2)+1);
-        struct Pnm_cvc *pix4 = cvc->methods->at(cvc->pix, (i*2)+1, (j*2)+1);
-
-        pix1->y = currCW->val1;
-        pix2->y = currCW->val2;
-        pix3->y = currCW->val3;
-        pix4->y = currCW->val4;
-
-        pix1->b = currCW->Pb1;
-        pix2->b = currCW->Pb1;
-        pix3->b = currCW->Pb1;
-        pix4->b = currCW->Pb1;
-
-        pix1->r = currCW->Pr1;
-        pix2->r = currCW->Pr1;
-        pix3->r = currCW->Pr1;
-        pix4->r = currCW->Pr1;
-}
-
-/********** CVCtoRGB ********
- *
- * converts image from CVC to RGB
- *
- * Parameters:
- *      Pnm_ppm cvc: image in CVC color space
- *      A2Methods_T methods: methods for altering 2D array
- *      A2Methods_mapfun *map: mapping function to help traverse array
- *      int dnm: denominator to scale RGB values              
- *
- * Return:
- *      Pnm_ppm: image transformed back to RGB format
- * 
- * Expects:
- *      - 'cvc' is a valid Pnm_ppm
- *      - 'methods' is a valid A2Methods_T object
- *      - 'map' is a function pointer
- *
- * Notes: 
- *      - frees CVC pixel array
- *      
- ************************/
-Pnm_ppm CVCtoRGB(Pnm_ppm cvc, A2Methods_T methods, 
-A2Methods_mapfun *map, int dnm)
-{
-        int rgbWidth = cvc->width;
-        int rgbHeight = cvc->height;
-
-        A2Methods_UArray2 *rgbPixels = methods->new(rgbWidth, rgbHeight, 
-        sizeof(struct Pnm_rgb));
-
-        //Need to free this eventually
-        /*Custom struct storing all data we need access to in
-        the apply function*/
-        cvc_closure cl = (cvc_closure)malloc(sizeof(struct cvc_closure));
-        if (cl == NULL) {  
-                fprintf(stderr, "Error allocating memory.\n");
-                exit(EXIT_FAILURE);
-        }
-        cl->pix = rgbPixels;
-        cl->rgb_denom = dnm;
-        cl->methods = methods;
-
-        map(cvc->pixels, apply_convert_to_rgb, cl);
-        methods->free(&cvc->pixels);
-        cvc->pixels = cl->pix;
-
-        free(cl);
-        return cvc;
-}
-
-/********** apply_convert_to_rgb ********
+/********** writeOut_D ********
  *
- * takes single pixel and converts it from CVC to RGB
+ * Writes the part of some rows of a decompressed PPM image that is in the
+ * area being written out to stdout
  *
  * Parameters:
- *      int i: current row index in 2D array
- *      int j: current column index in 2D array
- *      void *array2D: unused 2D array
- *      void *elem: pointer to current CVC pixel
- *      void *cl: closure with information for transformation            
+ *      const unsigned char *pixels: the rows of pixels, 3 bytes each
+ *      size_t stride:          how many bytes a row takes up
+ *      unsigned first:         which row of the image the first row is
+ *      unsigned rows:          how many rows there are
+ *      const struct rect *area: the part of the image to write out
  *
  * Return:
  *      none
  * 
  * Expects:
- *      - 'elem' points to valid RGB pixel
+ *      - the P6 header has already been written
  *
  * Notes: 
- *      - frees memory for pnm_ppm object and array of code words
+ *      - whole rows go out with one fwrite
  *      
  ************************/
-void apply_convert_to_rgb(int i, int j, void *array2D, void *elem, void *cl)
+static void writeOut_D(const unsigned char *pixels, size_t stride, 
+unsigned first, unsigned rows, const struct rect *area)
 {
-        (void) array2D;
-        cvc_closure rgb = cl;
-
-        Pnm_rgb rgb_pixel = rgb->methods->at(rgb->pix, i, j);
-        struct Pnm_cvc *cvc_pixel = elem;
-
-        float dnm = (float)rgb->rgb_denom;
-
-        float y = cvc_pixel->y;
-        float b = cvc_pixel->b;
-        float r = cvc_pixel->r;
-
-        float toR = (1.0 * y + 0.0 * b + 1.402 * r);
-        float toG = (1.0 * y - 0.344136 * b - 0.714136 * r);
-        float toB = (1.0 * y + 1.772 * b + 0.0 * r);
-
-        /*Check for edge cases where RGB values get our of range*/
-        if (toR < 0) {
-                toR = 0.0;
-        }
-        if (toR > 1) {
-                toR = 1.0;
-        }
-        if (toG < 0) {
-                toG = 0.0;
-        }
-        if (toG > 1) {
-                toG = 1.0;
+        unsigned top = first > area->y ? first : area->y;
+        unsigned bottom = first + rows < area->y + area->height ? 
+                          first + rows : area->y + area->height;
+        if (bottom <= top || area->width == 0) {
+                return;
         }
-        if (toB < 0) {
-                toB = 0.0;
+
+        pixels += (top - first) * stride;
+        if (area->width * 3 == stride) {
+                size_t written = fwrite(pixels, stride, bottom - top, stdout);
+                assert(written == bottom - top);
+                return;
         }
-        if (toB > 1) {
-                toB = 1.0;
+        for (unsigned row = top; row < bottom; row++) {
+                size_t written = fwrite(pixels + area->x * 3, 3, area->width, 
+                                        stdout);
+                assert(written == area->width);
+                pixels += stride;
         }
-
-        toR = toR * dnm;
-        toG = toG * dnm;
-        toB = toB * dnm;
-
-        rgb_pixel->red = (int)(toR);
-        rgb_pixel->green = (int)(toG);
-        rgb_pixel->blue = (int)(toB);
-}
-
-/********** writeOut_D ********
- *
- * Writes a decompressed PPM image to stdout 
- *
- * Parameters:
- *      pnm_ppm final: pointer to PPM image             
- *
- * Return:
- *      none
- * 
- * Expects:
- *      - final must be a valid Pnm_ppm object
- *
- * Notes: 
- *      - writes image in PPM format to stdout
- *      
- ************************/
-void writeOut_D(Pnm_ppm final)
-{
-    Pnm_ppmwrite(stdout, final);
 }
 
 /*END OF DECOMPRESSION FUNCTIONS*/
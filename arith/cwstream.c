@@ -0,0 +1,307 @@
+/*
+*     cwstream.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for the CWStream interface
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "cwstream.h"
+
+#if defined(__SSE2__)
+#define CWSTREAM_SIMD
+#include <emmintrin.h>
+#endif
+
+#define T CWStream_T
+
+struct T {
+        FILE *fp;
+
+        /*The whole file when it is mapped, and where the next code word
+        is in it*/
+        unsigned char *map;
+        size_t mapSize;
+        size_t next;
+
+        /*Otherwise code words are read into 'buffer'*/
+        unsigned char *buffer;
+        size_t bufferSize;
+};
+
+#ifdef CWSTREAM_SIMD
+static inline __m128i swap4(__m128i words);
+#endif
+
+/********** CWStream_put ********
+ *
+ * turns code words into their big-endian bytes
+ *
+ * Parameters:
+ *      const uint32_t *words:  the code words
+ *      unsigned count:         how many code words there are
+ *      unsigned char *bytes:   where to put their 4 * 'count' bytes
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'words' and 'bytes' don't overlap
+ *
+ * Notes:
+ *      - swaps 4 code words at a time with SSE2 where there is SSE2
+ *
+ ************************/
+void CWStream_put(const uint32_t *words, unsigned count,
+unsigned char *bytes)
+{
+        unsigned i = 0;
+#ifdef CWSTREAM_SIMD
+        for (; i + 4 <= count; i += 4) {
+                __m128i w = _mm_loadu_si128((const __m128i *)&words[i]);
+                _mm_storeu_si128((__m128i *)&bytes[i * 4], swap4(w));
+        }
+#endif
+        for (; i < count; i++) {
+                uint32_t word = words[i];
+                unsigned char *b = &bytes[i * 4];
+                b[0] = word >> 24;
+                b[1] = word >> 16;
+                b[2] = word >> 8;
+                b[3] = word;
+        }
+}
+
+/********** CWStream_get ********
+ *
+ * puts code words together from their big-endian bytes
+ *
+ * Parameters:
+ *      const unsigned char *bytes:     the 4 * 'count' bytes
+ *      unsigned count:                 how many code words there are
+ *      uint32_t *words:                where to put the code words
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'words' and 'bytes' don't overlap
+ *
+ * Notes:
+ *      - swaps 4 code words at a time with SSE2 where there is SSE2
+ *
+ ************************/
+void CWStream_get(const unsigned char *bytes, unsigned count,
+uint32_t *words)
+{
+        unsigned i = 0;
+#ifdef CWSTREAM_SIMD
+        for (; i + 4 <= count; i += 4) {
+                __m128i b = _mm_loadu_si128((const __m128i *)&bytes[i * 4]);
+                _mm_storeu_si128((__m128i *)&words[i], swap4(b));
+        }
+#endif
+        for (; i < count; i++) {
+                const unsigned char *b = &bytes[i * 4];
+                words[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+                           ((uint32_t)b[2] << 8) | b[3];
+        }
+}
+
+/********** CWStream_reader ********
+ *
+ * starts reading the code words of a compressed image
+ *
+ * Parameters:
+ *      FILE *fp:       the compressed image, just past its header
+ *
+ * Return:
+ *      a new stream; free it with CWStream_free
+ *
+ * Expects:
+ *      - 'fp' is not NULL
+ *
+ * Notes:
+ *      - a regular file is mapped into memory, so CWStream_read can hand
+ *        out the code words where they are without copying them; anything
+ *        else (like a pipe) is read with fread
+ *
+ ************************/
+T CWStream_reader(FILE *fp)
+{
+        assert(fp != NULL);
+        T stream = calloc(1, sizeof(*stream));
+        if (stream == NULL) {
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+        stream->fp = fp;
+
+        struct stat info;
+        long offset = ftell(fp);
+        if (offset < 0 || fstat(fileno(fp), &info) != 0 ||
+            !S_ISREG(info.st_mode) || info.st_size <= offset) {
+                return stream;
+        }
+
+        void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(fp), 0);
+        if (map == MAP_FAILED) {
+                return stream;
+        }
+        madvise(map, info.st_size, MADV_SEQUENTIAL);
+        stream->map = map;
+        stream->mapSize = info.st_size;
+        stream->next = offset;
+        return stream;
+}
+
+/********** CWStream_read ********
+ *
+ * reads the next code words of a compressed image
+ *
+ * Parameters:
+ *      CWStream_T stream:      the stream
+ *      size_t count:           how many code words to read
+ *
+ * Return:
+ *      the code words' 4 * 'count' bytes, good until the next
+ *      CWStream_read or CWStream_free
+ *
+ * Expects:
+ *      - 'stream' is not NULL
+ *      - there are 'count' more code words
+ *
+ * Notes:
+ *
+ ************************/
+const unsigned char *CWStream_read(T stream, size_t count)
+{
+        assert(stream != NULL);
+        size_t bytes = count * 4;
+
+        if (stream->map != NULL) {
+                assert(stream->mapSize - stream->next >= bytes);
+                const unsigned char *words = stream->map + stream->next;
+                stream->next += bytes;
+                return words;
+        }
+
+        if (stream->bufferSize < bytes) {
+                free(stream->buffer);
+                stream->buffer = malloc(bytes);
+                if (stream->buffer == NULL) {
+                        fprintf(stderr, "Error allocating memory.\n");
+                        exit(EXIT_FAILURE);
+                }
+                stream->bufferSize = bytes;
+        }
+        size_t read = fread(stream->buffer, 1, bytes, stream->fp);
+        assert(read == bytes);
+        return stream->buffer;
+}
+
+/********** CWStream_rest ********
+ *
+ * reads everything that is left of a compressed image
+ *
+ * Parameters:
+ *      CWStream_T stream:      the stream
+ *      size_t *size:           where to put how many bytes are left
+ *
+ * Return:
+ *      the bytes, good until the next CWStream_read or CWStream_free
+ *
+ * Expects:
+ *      - 'stream' and 'size' are not NULL
+ *
+ * Notes:
+ *      - for formats that need to jump around in the file; a mapped file
+ *        still isn't copied, but anything else is read into memory whole
+ *
+ ************************/
+const unsigned char *CWStream_rest(T stream, size_t *size)
+{
+        assert(stream != NULL && size != NULL);
+        if (stream->map != NULL) {
+                *size = stream->mapSize - stream->next;
+                stream->next = stream->mapSize;
+                return stream->map + stream->next - *size;
+        }
+
+        *size = 0;
+        for (;;) {
+                if (stream->bufferSize - *size < 4096) {
+                        size_t grown = stream->bufferSize * 2 + 65536;
+                        unsigned char *buffer = realloc(stream->buffer, 
+                                                        grown);
+                        if (buffer == NULL) {
+                                fprintf(stderr, 
+                                        "Error allocating memory.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        stream->buffer = buffer;
+                        stream->bufferSize = grown;
+                }
+                size_t read = fread(stream->buffer + *size, 1, 
+                                    stream->bufferSize - *size, stream->fp);
+                *size += read;
+                if (read == 0) {
+                        break;
+                }
+        }
+        assert(!ferror(stream->fp));
+        return stream->buffer;
+}
+
+/********** CWStream_free ********
+ *
+ * stops reading a compressed image
+ *
+ * Parameters:
+ *      CWStream_T *stream:     pointer to the stream
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'stream' and '*stream' are not NULL
+ *
+ * Notes:
+ *      - doesn't close the file; sets '*stream' to NULL
+ *
+ ************************/
+void CWStream_free(T *stream)
+{
+        assert(stream != NULL && *stream != NULL);
+        if ((*stream)->map != NULL) {
+                munmap((*stream)->map, (*stream)->mapSize);
+        }
+        free((*stream)->buffer);
+        free(*stream);
+        *stream = NULL;
+}
+
+#ifdef CWSTREAM_SIMD
+/********** swap4 ********
+ *
+ * reverses the bytes of each of 4 code words
+ *
+ ************************/
+static inline __m128i swap4(__m128i words)
+{
+        /*Swap the bytes of each 16-bit half, then swap the halves*/
+        __m128i bytes = _mm_or_si128(_mm_slli_epi16(words, 8),
+                                     _mm_srli_epi16(words, 8));
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(bytes, 0xb1), 0xb1);
+}
+#endif
+
+#undef T
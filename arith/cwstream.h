@@ -0,0 +1,35 @@
+/*
+*     cwstream.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for reading and writing code words as they are stored in a
+*     compressed image: 4 bytes each, big-endian
+*/
+
+#ifndef CWSTREAM_INCLUDED
+#define CWSTREAM_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define T CWStream_T
+typedef struct T *T;
+
+/*Convert between code words and their bytes; the bytes don't have to be
+aligned*/
+extern void CWStream_put(const uint32_t *words, unsigned count,
+unsigned char *bytes);
+extern void CWStream_get(const unsigned char *bytes, unsigned count,
+uint32_t *words);
+
+/*Reads the code words after the header of a compressed image in 'fp',
+mapping the file into memory when it can*/
+extern T CWStream_reader(FILE *fp);
+extern const unsigned char *CWStream_read(T stream, size_t count);
+extern const unsigned char *CWStream_rest(T stream, size_t *size);
+extern void CWStream_free(T *stream);
+
+#undef T
+#endif
@@ -0,0 +1,737 @@
+/*
+*     entropy.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for entropy coding the code words of a tile.
+*
+*     Each field of each code word becomes a symbol: a, Pb and Pr as the
+*     difference from the code word to the left (or above, for the first
+*     column), and b, c and d as they are, all zigzagged so small values
+*     come first. The symbols go through rANS (range asymmetric numeral
+*     systems). Code words are taken WAYS at a time, and each field of each
+*     gets its own state, so none of the STATES symbols of a group waits on
+*     another; with AVX2 they are decoded 8 at a time.
+*
+*     Rather than sending its own frequencies, a tile picks one of PRESETS
+*     geometric distributions for each field, which costs 4 bits a field;
+*     the tables for all of them are built once by Entropy_setup.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "codeword.h"
+#include "entropy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ENTROPY_SIMD
+#include <immintrin.h>
+#endif
+
+/*Frequencies add up to 2^SCALE_BITS; a state is kept in [RANS_L, 2^31),
+and moves 16 bits at a time, so one refill is always enough*/
+#define SCALE_BITS 12
+#define SCALE (1 << SCALE_BITS)
+#define L_BITS 15
+#define RANS_L (UINT32_C(1) << L_BITS)
+
+#define PRESETS 16
+#define FIELDS 6
+#define WAYS 4
+#define STATES (WAYS * FIELDS)
+
+/*The fields coded as differences, and the top bit of each*/
+#define DELTA_FIELDS (CW_PUT(A, ~0u) | CW_PUT(PB, ~0u) | CW_PUT(PR, ~0u))
+#define DELTA_TOPS (CW_PUT(A, 1u << (CW_A_WIDTH - 1)) | \
+                    CW_PUT(PB, 1u << (CW_PB_WIDTH - 1)) | \
+                    CW_PUT(PR, 1u << (CW_PR_WIDTH - 1)))
+
+/*How a tile's code words are stored*/
+#define MODE_RAW 0
+#define MODE_RANS 1
+#define HEADER_BYTES 4
+
+/*Where each field is, how wide it is, and whether it is coded as the
+difference from its neighbor*/
+static const struct {
+        unsigned lsb;
+        unsigned width;
+        bool delta;
+} fields[FIELDS] = {
+        { CW_A_LSB, CW_A_WIDTH, true },
+        { CW_B_LSB, CW_B_WIDTH, false },
+        { CW_C_LSB, CW_C_WIDTH, false },
+        { CW_D_LSB, CW_D_WIDTH, false },
+        { CW_PB_LSB, CW_PB_WIDTH, true },
+        { CW_PR_LSB, CW_PR_WIDTH, true },
+};
+
+/*How fast each preset's frequencies fall off, from peaked to flat*/
+static const double falloff[PRESETS] = {
+        0.02, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7,
+        0.75, 0.8, 0.85, 0.9, 0.93, 0.96, 0.98, 1.0
+};
+
+/*What encoding a symbol takes, worked out ahead of time so there's no
+division per symbol*/
+struct enc_symbol {
+        uint32_t max;
+        uint32_t rcpFreq;
+        uint32_t bias;
+        uint16_t cmplFreq;
+        uint16_t rcpShift;
+};
+
+/*Tables for 6 and 4 bit fields (index 0 and 1); costs are in 1/256ths of
+a bit. The decoding tables of both go one after the other, so a table is
+found by where it starts. An entry holds the field's value (not zigzagged)
+in its low 6 bits, then where the symbol's slots start (12 bits), then its
+frequency*/
+static struct enc_symbol encTable[2][PRESETS][64];
+static uint32_t costTable[2][PRESETS][64];
+static uint32_t decTable[2 * PRESETS][SCALE];
+static bool ready = false;
+
+/*Where a tile's decoding is up to*/
+struct decoder {
+        uint32_t state[STATES];
+        uint32_t table[STATES];
+        uint32_t shift[STATES];
+        const unsigned char *p;
+        const unsigned char *end;
+        ptrdiff_t ahead;
+
+        /*Where the code words go, before the predictions are added*/
+        unsigned char *packed;
+        size_t next;
+        size_t count;
+};
+
+#ifdef ENTROPY_SIMD
+/*For each 4 lanes that might need refilling, which bytes go where*/
+static unsigned char refillShuffle[16][16];
+static unsigned refillBytes[16];
+
+static void decodeGroups_avx2(struct decoder *dec);
+#endif
+
+static void buildPreset(unsigned kind, unsigned preset, unsigned symbols);
+static inline uint32_t readWord(const unsigned char *bytes);
+static inline void writeWord(unsigned char *bytes, uint32_t word);
+static inline unsigned symbolOf(uint32_t word, uint32_t pred, int f);
+static inline uint32_t predictor(const unsigned char *packed, unsigned row,
+unsigned col, unsigned blocks);
+static inline void encodeSymbol(uint32_t *state, unsigned char **p,
+const struct enc_symbol *sym);
+static inline unsigned decodeSymbol(uint32_t *state, const unsigned char **p,
+const unsigned char *end, const uint32_t *table);
+static void decodeGroup(struct decoder *dec);
+static void addPredictions(unsigned char *packed, unsigned blocks,
+unsigned rows);
+static inline uint32_t addFields(uint32_t x, uint32_t y);
+static inline uint32_t unzigzag(uint32_t z);
+
+/********** Entropy_setup ********
+ *
+ * builds the encoding and decoding tables of every preset
+ *
+ * Parameters:
+ *      none
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - nothing else here is called before it
+ *
+ * Notes:
+ *      - only does anything the first time
+ *
+ ************************/
+void Entropy_setup(void)
+{
+        if (ready) {
+                return;
+        }
+        for (unsigned preset = 0; preset < PRESETS; preset++) {
+                buildPreset(0, preset, 64);
+                buildPreset(1, preset, 16);
+        }
+#ifdef ENTROPY_SIMD
+        for (unsigned need = 0; need < 16; need++) {
+                unsigned taken = 0;
+                for (unsigned lane = 0; lane < 4; lane++) {
+                        unsigned char *to = refillShuffle[need] + lane * 4;
+                        memset(to, 0x80, 4);
+                        if (need & (1u << lane)) {
+                                /*2 big-endian bytes into the low half*/
+                                to[0] = taken + 1;
+                                to[1] = taken;
+                                taken += 2;
+                        }
+                }
+                refillBytes[need] = taken;
+        }
+#endif
+        ready = true;
+}
+
+/********** Entropy_bound ********
+ *
+ * tells how many bytes Entropy_encode can need
+ *
+ * Parameters:
+ *      unsigned count:         how many code words there are
+ *
+ * Return:
+ *      the most bytes Entropy_encode writes for 'count' code words
+ *
+ * Expects:
+ *
+ * Notes:
+ *      - a symbol never takes more than 2 bytes, the code words are
+ *        padded to a whole group, and the states take 4 bytes each
+ *
+ ************************/
+size_t Entropy_bound(unsigned count)
+{
+        size_t padded = ((size_t)count + WAYS - 1) / WAYS * WAYS;
+        return HEADER_BYTES + STATES * 4 + padded * FIELDS * 2;
+}
+
+/********** Entropy_encode ********
+ *
+ * entropy codes the code words of a tile
+ *
+ * Parameters:
+ *      const unsigned char *packed:    the code words, big-endian
+ *      unsigned blocks:                how many code words are in a row
+ *      unsigned rows:                  how many rows there are
+ *      unsigned char *out:             where to put the coded bytes
+ *
+ * Return:
+ *      how many bytes were written to 'out'
+ *
+ * Expects:
+ *      - 'blocks' and 'rows' are not 0
+ *      - 'out' has room for Entropy_bound(blocks * rows) bytes
+ *      - Entropy_setup has been called
+ *
+ * Notes:
+ *      - the first byte says how the rest is stored: code words that
+ *        don't get any smaller (like noise) are just copied
+ *      - rANS is coded backwards, so the symbols are gone through last to
+ *        first and the bytes are written from the end of 'out'
+ *
+ ************************/
+size_t Entropy_encode(const unsigned char *packed, unsigned blocks,
+unsigned rows, unsigned char *out)
+{
+        assert(ready && blocks > 0 && rows > 0);
+        size_t count = (size_t)blocks * rows;
+        size_t bound = Entropy_bound(count);
+
+        /*Pick the cheapest preset for each field*/
+        unsigned counts[FIELDS][64] = { { 0 } };
+        for (unsigned row = 0; row < rows; row++) {
+                for (unsigned col = 0; col < blocks; col++) {
+                        unsigned i = row * blocks + col;
+                        uint32_t word = readWord(packed + i * 4);
+                        uint32_t pred = predictor(packed, row, col, blocks);
+                        for (int f = 0; f < FIELDS; f++) {
+                                counts[f][symbolOf(word, pred, f)]++;
+                        }
+                }
+        }
+        unsigned presets[FIELDS];
+        const struct enc_symbol *tables[FIELDS];
+        for (int f = 0; f < FIELDS; f++) {
+                unsigned kind = fields[f].width == 6 ? 0 : 1;
+                uint64_t best = UINT64_MAX;
+                for (unsigned preset = 0; preset < PRESETS; preset++) {
+                        uint64_t cost = 0;
+                        for (unsigned s = 0; s < 1u << fields[f].width; s++) {
+                                cost += (uint64_t)counts[f][s] *
+                                        costTable[kind][preset][s];
+                        }
+                        if (cost < best) {
+                                best = cost;
+                                presets[f] = preset;
+                        }
+                }
+                tables[f] = encTable[kind][presets[f]];
+        }
+
+        /*State f * WAYS + w codes field f of the w'th code word of each
+        group; the last group is padded out with 0s*/
+        uint32_t state[STATES];
+        for (int k = 0; k < STATES; k++) {
+                state[k] = RANS_L;
+        }
+        unsigned char *end = out + bound;
+        unsigned char *p = end;
+        size_t groups = (count + WAYS - 1) / WAYS;
+        unsigned row = (groups - 1) * WAYS / blocks;
+        unsigned col = (groups - 1) * WAYS % blocks;
+        for (size_t group = groups; group-- > 0;) {
+                unsigned char symbols[STATES] = { 0 };
+                unsigned r = row;
+                unsigned c = col;
+                for (unsigned w = 0; w < WAYS && r < rows; w++) {
+                        size_t i = (size_t)r * blocks + c;
+                        uint32_t word = readWord(packed + i * 4);
+                        uint32_t pred = predictor(packed, r, c, blocks);
+                        for (int f = 0; f < FIELDS; f++) {
+                                symbols[f * WAYS + w] = symbolOf(word, pred,
+                                                                 f);
+                        }
+                        if (++c == blocks) {
+                                c = 0;
+                                r++;
+                        }
+                }
+                for (int k = STATES - 1; k >= 0; k--) {
+                        encodeSymbol(&state[k], &p,
+                                     &tables[k / WAYS][symbols[k]]);
+                }
+
+                /*Back up to the start of the group before*/
+                for (unsigned w = 0; w < WAYS && (row > 0 || col > 0); w++) {
+                        if (col == 0) {
+                                col = blocks;
+                                row--;
+                        }
+                        col--;
+                }
+        }
+        for (int k = STATES - 1; k >= 0; k--) {
+                p -= 4;
+                writeWord(p, state[k]);
+        }
+
+        size_t coded = end - p;
+        if (HEADER_BYTES + coded >= 1 + count * 4) {
+                out[0] = MODE_RAW;
+                memcpy(out + 1, packed, count * 4);
+                return 1 + count * 4;
+        }
+        out[0] = MODE_RANS;
+        out[1] = presets[0] << 4 | presets[1];
+        out[2] = presets[2] << 4 | presets[3];
+        out[3] = presets[4] << 4 | presets[5];
+        memmove(out + HEADER_BYTES, p, coded);
+        return HEADER_BYTES + coded;
+}
+
+/********** Entropy_decode ********
+ *
+ * turns what Entropy_encode wrote back into code words
+ *
+ * Parameters:
+ *      const unsigned char *in:        the coded bytes
+ *      size_t size:                    how many coded bytes there are
+ *      unsigned blocks:                how many code words are in a row
+ *      unsigned rows:                  how many rows there are
+ *      unsigned char *packed:          where to put the code words,
+ *                                      big-endian
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - Entropy_setup has been called
+ *
+ * Notes:
+ *      - safe to call from many threads at once
+ *      - never reads past 'size' bytes, even if they are corrupt
+ *
+ ************************/
+void Entropy_decode(const unsigned char *in, size_t size, unsigned blocks,
+unsigned rows, unsigned char *packed)
+{
+        assert(ready && size >= 1);
+        size_t count = (size_t)blocks * rows;
+        if (in[0] == MODE_RAW) {
+                assert(size == 1 + count * 4);
+                memcpy(packed, in + 1, count * 4);
+                return;
+        }
+        assert(in[0] == MODE_RANS && size >= HEADER_BYTES + STATES * 4);
+
+        struct decoder dec;
+        unsigned char tail[STATES * 4] = { 0 };
+        for (int k = 0; k < STATES; k++) {
+                int f = k / WAYS;
+                unsigned preset = (in[1 + f / 2] >> (f % 2 ? 0 : 4)) & 15;
+                unsigned kind = fields[f].width == 6 ? 0 : 1;
+                dec.state[k] = readWord(in + HEADER_BYTES + k * 4);
+                dec.table[k] = (kind * PRESETS + preset) * SCALE;
+                dec.shift[k] = fields[f].lsb;
+        }
+        dec.p = in + HEADER_BYTES + STATES * 4;
+        dec.end = in + size;
+        dec.ahead = STATES * 2;
+        dec.packed = packed;
+        dec.next = 0;
+        dec.count = count;
+
+#ifdef ENTROPY_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                decodeGroups_avx2(&dec);
+
+                /*The last few bytes are copied where there are zeros after
+                them, so the vector code can read past them. If it stopped
+                with more left than that (a tile longer than its code words
+                need), the loop below finishes it*/
+                if (dec.end - dec.p < STATES * 2) {
+                        memcpy(tail, dec.p, dec.end - dec.p);
+                        dec.end = tail + (dec.end - dec.p);
+                        dec.p = tail;
+                        dec.ahead = 0;
+                        decodeGroups_avx2(&dec);
+                }
+        }
+#endif
+        while (dec.next < count) {
+                decodeGroup(&dec);
+        }
+        addPredictions(packed, blocks, rows);
+}
+
+/********** encodeSymbol ********
+ *
+ * codes a symbol into a rANS state, writing 2 bytes backwards at '*p' to
+ * make room if it has to; like decoding, that is a coin toss, so the
+ * bytes are always written and '*p' only moves if they are kept
+ *
+ ************************/
+static inline void encodeSymbol(uint32_t *state, unsigned char **p,
+const struct enc_symbol *sym)
+{
+        uint32_t x = *state;
+        bool flush = x >= sym->max;
+        unsigned char *to = *p - 2;
+        to[0] = (x >> 8) & 255;
+        to[1] = x & 255;
+        *p = flush ? to : *p;
+        x = flush ? x >> 16 : x;
+        uint32_t q = (uint32_t)(((uint64_t)x * sym->rcpFreq) >> 32) >>
+                     sym->rcpShift;
+        *state = x + sym->bias + q * sym->cmplFreq;
+}
+
+/********** decodeSymbol ********
+ *
+ * takes the next symbol out of a rANS state, reading 2 bytes at '*p' to
+ * refill it; whether it needs them is a coin toss, so that is picked
+ * without a branch. Past 'end' there are only zeros, and '*p' stops there
+ *
+ ************************/
+static inline unsigned decodeSymbol(uint32_t *state, const unsigned char **p,
+const unsigned char *end, const uint32_t *table)
+{
+        uint32_t x = *state;
+        uint32_t slot = x & (SCALE - 1);
+        uint32_t entry = table[slot];
+        x = (entry >> 18) * (x >> SCALE_BITS) + slot - 
+            ((entry >> 6) & (SCALE - 1));
+        ptrdiff_t left = end - *p;
+        uint32_t next = 0;
+        if (left >= 2) {
+                next = (uint32_t)(*p)[0] << 8 | (*p)[1];
+        } else if (left == 1) {
+                next = (uint32_t)(*p)[0] << 8;
+        }
+        bool refill = x < RANS_L;
+        *state = refill ? x << 16 | next : x;
+        *p += refill ? (left < 2 ? left : 2) : 0;
+        return entry & 63;
+}
+
+/********** decodeGroup ********
+ *
+ * decodes the next group of code words one symbol at a time, leaving them
+ * in 'packed' without their predictions
+ *
+ ************************/
+static void decodeGroup(struct decoder *dec)
+{
+        uint32_t words[WAYS] = { 0 };
+        for (int k = 0; k < STATES; k++) {
+                unsigned value = decodeSymbol(&dec->state[k], &dec->p,
+                                              dec->end,
+                                              decTable[0] + dec->table[k]);
+                words[k % WAYS] |= (uint32_t)value << dec->shift[k];
+        }
+
+        /*The padding in the last group is dropped*/
+        size_t ways = dec->count - dec->next < WAYS ? dec->count - dec->next
+                                                    : WAYS;
+        memcpy(dec->packed + dec->next * 4, words, ways * 4);
+        dec->next += ways;
+}
+
+/********** addPredictions ********
+ *
+ * adds back what the delta coded fields of the code words of a tile are
+ * predicted from, and turns the words into big-endian bytes
+ *
+ ************************/
+static void addPredictions(unsigned char *packed, unsigned blocks,
+unsigned rows)
+{
+        uint32_t above = 0;
+        for (unsigned row = 0; row < rows; row++) {
+                unsigned char *at = packed + (size_t)row * blocks * 4;
+                uint32_t pred = above;
+                for (unsigned col = 0; col < blocks; col++) {
+                        uint32_t word;
+                        memcpy(&word, at + col * 4, 4);
+                        word = addFields(pred & DELTA_FIELDS,
+                                         word & DELTA_FIELDS) |
+                               (word & ~DELTA_FIELDS);
+                        writeWord(at + col * 4, word);
+                        if (col == 0) {
+                                above = word;
+                        }
+                        pred = word;
+                }
+        }
+}
+
+/********** addFields ********
+ *
+ * adds the delta coded fields of two code words, each field wrapping
+ * around on its own
+ *
+ ************************/
+static inline uint32_t addFields(uint32_t x, uint32_t y)
+{
+        return ((x & ~DELTA_TOPS) + (y & ~DELTA_TOPS)) ^
+               ((x ^ y) & DELTA_TOPS);
+}
+
+/********** unzigzag ********
+ *
+ * turns 0, 1, 2, 3, 4 ... back into 0, -1, 1, -2, 2 ...
+ *
+ ************************/
+static inline uint32_t unzigzag(uint32_t z)
+{
+        return (z >> 1) ^ -(z & 1);
+}
+
+/********** buildPreset ********
+ *
+ * builds the tables of one preset for fields with 'symbols' values
+ *
+ ************************/
+static void buildPreset(unsigned kind, unsigned preset, unsigned symbols)
+{
+        /*Every symbol gets at least 1, and the rest is shared out*/
+        double weights[64];
+        double total = 0;
+        for (unsigned s = 0; s < symbols; s++) {
+                weights[s] = pow(falloff[preset], s);
+                total += weights[s];
+        }
+        uint32_t freqs[64];
+        uint32_t sum = 0;
+        for (unsigned s = 0; s < symbols; s++) {
+                freqs[s] = 1 + (uint32_t)(weights[s] / total *
+                                          (SCALE - symbols));
+                sum += freqs[s];
+        }
+        freqs[0] += SCALE - sum;
+
+        uint32_t start = 0;
+        for (unsigned s = 0; s < symbols; s++) {
+                uint32_t freq = freqs[s];
+                struct enc_symbol *sym = &encTable[kind][preset][s];
+                sym->max = ((RANS_L >> SCALE_BITS) << 16) * freq;
+                sym->cmplFreq = SCALE - freq;
+                if (freq < 2) {
+                        sym->rcpFreq = ~UINT32_C(0);
+                        sym->rcpShift = 0;
+                        sym->bias = start + SCALE - 1;
+                } else {
+                        uint32_t shift = 0;
+                        while (freq > (UINT32_C(1) << shift)) {
+                                shift++;
+                        }
+                        sym->rcpFreq = (uint32_t)(((UINT64_C(1) <<
+                                        (shift + 31)) + freq - 1) / freq);
+                        sym->rcpShift = shift - 1;
+                        sym->bias = start;
+                }
+                costTable[kind][preset][s] = lround(-log2((double)freq /
+                                                          SCALE) * 256);
+
+                uint32_t value = unzigzag(s) & (symbols - 1);
+                uint32_t *table = decTable[kind * PRESETS + preset];
+                for (uint32_t slot = start; slot < start + freq; slot++) {
+                        table[slot] = value | start << 6 | freq << 18;
+                }
+                start += freq;
+        }
+}
+
+/********** symbolOf ********
+ *
+ * gets the symbol field 'f' of a code word is coded as, given the code
+ * word it is predicted from
+ *
+ ************************/
+static inline unsigned symbolOf(uint32_t word, uint32_t pred, int f)
+{
+        uint32_t mask = (UINT32_C(1) << fields[f].width) - 1;
+        uint32_t value = word >> fields[f].lsb;
+        if (fields[f].delta) {
+                value -= pred >> fields[f].lsb;
+        }
+        value &= mask;
+
+        /*Zigzag: 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...*/
+        uint32_t negative = (value >> (fields[f].width - 1)) & 1;
+        return ((value << 1) ^ -negative) & mask;
+}
+
+/********** predictor ********
+ *
+ * gets the code word the one at 'row', 'col' of a tile is predicted from:
+ * the one to its left, or above for the first in a row, or 0 for the very
+ * first
+ *
+ ************************/
+static inline uint32_t predictor(const unsigned char *packed, unsigned row,
+unsigned col, unsigned blocks)
+{
+        if (col > 0) {
+                return readWord(packed + ((size_t)row * blocks + col - 1) * 4);
+        }
+        if (row > 0) {
+                return readWord(packed + (size_t)(row - 1) * blocks * 4);
+        }
+        return 0;
+}
+
+/********** readWord ********
+ *
+ * reads a big-endian 32-bit word
+ *
+ ************************/
+static inline uint32_t readWord(const unsigned char *bytes)
+{
+        return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+               ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+/********** writeWord ********
+ *
+ * writes a big-endian 32-bit word
+ *
+ ************************/
+static inline void writeWord(unsigned char *bytes, uint32_t word)
+{
+        bytes[0] = word >> 24;
+        bytes[1] = word >> 16;
+        bytes[2] = word >> 8;
+        bytes[3] = word;
+}
+
+#ifdef ENTROPY_SIMD
+/********** decode8 ********
+ *
+ * takes the next symbol out of 8 rANS states, refilling them from '*p',
+ * and puts each field's value where it goes in a code word into '*parts'
+ *
+ ************************/
+__attribute__((target("avx2")))
+static inline __m256i decode8(__m256i x, __m256i table, __m256i shift,
+const unsigned char **p, __m256i *parts)
+{
+        const __m256i slots = _mm256_set1_epi32(SCALE - 1);
+        __m256i slot = _mm256_and_si256(x, slots);
+        __m256i entry = _mm256_i32gather_epi32((const int *)decTable[0],
+                                               _mm256_add_epi32(table, slot),
+                                               4);
+        __m256i freq = _mm256_srli_epi32(entry, 18);
+        __m256i start = _mm256_and_si256(_mm256_srli_epi32(entry, 6), slots);
+        x = _mm256_add_epi32(_mm256_mullo_epi32(freq, _mm256_srli_epi32(x,
+                             SCALE_BITS)), _mm256_sub_epi32(slot, start));
+        *parts = _mm256_sllv_epi32(_mm256_and_si256(entry,
+                                   _mm256_set1_epi32(63)), shift);
+
+        /*States under RANS_L take 2 more bytes each, lane by lane*/
+        __m256i need = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, L_BITS),
+                                          _mm256_setzero_si256());
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(need));
+        const __m128i *low = (const __m128i *)refillShuffle[mask & 15];
+        const __m128i *high = (const __m128i *)refillShuffle[mask >> 4];
+        __m128i lo = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *)*p),
+                                      _mm_loadu_si128(low));
+        *p += refillBytes[mask & 15];
+        __m128i hi = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *)*p),
+                                      _mm_loadu_si128(high));
+        *p += refillBytes[mask >> 4];
+        __m256i words = _mm256_inserti128_si256(_mm256_castsi128_si256(lo),
+                                                hi, 1);
+        return _mm256_blendv_epi8(x, _mm256_or_si256(_mm256_slli_epi32(x, 16),
+                                                     words), need);
+}
+
+/********** decodeGroups_avx2 ********
+ *
+ * decodes whole groups of code words 8 symbols at a time, until they run
+ * out or there are fewer than 'ahead' bytes left; with 'ahead' 0, what is
+ * after 'end' has to be zeros it can read
+ *
+ ************************/
+__attribute__((target("avx2")))
+static void decodeGroups_avx2(struct decoder *dec)
+{
+        const __m256i *state = (const __m256i *)dec->state;
+        const __m256i *table = (const __m256i *)dec->table;
+        const __m256i *shift = (const __m256i *)dec->shift;
+        __m256i x0 = _mm256_loadu_si256(&state[0]);
+        __m256i x1 = _mm256_loadu_si256(&state[1]);
+        __m256i x2 = _mm256_loadu_si256(&state[2]);
+        __m256i table0 = _mm256_loadu_si256(&table[0]);
+        __m256i table1 = _mm256_loadu_si256(&table[1]);
+        __m256i table2 = _mm256_loadu_si256(&table[2]);
+        __m256i shift0 = _mm256_loadu_si256(&shift[0]);
+        __m256i shift1 = _mm256_loadu_si256(&shift[1]);
+        __m256i shift2 = _mm256_loadu_si256(&shift[2]);
+        const unsigned char *p = dec->p;
+
+        /*A group reads at most 2 bytes a state, and stops at 'end' like
+        decodeSymbol. Each vector holds 2 fields of the group's 4 code
+        words, so the words come out of ORing them all and then their
+        halves*/
+        while (dec->count - dec->next >= WAYS && dec->end - p >= dec->ahead) {
+                __m256i parts0, parts1, parts2;
+                x0 = decode8(x0, table0, shift0, &p, &parts0);
+                x1 = decode8(x1, table1, shift1, &p, &parts1);
+                x2 = decode8(x2, table2, shift2, &p, &parts2);
+                __m256i both = _mm256_or_si256(_mm256_or_si256(parts0,
+                                               parts1), parts2);
+                _mm_storeu_si128((__m128i *)(dec->packed + dec->next * 4),
+                                 _mm_or_si128(_mm256_castsi256_si128(both),
+                                 _mm256_extracti128_si256(both, 1)));
+                dec->next += WAYS;
+                p = p > dec->end ? dec->end : p;
+        }
+
+        _mm256_storeu_si256((__m256i *)&dec->state[0], x0);
+        _mm256_storeu_si256((__m256i *)&dec->state[8], x1);
+        _mm256_storeu_si256((__m256i *)&dec->state[16], x2);
+        dec->p = p;
+        /*The rest is SSE code, so leave the AVX state clean*/
+        _mm256_zeroupper();
+}
+#endif
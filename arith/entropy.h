@@ -0,0 +1,28 @@
+/*
+*     entropy.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for entropy coding the code words of a tile, for format 3
+*     images with TILED_ENTROPY set (see tiled.h)
+*/
+
+#ifndef ENTROPY_INCLUDED
+#define ENTROPY_INCLUDED
+
+#include <stddef.h>
+
+/*Builds the coding tables; call it before anything else here, and before
+starting any threads*/
+extern void Entropy_setup(void);
+
+/*Most bytes Entropy_encode can write for 'count' code words*/
+extern size_t Entropy_bound(unsigned count);
+
+/*The code words are big-endian bytes, 'blocks' a row, 'rows' rows*/
+extern size_t Entropy_encode(const unsigned char *packed, unsigned blocks,
+unsigned rows, unsigned char *out);
+extern void Entropy_decode(const unsigned char *in, size_t size,
+unsigned blocks, unsigned rows, unsigned char *packed);
+
+#endif
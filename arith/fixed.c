@@ -0,0 +1,328 @@
+/*
+*     fixed.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for compressing and decompressing with
+*     integers only
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "assert.h"
+#include "arith40.h"
+#include "fixed.h"
+
+/*
+ * The color transforms use the usual coefficients times 2^16, rounded so
+ * each row of them adds up the way the real ones do (Y's to 1, Pb's and
+ * Pr's to 0).
+ */
+#define COEF_BITS 16
+#define COEF_HALF (1 << (COEF_BITS - 1))
+
+/*Sums of four chroma values (so 1.0 is 2^16) are looked up in
+CHROMA_BUCKETS buckets of 2^CHROMA_SHIFT each*/
+#define CHROMA_SHIFT 6
+#define CHROMA_BUCKETS ((2 << (16 - CHROMA_SHIFT)) + 1)
+
+static unsigned char chromaIndex[CHROMA_BUCKETS];
+static int32_t chromaValue[16];
+static int32_t aValue[64];
+static int32_t bcdValue[64];
+
+static int32_t divRound(int32_t n, int32_t d);
+static inline void putPixel(int32_t y, int32_t toR, int32_t toG, int32_t toB,
+unsigned dnm, unsigned char *rgb);
+static inline uint32_t clampOne(int32_t v);
+
+/********** Fixed_setup ********
+ *
+ * builds the lookup tables for chroma and the DCT coefficients
+ *
+ * Parameters:
+ *      none
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - nothing else here is called before it
+ *
+ * Notes:
+ *      - the chroma tables come from Arith40_chroma_of_index, so they match
+ *        the float codec; this is the only floating point here, and it is
+ *        only done once
+ *
+ ************************/
+void Fixed_setup(void)
+{
+        int32_t sums[16];
+        for (int i = 0; i < 16; i++) {
+                double chroma = Arith40_chroma_of_index(i);
+                sums[i] = lround(chroma * (4 << 14));
+                chromaValue[i] = lround(chroma * FIXED_ONE);
+        }
+
+        /*Each bucket gets the index of the chroma nearest its middle*/
+        for (int bucket = 0; bucket < CHROMA_BUCKETS; bucket++) {
+                int32_t middle = (bucket << CHROMA_SHIFT) - (1 << 16) +
+                                 (1 << (CHROMA_SHIFT - 1));
+                int best = 0;
+                for (int i = 1; i < 16; i++) {
+                        if (abs(sums[i] - middle) < abs(sums[best] - middle)) {
+                                best = i;
+                        }
+                }
+                chromaIndex[bucket] = best;
+        }
+
+        /*a is Y scaled to 0..63; b, c and d are in -0.3..0.3 scaled to
+        -31..31, though a code word can hold -32 too*/
+        for (int32_t a = 0; a < 64; a++) {
+                aValue[a] = divRound(a * FIXED_ONE, 63);
+        }
+        for (int32_t q = -32; q <= 31; q++) {
+                bcdValue[q + 32] = divRound(q * 3 * FIXED_ONE, 31 * 10);
+        }
+}
+
+/********** Fixed_rgb_to_cvc ********
+ *
+ * converts a row of RGB pixels to fixed point CVC
+ *
+ * Parameters:
+ *      const uint16_t *red, *green, *blue: the pixels' RGB values
+ *      unsigned count:                     how many pixels to convert
+ *      unsigned dnm:                       denominator of the RGB values
+ *      struct fixed_row *row:              where to put the CVC values
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every array has room for 'count' values
+ *      - 'dnm' is between 1 and 65535, and no value is over it
+ *
+ * Notes:
+ *      - samples are first scaled to 0..FIXED_ONE by multiplying with the
+ *        reciprocal of 'dnm', so there's no division per pixel
+ *
+ ************************/
+void Fixed_rgb_to_cvc(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, unsigned dnm, struct fixed_row *row)
+{
+        assert(dnm > 0);
+        uint64_t recip = ((uint64_t)FIXED_ONE << 24) / dnm;
+        uint64_t half = 1 << 23;
+
+        for (unsigned i = 0; i < count; i++) {
+                int32_t r = (red[i] * recip + half) >> 24;
+                int32_t g = (green[i] * recip + half) >> 24;
+                int32_t b = (blue[i] * recip + half) >> 24;
+
+                row->y[i] = (19595 * r + 38470 * g + 7471 * b + COEF_HALF)
+                            >> COEF_BITS;
+                row->b[i] = (-11059 * r - 21709 * g + 32768 * b + COEF_HALF)
+                            >> COEF_BITS;
+                row->r[i] = (32768 * r - 27439 * g - 5329 * b + COEF_HALF)
+                            >> COEF_BITS;
+        }
+}
+
+/********** Fixed_quantize_row ********
+ *
+ * quantizes a row of 2x2 blocks into the fields of their code words
+ *
+ * Parameters:
+ *      const struct fixed_row *top:    top row of the blocks
+ *      const struct fixed_row *bottom: bottom row of the blocks
+ *      unsigned blocks:                how many blocks there are
+ *      struct cw_row *fields:          where to put the fields
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - the rows hold 2 * 'blocks' pixels, made by Fixed_rgb_to_cvc
+ *
+ * Notes:
+ *      - the same DCT as the float codec: a is the average of the four Y
+ *        values times 63, and b, c and d are averaged differences, clamped
+ *        to -0.3..0.3 and scaled to -31..31 (31 / 0.3 = 310 / 3)
+ *
+ ************************/
+void Fixed_quantize_row(const struct fixed_row *top,
+const struct fixed_row *bottom, unsigned blocks, struct cw_row *fields)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                unsigned col = i * 2;
+                int32_t y1 = top->y[col];
+                int32_t y2 = top->y[col + 1];
+                int32_t y3 = bottom->y[col];
+                int32_t y4 = bottom->y[col + 1];
+
+                /*Sums of four values, so FIXED_ONE * 4 is 1.0*/
+                int32_t a = y4 + y3 + y2 + y1;
+                int32_t bcd[3] = { y4 + y3 - y2 - y1, y4 - y3 + y2 - y1,
+                                   y4 - y3 - y2 + y1 };
+
+                int32_t qa = divRound(a * 63, FIXED_ONE * 4);
+                fields->a[i] = qa < 0 ? 0 : (qa > 63 ? 63 : qa);
+                for (int k = 0; k < 3; k++) {
+                        int32_t q = divRound(bcd[k] * 310, FIXED_ONE * 4 * 3);
+                        bcd[k] = q < -31 ? -31 : (q > 31 ? 31 : q);
+                }
+                fields->b[i] = bcd[0];
+                fields->c[i] = bcd[1];
+                fields->d[i] = bcd[2];
+
+                int32_t pb = top->b[col] + top->b[col + 1] +
+                             bottom->b[col] + bottom->b[col + 1];
+                int32_t pr = top->r[col] + top->r[col + 1] +
+                             bottom->r[col] + bottom->r[col + 1];
+                fields->Pb[i] = chromaIndex[(pb + (1 << 16)) >> CHROMA_SHIFT];
+                fields->Pr[i] = chromaIndex[(pr + (1 << 16)) >> CHROMA_SHIFT];
+        }
+}
+
+/********** Fixed_decode_row ********
+ *
+ * turns a row of code words' fields into the two rows of RGB pixels they
+ * cover
+ *
+ * Parameters:
+ *      const struct cw_row *fields:    the fields of each code word
+ *      unsigned blocks:                how many code words there are
+ *      unsigned dnm:                   denominator to scale RGB values
+ *      unsigned char *top:             where to put the top row's bytes
+ *      unsigned char *bottom:          where to put the bottom row's bytes
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'top' and 'bottom' have room for 6 * 'blocks' bytes
+ *      - 'dnm' is at most 255, so each value fits in a byte
+ *
+ * Notes:
+ *      - the same inverse DCT and color transform as the float codec,
+ *        done a block at a time: the block's chroma is turned into what it
+ *        adds to each of R, G and B once, for all four pixels
+ *      - values are clamped to 0..1 and scaled down, rounding toward zero
+ *        like the float codec does
+ *
+ ************************/
+void Fixed_decode_row(const struct cw_row *fields, unsigned blocks,
+unsigned dnm, unsigned char *top, unsigned char *bottom)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                int32_t a = aValue[fields->a[i]];
+                int32_t b = bcdValue[fields->b[i] + 32];
+                int32_t c = bcdValue[fields->c[i] + 32];
+                int32_t d = bcdValue[fields->d[i] + 32];
+                int32_t pb = chromaValue[fields->Pb[i]];
+                int32_t pr = chromaValue[fields->Pr[i]];
+
+                int32_t toR = (91881 * pr + COEF_HALF) >> COEF_BITS;
+                int32_t toG = -((22553 * pb + 46802 * pr + COEF_HALF) >>
+                                COEF_BITS);
+                int32_t toB = (116130 * pb + COEF_HALF) >> COEF_BITS;
+
+                putPixel(a - b - c + d, toR, toG, toB, dnm, &top[i * 6]);
+                putPixel(a - b + c - d, toR, toG, toB, dnm, &top[i * 6 + 3]);
+                putPixel(a + b - c - d, toR, toG, toB, dnm, &bottom[i * 6]);
+                putPixel(a + b + c + d, toR, toG, toB, dnm,
+                         &bottom[i * 6 + 3]);
+        }
+}
+
+/********** Fixed_preview_row ********
+ *
+ * turns a row of code words' fields into a row of RGB pixels, one for each
+ * code word, for a preview at half the width and height
+ *
+ * Parameters:
+ *      const struct cw_row *fields:    the fields of each code word
+ *      unsigned blocks:                how many code words there are
+ *      unsigned dnm:                   denominator to scale RGB values
+ *      unsigned char *rgb:             where to put the pixels' bytes
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'rgb' has room for 3 * 'blocks' bytes
+ *      - 'dnm' is at most 255, so each value fits in a byte
+ *
+ * Notes:
+ *      - a is the block's average Y, so b, c and d aren't needed
+ *
+ ************************/
+void Fixed_preview_row(const struct cw_row *fields, unsigned blocks,
+unsigned dnm, unsigned char *rgb)
+{
+        for (unsigned i = 0; i < blocks; i++) {
+                int32_t pb = chromaValue[fields->Pb[i]];
+                int32_t pr = chromaValue[fields->Pr[i]];
+
+                int32_t toR = (91881 * pr + COEF_HALF) >> COEF_BITS;
+                int32_t toG = -((22553 * pb + 46802 * pr + COEF_HALF) >>
+                                COEF_BITS);
+                int32_t toB = (116130 * pb + COEF_HALF) >> COEF_BITS;
+                putPixel(aValue[fields->a[i]], toR, toG, toB, dnm, 
+                         &rgb[i * 3]);
+        }
+}
+
+/********** putPixel ********
+ *
+ * writes one pixel's RGB bytes, given its Y and what its chroma adds to
+ * each of R, G and B
+ *
+ ************************/
+static inline void putPixel(int32_t y, int32_t toR, int32_t toG, int32_t toB,
+unsigned dnm, unsigned char *rgb)
+{
+        rgb[0] = (clampOne(y + toR) * dnm) >> FIXED_BITS;
+        rgb[1] = (clampOne(y + toG) * dnm) >> FIXED_BITS;
+        rgb[2] = (clampOne(y + toB) * dnm) >> FIXED_BITS;
+}
+
+/********** clampOne ********
+ *
+ * clamps a fixed point value to 0..FIXED_ONE
+ *
+ ************************/
+static inline uint32_t clampOne(int32_t v)
+{
+        v = v < 0 ? 0 : v;
+        return v > FIXED_ONE ? FIXED_ONE : v;
+}
+
+/********** divRound ********
+ *
+ * divides, rounding to the nearest integer and halves away from zero
+ *
+ * Parameters:
+ *      int32_t n:      the dividend
+ *      int32_t d:      the divisor
+ *
+ * Return:
+ *      n / d, rounded like round() does
+ *
+ * Expects:
+ *      - 'd' is more than 0
+ *
+ * Notes:
+ *
+ ************************/
+static int32_t divRound(int32_t n, int32_t d)
+{
+        if (n < 0) {
+                return -((-n + d / 2) / d);
+        }
+        return (n + d / 2) / d;
+}
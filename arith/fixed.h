@@ -0,0 +1,33 @@
+/*
+*     fixed.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for compressing and decompressing with integers only: color
+*     values are fixed point with 14 fraction bits, so 1.0 is FIXED_ONE
+*/
+
+#ifndef FIXED_INCLUDED
+#define FIXED_INCLUDED
+
+#include <stdint.h>
+#include "all_structs.h"
+
+#define FIXED_BITS 14
+#define FIXED_ONE (1 << FIXED_BITS)
+
+/*Builds the lookup tables; call it before anything else here, and before
+starting any threads*/
+extern void Fixed_setup(void);
+
+extern void Fixed_rgb_to_cvc(const uint16_t *red, const uint16_t *green,
+const uint16_t *blue, unsigned count, unsigned dnm, struct fixed_row *row);
+extern void Fixed_quantize_row(const struct fixed_row *top,
+const struct fixed_row *bottom, unsigned blocks, struct cw_row *fields);
+
+extern void Fixed_decode_row(const struct cw_row *fields, unsigned blocks,
+unsigned dnm, unsigned char *top, unsigned char *bottom);
+extern void Fixed_preview_row(const struct cw_row *fields, unsigned blocks,
+unsigned dnm, unsigned char *rgb);
+
+#endif
@@ -0,0 +1,216 @@
+/*
+*     pool.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for the Pool interface
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "assert.h"
+#include "pool.h"
+
+#define T Pool_T
+
+/*What each started thread needs to find its job*/
+struct worker {
+        T pool;
+        unsigned index;
+        pthread_t id;
+};
+
+struct T {
+        unsigned n;
+        struct worker *workers;
+        pthread_barrier_t start;
+        pthread_barrier_t done;
+
+        /*What the threads run next, set before they pass 'start'*/
+        Pool_workfun *work;
+        char *jobs;
+        size_t size;
+        bool quit;
+};
+
+static void *runWorker(void *cl);
+
+/********** Pool_new ********
+ *
+ * starts a pool of threads
+ *
+ * Parameters:
+ *      unsigned n:     how many threads to run jobs on, counting the
+ *                      calling thread
+ *
+ * Return:
+ *      the new pool
+ *
+ * Expects:
+ *      - 'n' is at least 1
+ *
+ * Notes:
+ *      - n - 1 threads are started; they wait until Pool_run gives them
+ *        something to do
+ *
+ ************************/
+T Pool_new(unsigned n)
+{
+        assert(n > 0);
+        T pool = malloc(sizeof(*pool));
+        struct worker *workers = malloc(n * sizeof(struct worker));
+        if (pool == NULL || workers == NULL) {
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+        pool->n = n;
+        pool->workers = workers;
+        pool->quit = false;
+        if (n == 1) {
+                return pool;
+        }
+
+        pthread_barrier_init(&pool->start, NULL, n);
+        pthread_barrier_init(&pool->done, NULL, n);
+        for (unsigned i = 1; i < n; i++) {
+                workers[i].pool = pool;
+                workers[i].index = i;
+                int failed = pthread_create(&workers[i].id, NULL, runWorker,
+                                            &workers[i]);
+                if (failed) {
+                        fprintf(stderr, "Error starting a thread.\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        return pool;
+}
+
+/********** Pool_free ********
+ *
+ * stops the threads of a pool and frees it
+ *
+ * Parameters:
+ *      Pool_T *pool:   pointer to the pool to free
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'pool' and '*pool' are not NULL
+ *      - no Pool_run is in progress
+ *
+ * Notes:
+ *      - sets '*pool' to NULL
+ *
+ ************************/
+void Pool_free(T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        T p = *pool;
+        if (p->n > 1) {
+                p->quit = true;
+                pthread_barrier_wait(&p->start);
+                for (unsigned i = 1; i < p->n; i++) {
+                        pthread_join(p->workers[i].id, NULL);
+                }
+                pthread_barrier_destroy(&p->start);
+                pthread_barrier_destroy(&p->done);
+        }
+        free(p->workers);
+        free(p);
+        *pool = NULL;
+}
+
+/********** Pool_threads ********
+ *
+ * tells how many threads a pool runs jobs on
+ *
+ * Parameters:
+ *      Pool_T pool:    the pool
+ *
+ * Return:
+ *      the number of threads, counting the calling thread
+ *
+ * Expects:
+ *      - 'pool' is not NULL
+ *
+ * Notes:
+ *
+ ************************/
+unsigned Pool_threads(T pool)
+{
+        assert(pool != NULL);
+        return pool->n;
+}
+
+/********** Pool_run ********
+ *
+ * runs one job on each thread of a pool and waits for all of them
+ *
+ * Parameters:
+ *      Pool_T pool:            the pool
+ *      Pool_workfun work:      function to run on each job
+ *      void *jobs:             array of as many jobs as the pool has threads
+ *      size_t size:            size of each job
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'pool' and 'jobs' are not NULL
+ *
+ * Notes:
+ *      - the calling thread runs jobs[0] itself
+ *      - everything written before Pool_run is seen by the jobs, and
+ *        everything the jobs write is seen after it returns
+ *
+ ************************/
+void Pool_run(T pool, Pool_workfun work, void *jobs, size_t size)
+{
+        assert(pool != NULL && jobs != NULL);
+        if (pool->n == 1) {
+                work(jobs);
+                return;
+        }
+
+        pool->work = work;
+        pool->jobs = jobs;
+        pool->size = size;
+        pthread_barrier_wait(&pool->start);
+        work(jobs);
+        pthread_barrier_wait(&pool->done);
+}
+
+/********** runWorker ********
+ *
+ * runs the jobs Pool_run hands a started thread until the pool is freed
+ *
+ * Parameters:
+ *      void *cl:       the thread's struct worker
+ *
+ * Return:
+ *      NULL
+ *
+ * Expects:
+ *      - 'cl' is not NULL
+ *
+ * Notes:
+ *
+ ************************/
+static void *runWorker(void *cl)
+{
+        struct worker *worker = cl;
+        T pool = worker->pool;
+        while (true) {
+                pthread_barrier_wait(&pool->start);
+                if (pool->quit) {
+                        return NULL;
+                }
+                pool->work(pool->jobs + worker->index * pool->size);
+                pthread_barrier_wait(&pool->done);
+        }
+}
+
+#undef T
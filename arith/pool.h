@@ -0,0 +1,30 @@
+/*
+*     pool.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for a pool of threads that run one job each, over and over
+*/
+
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+
+#include <stddef.h>
+
+#define T Pool_T
+typedef struct T *T;
+
+typedef void Pool_workfun(void *job);
+
+/*A pool of n threads includes the calling thread, so Pool_new(1) never
+starts a thread*/
+extern T Pool_new(unsigned n);
+extern void Pool_free(T *pool);
+extern unsigned Pool_threads(T pool);
+
+/*Runs work on jobs[0 .. n-1], each of size 'size', one per thread, and
+returns once all of them are done*/
+extern void Pool_run(T pool, Pool_workfun work, void *jobs, size_t size);
+
+#undef T
+#endif
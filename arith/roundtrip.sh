@@ -0,0 +1,100 @@
+# /****************************************************************************
+#             roundtrip.sh
+#  *
+#  * Assignment: arith
+#  * Authors: jadkin05, alall01
+#  * Date: 10/22/2024
+#  *
+#  * Summary:
+#  * This shell file checks that every way of compressing an image decodes
+#  * to the same pixels: each test image is compressed to format 2, then to
+#  * format 3 with --tiled, --checksum and --entropy, and every format 3
+#  * image has to decode (with -d, -j, --crop and --preview) to exactly what
+#  * the format 2 image does, even with bytes left over after the last tile.
+#  * Takes the program to test as an optional argument (default ./40image-6,
+#  * which it makes first).
+# ****************************************************************************/
+
+prog=${1:-./40image-6}
+if [ $# -eq 0 ]; then
+    make 40image-6 || exit 1
+fi
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+
+# check name file command...: the output of the command has to match file
+check() {
+    local name=$1 expected=$2
+    shift 2
+    if ! "$@" > "$work/got" 2> /dev/null || ! cmp -s "$work/got" "$expected"
+    then
+        echo "$name: differs from the format 2 decode"
+        failed=1
+    fi
+}
+
+# number: the big-endian number in the bytes on stdin
+number() {
+    od -An -v -tu1 |
+        awk '{ for (i = 1; i <= NF; i++) n = n * 256 + $i } END { print n }'
+}
+
+# bytes n: n as 8 big-endian bytes
+bytes() {
+    local shift
+    for shift in 56 48 40 32 24 16 8 0; do
+        printf "\\$(printf %03o $(( ($1 >> shift) & 255 )))"
+    done
+}
+
+# longTile file extra: the format 3 image in file with 'extra' zero bytes
+# after its last tile, which then ends where the moved index starts (the
+# header is 24 bytes, and the last 8 say where the index is)
+longTile() {
+    local size=$(wc -c < "$1") index=$(tail -c 8 "$1" | number)
+    head -c $((24 + index)) "$1"
+    head -c $2 /dev/zero
+    head -c $((size - 8)) "$1" | tail -c +$((24 + index + 1))
+    bytes $((index + $2))
+}
+
+# an image with odd sizes that don't fill the last row or column of tiles
+$prog -c outputtest.ppm > "$work/cut.cmp"
+$prog -d --crop 171x97+3+1 "$work/cut.cmp" > "$work/odd.ppm"
+
+crop=67x41+33+50
+for image in outputtest.ppm outputtest2.ppm "$work/odd.ppm"; do
+    name=$(basename $image .ppm)
+    echo "Round trip: $name..."
+
+    $prog -c $image > "$work/2.cmp"
+    $prog -d "$work/2.cmp" > "$work/2.ppm"
+    $prog -d --crop $crop "$work/2.cmp" > "$work/2.crop.ppm"
+    $prog -d --preview "$work/2.cmp" > "$work/2.preview.ppm"
+    check "$name -c -j 3" "$work/2.cmp" $prog -c -j 3 $image
+
+    for flags in "--tiled" "--tiled --checksum" "--entropy" \
+                 "--entropy --checksum" "-j 3 --entropy --checksum"; do
+        $prog -c $flags $image > "$work/3.cmp"
+        check "$name $flags -d" "$work/2.ppm" $prog -d "$work/3.cmp"
+        check "$name $flags -d -j 2" "$work/2.ppm" \
+              $prog -d -j 2 "$work/3.cmp"
+        check "$name $flags --crop" "$work/2.crop.ppm" \
+              $prog -d --crop $crop "$work/3.cmp"
+        check "$name $flags --preview" "$work/2.preview.ppm" \
+              $prog -d --preview "$work/3.cmp"
+    done
+
+    # an entropy coded tile with bytes left over after its code words
+    # decodes the same; the leftovers are never read
+    $prog -c --entropy $image > "$work/3.cmp"
+    longTile "$work/3.cmp" 300 > "$work/long.cmp"
+    check "$name --entropy, long last tile" "$work/2.ppm" \
+          $prog -d "$work/long.cmp"
+done
+
+echo "Testing completed."
+exit $failed
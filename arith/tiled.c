@@ -0,0 +1,609 @@
+/*
+*     tiled.c
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Function implementations for format 3 compressed images
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "cwstream.h"
+#include "entropy.h"
+#include "tiled.h"
+
+#if defined(__x86_64__)
+#define TILED_SIMD
+#include <immintrin.h>
+#endif
+
+#define T Tiled_T
+
+struct T {
+        unsigned width;
+        unsigned height;
+        unsigned tileWidth;
+        unsigned tileHeight;
+        bool checksums;
+        bool entropy;
+        unsigned across;
+        unsigned down;
+
+        /*Where each tile starts, and its CRC-32C*/
+        uint64_t *offsets;
+        uint32_t *sums;
+
+        /*Writing: a row of tiles' code words, filled a row at a time, and
+        room to entropy code a tile*/
+        FILE *fp;
+        unsigned char *buffer;
+        unsigned char *tile;
+        unsigned char *coded;
+        unsigned rows;
+        unsigned tileRow;
+        uint64_t written;
+
+        /*Reading: everything after the header*/
+        CWStream_T stream;
+        const unsigned char *data;
+        size_t size;
+};
+
+static uint32_t crcTable[256];
+
+static T newTiles(unsigned width, unsigned height, unsigned tileWidth,
+unsigned tileHeight, unsigned flags);
+static void writeTileRow(T tiles);
+static void writeCodedTile(T tiles, unsigned first, unsigned blocks,
+uint32_t *crc);
+static void crcSetup(void);
+static uint32_t crcUpdate(uint32_t crc, const unsigned char *bytes,
+size_t count);
+#ifdef TILED_SIMD
+static uint32_t crcUpdate_sse42(uint32_t crc, const unsigned char *bytes,
+size_t count);
+#endif
+static void putBytes(FILE *fp, uint64_t value, int count);
+static uint64_t getBytes(const unsigned char *bytes, int count);
+
+/*START OF WRITING FUNCTIONS*/
+
+/********** Tiled_writer ********
+ *
+ * starts writing a format 3 image
+ *
+ * Parameters:
+ *      FILE *fp:               where to write it
+ *      unsigned width:         width of the image, even
+ *      unsigned height:        height of the image, even
+ *      unsigned tileSize:      width and height of a tile, even
+ *      unsigned flags:         TILED_CHECKSUMS and TILED_ENTROPY, or 0
+ *
+ * Return:
+ *      a writer; finish it with Tiled_finish
+ *
+ * Expects:
+ *      - 'fp' is not NULL and 'tileSize' is from 2 to 65534
+ *
+ * Notes:
+ *      - writes the header right away
+ *      - entropy coded tiles are only kept coded if that makes them
+ *        smaller; either way they can be read back the same
+ *
+ ************************/
+T Tiled_writer(FILE *fp, unsigned width, unsigned height,
+unsigned tileSize, unsigned flags)
+{
+        assert(fp != NULL);
+        assert(width % 2 == 0 && height % 2 == 0);
+        assert(tileSize >= 2 && tileSize <= 65534 && tileSize % 2 == 0);
+        assert((flags & ~(TILED_CHECKSUMS | TILED_ENTROPY)) == 0);
+
+        T tiles = newTiles(width, height, tileSize, tileSize, flags);
+        tiles->fp = fp;
+        tiles->buffer = malloc((size_t)width * 2 * (tileSize / 2) + 1);
+        if (tiles->buffer == NULL) {
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+        if (tiles->entropy) {
+                unsigned count = (tileSize / 2) * (tileSize / 2);
+                tiles->tile = malloc((size_t)count * 4);
+                tiles->coded = malloc(Entropy_bound(count));
+                if (tiles->tile == NULL || tiles->coded == NULL) {
+                        fprintf(stderr, "Error allocating memory.\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        fwrite("COMP40\0" "3", 1, 8, fp);
+        putBytes(fp, width, 4);
+        putBytes(fp, height, 4);
+        putBytes(fp, tileSize, 2);
+        putBytes(fp, tileSize, 2);
+        putBytes(fp, flags, 4);
+        return tiles;
+}
+
+/********** Tiled_write_rows ********
+ *
+ * hands over rows of code words, in the order they are in the image
+ *
+ * Parameters:
+ *      Tiled_T tiles:                  the writer
+ *      const unsigned char *packed:    the code words' big-endian bytes,
+ *                                      width / 2 a row
+ *      unsigned rows:                  how many rows of code words
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - 'tiles' was made by Tiled_writer
+ *
+ * Notes:
+ *      - a row of tiles is written out as soon as all its code words are in
+ *
+ ************************/
+void Tiled_write_rows(T tiles, const unsigned char *packed, unsigned rows)
+{
+        assert(tiles != NULL && tiles->fp != NULL);
+        size_t rowBytes = (size_t)tiles->width / 2 * 4;
+        unsigned tileRows = tiles->tileHeight / 2;
+
+        for (unsigned i = 0; i < rows; i++) {
+                memcpy(tiles->buffer + tiles->rows * rowBytes,
+                       packed + i * rowBytes, rowBytes);
+                tiles->rows++;
+                if (tiles->rows == tileRows) {
+                        writeTileRow(tiles);
+                }
+        }
+}
+
+/********** Tiled_finish ********
+ *
+ * writes the last row of tiles, the index and where the index is
+ *
+ * Parameters:
+ *      Tiled_T *tiles:         pointer to the writer
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every row of code words has been handed over
+ *
+ * Notes:
+ *      - frees the writer and sets '*tiles' to NULL
+ *
+ ************************/
+void Tiled_finish(T *tiles)
+{
+        assert(tiles != NULL && *tiles != NULL && (*tiles)->fp != NULL);
+        T t = *tiles;
+        if (t->rows > 0) {
+                writeTileRow(t);
+        }
+        assert(t->tileRow == t->down);
+
+        for (unsigned i = 0; i < t->across * t->down; i++) {
+                putBytes(t->fp, t->offsets[i], 8);
+                if (t->checksums) {
+                        putBytes(t->fp, t->sums[i], 4);
+                }
+        }
+        putBytes(t->fp, t->written, 8);
+
+        free(t->buffer);
+        free(t->tile);
+        free(t->coded);
+        free(t->offsets);
+        free(t->sums);
+        free(t);
+        *tiles = NULL;
+}
+
+/********** writeTileRow ********
+ *
+ * writes the row of tiles in the buffer, a tile at a time, and notes
+ * where each one starts and its CRC-32C
+ *
+ ************************/
+static void writeTileRow(T tiles)
+{
+        size_t rowBytes = (size_t)tiles->width / 2 * 4;
+        unsigned tileBlocks = tiles->tileWidth / 2;
+
+        for (unsigned col = 0; col < tiles->across; col++) {
+                unsigned index = tiles->tileRow * tiles->across + col;
+                unsigned first = col * tileBlocks;
+                unsigned blocks = tiles->width / 2 - first < tileBlocks ?
+                                  tiles->width / 2 - first : tileBlocks;
+                uint32_t crc = 0xffffffff;
+
+                tiles->offsets[index] = tiles->written;
+                if (tiles->entropy) {
+                        writeCodedTile(tiles, first, blocks, &crc);
+                        tiles->sums[index] = ~crc;
+                        continue;
+                }
+                for (unsigned row = 0; row < tiles->rows; row++) {
+                        const unsigned char *bytes = tiles->buffer +
+                                                     row * rowBytes +
+                                                     first * 4;
+                        fwrite(bytes, 4, blocks, tiles->fp);
+                        if (tiles->checksums) {
+                                crc = crcUpdate(crc, bytes, blocks * 4);
+                        }
+                }
+                tiles->sums[index] = ~crc;
+                tiles->written += (uint64_t)tiles->rows * blocks * 4;
+        }
+        tiles->rows = 0;
+        tiles->tileRow++;
+}
+
+/********** writeCodedTile ********
+ *
+ * gathers the code words of a tile from the buffer, entropy codes them
+ * and writes them out, running them through the CRC if there are
+ * checksums
+ *
+ ************************/
+static void writeCodedTile(T tiles, unsigned first, unsigned blocks,
+uint32_t *crc)
+{
+        size_t rowBytes = (size_t)tiles->width / 2 * 4;
+        for (unsigned row = 0; row < tiles->rows; row++) {
+                memcpy(tiles->tile + (size_t)row * blocks * 4,
+                       tiles->buffer + row * rowBytes + first * 4,
+                       blocks * 4);
+        }
+
+        size_t size = Entropy_encode(tiles->tile, blocks, tiles->rows,
+                                     tiles->coded);
+        fwrite(tiles->coded, 1, size, tiles->fp);
+        if (tiles->checksums) {
+                *crc = crcUpdate(*crc, tiles->coded, size);
+        }
+        tiles->written += size;
+}
+
+/*END OF WRITING FUNCTIONS*/
+
+/*START OF READING FUNCTIONS*/
+
+/********** Tiled_reader ********
+ *
+ * reads the header and index of a format 3 image
+ *
+ * Parameters:
+ *      FILE *fp:       the image, just past "COMP40\0" "3"
+ *
+ * Return:
+ *      a reader; free it with Tiled_free
+ *
+ * Expects:
+ *      - 'fp' is not NULL and holds a whole format 3 image
+ *
+ * Notes:
+ *      - the rest of the image is read with a CWStream, so a file is
+ *        mapped into memory and only the tiles that are asked for are
+ *        ever read from disk
+ *
+ ************************/
+T Tiled_reader(FILE *fp)
+{
+        assert(fp != NULL);
+        unsigned char header[16];
+        size_t read = fread(header, 1, sizeof(header), fp);
+        assert(read == sizeof(header));
+
+        unsigned width = getBytes(header, 4);
+        unsigned height = getBytes(header + 4, 4);
+        unsigned tileWidth = getBytes(header + 8, 2);
+        unsigned tileHeight = getBytes(header + 10, 2);
+        uint32_t flags = getBytes(header + 12, 4);
+        assert(width % 2 == 0 && height % 2 == 0);
+        assert(tileWidth > 0 && tileWidth % 2 == 0);
+        assert(tileHeight > 0 && tileHeight % 2 == 0);
+        assert((flags & ~(TILED_CHECKSUMS | TILED_ENTROPY)) == 0);
+
+        T tiles = newTiles(width, height, tileWidth, tileHeight, flags);
+        tiles->stream = CWStream_reader(fp);
+        tiles->data = CWStream_rest(tiles->stream, &tiles->size);
+
+        /*The index is between the tiles and the last 8 bytes*/
+        size_t count = (size_t)tiles->across * tiles->down;
+        size_t entry = tiles->checksums ? 12 : 8;
+        assert(tiles->size >= 8);
+        uint64_t index = getBytes(tiles->data + tiles->size - 8, 8);
+        assert(index <= tiles->size - 8 &&
+               (tiles->size - 8 - index) == count * entry);
+
+        for (size_t i = 0; i < count; i++) {
+                const unsigned char *bytes = tiles->data + index + i * entry;
+                tiles->offsets[i] = getBytes(bytes, 8);
+                tiles->sums[i] = tiles->checksums ? getBytes(bytes + 8, 4)
+                                                  : 0;
+        }
+        tiles->size = index;
+
+        tiles->offsets[count] = index;
+        return tiles;
+}
+
+/********** Tiled_geometry ********
+ *
+ * tells the size of an image and its tiles
+ *
+ * Parameters:
+ *      Tiled_T tiles:                  the reader
+ *      unsigned *width, *height:       where to put the image's size
+ *      unsigned *tileWidth, *tileHeight: where to put a tile's size
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - every pointer is not NULL
+ *
+ * Notes:
+ *
+ ************************/
+void Tiled_geometry(T tiles, unsigned *width, unsigned *height,
+unsigned *tileWidth, unsigned *tileHeight)
+{
+        assert(tiles != NULL);
+        *width = tiles->width;
+        *height = tiles->height;
+        *tileWidth = tiles->tileWidth;
+        *tileHeight = tiles->tileHeight;
+}
+
+/********** Tiled_entropy ********
+ *
+ * tells whether an image's tiles are entropy coded
+ *
+ * Parameters:
+ *      Tiled_T tiles:  the reader
+ *
+ * Return:
+ *      true if TILED_ENTROPY is set, so Tiled_tile needs scratch space
+ *
+ * Expects:
+ *      - 'tiles' is not NULL
+ *
+ * Notes:
+ *
+ ************************/
+bool Tiled_entropy(T tiles)
+{
+        assert(tiles != NULL);
+        return tiles->entropy;
+}
+
+/********** Tiled_tile ********
+ *
+ * finds the code words of a tile
+ *
+ * Parameters:
+ *      Tiled_T tiles:          the reader
+ *      unsigned col, row:      which tile, counting tiles
+ *      unsigned *width:        where to put the tile's width in pixels
+ *      unsigned *height:       where to put the tile's height in pixels
+ *      unsigned char *scratch: where to decode an entropy coded tile; can
+ *                              be NULL if Tiled_entropy is false
+ *
+ * Return:
+ *      the big-endian bytes of the tile's code words, a row at a time
+ *
+ * Expects:
+ *      - the tile is in the image
+ *      - 'scratch' has room for a whole tile's code words
+ *
+ * Notes:
+ *      - safe to call from many threads at once, with their own 'scratch'
+ *      - exits with an error if the tile's CRC-32C doesn't match
+ *      - tiles that aren't entropy coded are handed out where they are,
+ *        without copying
+ *
+ ************************/
+const unsigned char *Tiled_tile(T tiles, unsigned col, unsigned row,
+unsigned *width, unsigned *height, unsigned char *scratch)
+{
+        assert(tiles != NULL && tiles->data != NULL);
+        assert(col < tiles->across && row < tiles->down);
+        unsigned left = col * tiles->tileWidth;
+        unsigned top = row * tiles->tileHeight;
+        *width = tiles->width - left < tiles->tileWidth ? tiles->width - left
+                                                        : tiles->tileWidth;
+        *height = tiles->height - top < tiles->tileHeight ?
+                  tiles->height - top : tiles->tileHeight;
+
+        unsigned index = row * tiles->across + col;
+        uint64_t offset = tiles->offsets[index];
+        size_t bytes = (size_t)(*width / 2) * (*height / 2) * 4;
+        if (tiles->entropy) {
+                uint64_t end = tiles->offsets[index + 1];
+                assert(offset <= end && end <= tiles->size);
+                bytes = end - offset;
+        }
+        assert(offset <= tiles->size && tiles->size - offset >= bytes);
+
+        const unsigned char *tile = tiles->data + offset;
+        if (tiles->checksums &&
+            ~crcUpdate(0xffffffff, tile, bytes) != tiles->sums[index]) {
+                fprintf(stderr, "Tile %u, %u of the image is corrupt.\n",
+                        col, row);
+                exit(EXIT_FAILURE);
+        }
+        if (tiles->entropy) {
+                assert(scratch != NULL);
+                Entropy_decode(tile, bytes, *width / 2, *height / 2,
+                               scratch);
+                return scratch;
+        }
+        return tile;
+}
+
+/********** Tiled_free ********
+ *
+ * frees a reader
+ *
+ * Parameters:
+ *      Tiled_T *tiles:         pointer to the reader
+ *
+ * Return:
+ *      none
+ *
+ * Expects:
+ *      - '*tiles' was made by Tiled_reader
+ *
+ * Notes:
+ *      - doesn't close the file; sets '*tiles' to NULL
+ *
+ ************************/
+void Tiled_free(T *tiles)
+{
+        assert(tiles != NULL && *tiles != NULL && (*tiles)->fp == NULL);
+        CWStream_free(&(*tiles)->stream);
+        free((*tiles)->offsets);
+        free((*tiles)->sums);
+        free(*tiles);
+        *tiles = NULL;
+}
+
+/*END OF READING FUNCTIONS*/
+
+/********** newTiles ********
+ *
+ * allocates a reader or writer and its index, and sets up the CRC and
+ * entropy coding tables while there is only one thread
+ *
+ ************************/
+static T newTiles(unsigned width, unsigned height, unsigned tileWidth,
+unsigned tileHeight, unsigned flags)
+{
+        T tiles = calloc(1, sizeof(*tiles));
+        if (tiles == NULL) {
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+        tiles->width = width;
+        tiles->height = height;
+        tiles->tileWidth = tileWidth;
+        tiles->tileHeight = tileHeight;
+        tiles->checksums = flags & TILED_CHECKSUMS;
+        tiles->entropy = flags & TILED_ENTROPY;
+        tiles->across = (width + tileWidth - 1) / tileWidth;
+        tiles->down = (height + tileHeight - 1) / tileHeight;
+
+        /*Room for one more tile so nothing is ever malloc(0); a reader
+        puts where the last tile ends there*/
+        size_t count = (size_t)tiles->across * tiles->down + 1;
+        tiles->offsets = malloc(count * sizeof(uint64_t));
+        tiles->sums = malloc(count * sizeof(uint32_t));
+        if (tiles->offsets == NULL || tiles->sums == NULL) {
+                fprintf(stderr, "Error allocating memory.\n");
+                exit(EXIT_FAILURE);
+        }
+        crcSetup();
+        if (tiles->entropy) {
+                Entropy_setup();
+        }
+        return tiles;
+}
+
+/********** crcSetup ********
+ *
+ * builds the table for CRC-32C (the Castagnoli CRC, which SSE4.2 computes)
+ *
+ ************************/
+static void crcSetup(void)
+{
+        for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                        c = c & 1 ? 0x82f63b78 ^ (c >> 1) : c >> 1;
+                }
+                crcTable[n] = c;
+        }
+}
+
+/********** crcUpdate ********
+ *
+ * runs bytes through CRC-32C; start with 0xffffffff and flip the bits of
+ * the end result
+ *
+ ************************/
+static uint32_t crcUpdate(uint32_t crc, const unsigned char *bytes,
+size_t count)
+{
+#ifdef TILED_SIMD
+        if (__builtin_cpu_supports("sse4.2")) {
+                return crcUpdate_sse42(crc, bytes, count);
+        }
+#endif
+        for (size_t i = 0; i < count; i++) {
+                crc = crcTable[(crc ^ bytes[i]) & 255] ^ (crc >> 8);
+        }
+        return crc;
+}
+
+#ifdef TILED_SIMD
+/********** crcUpdate_sse42 ********
+ *
+ * crcUpdate 8 bytes at a time with the crc32 instruction
+ *
+ ************************/
+__attribute__((target("sse4.2")))
+static uint32_t crcUpdate_sse42(uint32_t crc, const unsigned char *bytes,
+size_t count)
+{
+        uint64_t c = crc;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+                uint64_t word;
+                memcpy(&word, bytes + i, 8);
+                c = _mm_crc32_u64(c, word);
+        }
+        for (; i < count; i++) {
+                c = _mm_crc32_u8(c, bytes[i]);
+        }
+        return c;
+}
+#endif
+
+/********** putBytes ********
+ *
+ * writes the low 'count' bytes of a value, big-endian
+ *
+ ************************/
+static void putBytes(FILE *fp, uint64_t value, int count)
+{
+        for (int i = count - 1; i >= 0; i--) {
+                putc((value >> (i * 8)) & 255, fp);
+        }
+}
+
+/********** getBytes ********
+ *
+ * reads a 'count' byte big-endian value
+ *
+ ************************/
+static uint64_t getBytes(const unsigned char *bytes, int count)
+{
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++) {
+                value = (value << 8) | bytes[i];
+        }
+        return value;
+}
+
+#undef T
@@ -0,0 +1,54 @@
+/*
+*     tiled.h
+*     jadkin05, alall01, 10/22/2024
+*     arith
+*
+*     Interface for format 3 compressed images, whose code words are split
+*     into tiles that can be found and decompressed on their own.
+*
+*     Everything is big-endian. The header is the 8 bytes "COMP40\0" "3",
+*     then the width and height (4 bytes each), the tile width and height
+*     (2 bytes each, even) and 4 bytes of flags. Then come the tiles, left
+*     to right and top to bottom, each holding its code words a row at a
+*     time; tiles on the right and bottom edges are cut short. After the
+*     tiles is the index: for each tile, where it starts (8 bytes), then its
+*     CRC-32C (4 bytes) if TILED_CHECKSUMS is set. The last 8 bytes say
+*     where the index starts. Places are counted from the first tile.
+*
+*     With TILED_ENTROPY set, each tile is stored as Entropy_encode wrote it
+*     (see entropy.h), and ends where the next one (or the index) starts;
+*     its CRC-32C is of the stored bytes.
+*/
+
+#ifndef TILED_INCLUDED
+#define TILED_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define TILE_SIZE 64
+#define TILED_CHECKSUMS 1
+#define TILED_ENTROPY 2
+
+#define T Tiled_T
+typedef struct T *T;
+
+/*Writes the header; code words are then handed over a row at a time, and
+Tiled_finish writes what is left and the index*/
+extern T Tiled_writer(FILE *fp, unsigned width, unsigned height,
+unsigned tileSize, unsigned flags);
+extern void Tiled_write_rows(T tiles, const unsigned char *packed,
+unsigned rows);
+extern void Tiled_finish(T *tiles);
+
+/*Reads a format 3 image whose first 8 bytes have already been read*/
+extern T Tiled_reader(FILE *fp);
+extern void Tiled_geometry(T tiles, unsigned *width, unsigned *height,
+unsigned *tileWidth, unsigned *tileHeight);
+extern bool Tiled_entropy(T tiles);
+extern const unsigned char *Tiled_tile(T tiles, unsigned col, unsigned row,
+unsigned *width, unsigned *height, unsigned char *scratch);
+extern void Tiled_free(T *tiles);
+
+#undef T
+#endif
@@ -3,8 +3,16 @@
 #include <stdint.h>
 #include "bitpack.h"
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <string.h>
 #include "assert.h"
+#ifdef GUARD_PAGES
+#include <signal.h>
+#include <unistd.h>
+/* onFault can't use snprintf (it isn't async-signal-safe), so it builds
+ * its report with the um's umtext helpers */
+#include "../um/comp/40/grading/um/sgellm01.2/umtext.h"
+#endif
 
 typedef struct Seg {
         uint32_t length;
@@ -36,6 +44,132 @@ uint32_t mask = ((uint32_t)((1 << width) - 1)) << lsb; \
 word = word & ~mask; \
 word = word | (val << lsb);
 
+/* segments (other than 0) with at least this many words get their own
+ * anonymous mapping, so the kernel hands out zeroed pages as they're touched
+ * instead of us zeroing the whole thing when it's mapped */
+#define MMAP_WORDS 65536
+
+#ifdef GUARD_PAGES
+
+/* built with -DGUARD_PAGES, a big segment sits at the end of its mapping,
+ * right up against a PROT_NONE guard big enough for any 32-bit index, so
+ * an access past its end faults instead of landing in some other memory;
+ * the guard is only address space (MAP_NORESERVE), so it costs nothing per
+ * access, but it does limit us to a few thousand big segments at once */
+#define GUARD_BYTES ((size_t)1 << 34)
+
+/* what onFault needs to know about the segments */
+static Seg *guardedSegs = NULL;
+static uint32_t guardedCount = 0;
+
+/* an unmapped segment's words point here instead of at NULL: a PROT_NONE
+ * reservation as big as any 32-bit index reaches, so an access through an
+ * unmapped segment faults inside it, and a fault anywhere else (a wild
+ * pointer near NULL, say) is still a real crash */
+static char *unmappedWords = NULL;
+#define NO_WORDS ((uint32_t *)unmappedWords)
+
+static inline size_t mappedBytes(uint32_t size)
+{
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        return ((size_t)size * sizeof(uint32_t) + page - 1) & ~(page - 1);
+}
+
+static inline uint32_t *newSegWords(uint32_t size)
+{
+        if (size < MMAP_WORDS) {
+                return (uint32_t *)calloc(size, sizeof(uint32_t));
+        }
+        size_t mapped = mappedBytes(size);
+        char *base = mmap(NULL, mapped + GUARD_BYTES, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1, 0);
+        assert(base != MAP_FAILED);
+        int protected = mprotect(base, mapped, PROT_READ | PROT_WRITE);
+        assert(protected == 0);
+        return (uint32_t *)(base + mapped) - size;
+}
+
+static inline void freeSegWords(Seg seg)
+{
+        if (seg.length < MMAP_WORDS) {
+                free(seg.words);
+        } else {
+                size_t mapped = mappedBytes(seg.length);
+                munmap((char *)(seg.words + seg.length) - mapped,
+                       mapped + GUARD_BYTES);
+        }
+}
+
+/* turns a fault in a guard or in the unmapped reservation into a report
+ * and a failed exit; any other fault is a real crash, so it gets the
+ * default action */
+static void onFault(int sig, siginfo_t *info, void *context)
+{
+        (void)context;
+        uintptr_t addr = (uintptr_t)info->si_addr;
+        char line[128];
+        char *p = line;
+        if (addr - (uintptr_t)unmappedWords < GUARD_BYTES) {
+                p = putString(p, "um: access to an unmapped segment (word ");
+                p = putUnsigned(p, (addr - (uintptr_t)unmappedWords) /
+                                   sizeof(uint32_t));
+                p = putString(p, ")\n");
+        }
+        for (uint32_t id = 1; p == line && id < guardedCount; id++) {
+                Seg seg = guardedSegs[id];
+                uintptr_t end = (uintptr_t)(seg.words + seg.length);
+                if (seg.words != NO_WORDS && seg.length >= MMAP_WORDS &&
+                    addr >= end && addr - end < GUARD_BYTES) {
+                        p = putString(p, "um: word ");
+                        p = putUnsigned(p, (addr - (uintptr_t)seg.words) /
+                                           sizeof(uint32_t));
+                        p = putUnsigned(putString(p, " of segment "), id);
+                        p = putString(p, " is out of bounds (it has ");
+                        p = putUnsigned(p, seg.length);
+                        p = putString(p, " words)\n");
+                }
+        }
+        if (p == line) {
+                signal(sig, SIG_DFL);
+                raise(sig);
+                return;
+        }
+        /* stdout is unbuffered in these builds, so there's nothing to
+         * flush (fflush isn't async-signal-safe anyway) */
+        if (write(STDERR_FILENO, line, p - line) < 0) {
+                _exit(EXIT_FAILURE);
+        }
+        _exit(EXIT_FAILURE);
+}
+
+#else
+
+#define NO_WORDS NULL
+
+static inline uint32_t *newSegWords(uint32_t size)
+{
+        if (size < MMAP_WORDS) {
+                return (uint32_t *)calloc(size, sizeof(uint32_t));
+        }
+        void *words = mmap(NULL, (size_t)size * sizeof(uint32_t),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(words != MAP_FAILED);
+        return (uint32_t *)words;
+}
+
+static inline void freeSegWords(Seg seg)
+{
+        if (seg.length < MMAP_WORDS) {
+                free(seg.words);
+        } else {
+                munmap(seg.words, (size_t)seg.length * sizeof(uint32_t));
+        }
+}
+
+#endif
+
 static inline void commandLoop(char *filename)
 {
         FILE *f = fopen(filename, "r");
@@ -48,8 +182,25 @@ static inline void commandLoop(char *filename)
         uint32_t currWord = 0;
         uint32_t unusedSize = 0;
         uint32_t unusedAllocSize = INITSIZE;
+#ifdef GUARD_PAGES
+        unmappedWords = mmap(NULL, GUARD_BYTES, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                             -1, 0);
+        assert(unmappedWords != MAP_FAILED);
+        /* onFault can't flush stdout, so nothing is ever left in it */
+        setvbuf(stdout, NULL, _IONBF, 0);
+        guardedSegs = allSegments;
+        guardedCount = allocSize;
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = onFault;
+        sa.sa_flags = SA_SIGINFO | SA_RESETHAND;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, NULL);
+        sigaction(SIGBUS, &sa, NULL);
+#endif
         for (uint32_t i = 0; i < INITSIZE; i++) {
-                allSegments[i] = (Seg){0, NULL};
+                allSegments[i] = (Seg){0, NO_WORDS};
         }
 
         struct stat sb;
@@ -120,15 +271,16 @@ static inline void commandLoop(char *filename)
 
                                         for (uint32_t i = currSize; i < allocSize; i++) {
                                                 allSegments[i].length = 0;
-                                                allSegments[i].words = NULL;
+                                                allSegments[i].words = NO_WORDS;
                                         } 
+#ifdef GUARD_PAGES
+                                        guardedSegs = allSegments;
+                                        guardedCount = allocSize;
+#endif
                                 }
                                 uint32_t size = registers[c];
                                 Seg newSeg = {size, NULL};
-                                newSeg.words = (uint32_t *)malloc(size * sizeof(uint32_t));
-                                for(uint32_t i = 0; i < size; i++) {
-                                        newSeg.words[i] = 0;
-                                }
+                                newSeg.words = newSegWords(size);
                                 switch(unusedSize) {
                                         case 0:
                                         {
@@ -163,9 +315,9 @@ static inline void commandLoop(char *filename)
                                 }
                                 uint32_t cVal = registers[c];
                                 Seg segToUnmap = allSegments[cVal];
-                                free(segToUnmap.words);
+                                freeSegWords(segToUnmap);
                                 allSegments[cVal].length = 0;
-                                allSegments[cVal].words = NULL;
+                                allSegments[cVal].words = NO_WORDS;
                                 unusedIndexes[unusedSize] = cVal;
                                 unusedSize++;
                                 incrCurrWord(currWord);
@@ -217,9 +369,11 @@ static inline void commandLoop(char *filename)
         }
 
 cleanup:
-        for (uint32_t i = 0; i < allocSize; i++) {
-                if (allSegments[i].words != NULL) {
-                        free(allSegments[i].words);
+        /* segment 0 is always malloc'd, even when it's been replaced */
+        free(allSegments[0].words);
+        for (uint32_t i = 1; i < allocSize; i++) {
+                if (allSegments[i].words != NO_WORDS) {
+                        freeSegWords(allSegments[i]);
                 }
         }
         free(unusedIndexes);
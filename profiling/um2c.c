@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bitpack.h"
+#include <sys/stat.h>
+#include <string.h>
+#include "assert.h"
+
+/*
+ * um2c: compiles a .um image to C that runs without decoding instructions.
+ *
+ *      ./um2c program.um > program.c
+ *      gcc -O2 -I. program.c umrt.c -o program
+ *
+ * Every word of the image is translated as an instruction, and each basic
+ * block starts with a label. A block starts at word 0, after a load
+ * program or halt, and at any word an LV loads the address of (that's how
+ * umasm code builds jump targets and return addresses). A load program
+ * whose target was loaded by an LV earlier in the same block jumps
+ * straight to the label; any other goes through a switch over the block
+ * labels. Anything the translation can't follow (a jump to the middle of
+ * a block, a block whose words were changed by a store into segment 0, a
+ * load program of something other than a copy of the image, a bad
+ * instruction) hands the registers to the interpreter in umrt.c, which
+ * runs the program from there on.
+ *
+ * Programs often keep variables in segment 0 next to their code, so a
+ * store into the image doesn't stop the compiled code by itself; it marks
+ * the block holding the changed word as dirty, and each block checks that
+ * it's clean when it's entered. Only a store into the block that's running
+ * stops it right away.
+ */
+
+typedef enum Um_opcode {
+        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
+        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
+} Um_opcode;
+
+#define opcode(inst) inst >> 28;
+#define a(inst) (inst >> 6) & 0x7
+#define b(inst) (inst >> 3) & 0x7
+#define c(inst) inst & 0x7
+#define a_loadval(inst) (inst >> 25) & 0x7
+#define val(inst) inst << 7 >> 7
+
+#define WORDS_PER_LINE 6
+
+/* what's known about the registers at some point in a block */
+typedef struct Known {
+        int isKnown[8];
+        uint32_t value[8];
+} Known;
+
+static inline uint32_t *readImage(char *filename, uint32_t *length)
+{
+        FILE *f = fopen(filename, "r");
+        struct stat sb;
+        if (f == NULL || stat(filename, &sb) == -1) {
+                fprintf(stderr, "Could not open file.\n");
+                exit(EXIT_FAILURE);
+        }
+        *length = sb.st_size / 4;
+        uint32_t *words = (uint32_t *)malloc((*length + 1) * sizeof(uint32_t));
+        assert(words != NULL);
+        for (uint32_t j = 0; j < *length; j++) {
+                uint32_t word = 0;
+                for (int i = 24; i >= 0; i -= 8) {
+                        word = Bitpack_newu(word, 8, i, getc(f));
+                }
+                words[j] = word;
+        }
+        fclose(f);
+        return words;
+}
+
+/* marks the first word of every basic block */
+static inline char *findLeaders(uint32_t *words, uint32_t length)
+{
+        char *leaders = (char *)calloc(length + 1, 1);
+        assert(leaders != NULL);
+        leaders[0] = 1;
+        for (uint32_t i = 0; i < length; i++) {
+                uint32_t inst = words[i];
+                Um_opcode opcode = opcode(inst);
+                if (opcode == LV && (uint32_t)(val(inst)) < length) {
+                        leaders[val(inst)] = 1;
+                }
+                if ((opcode == LOADP || opcode == HALT || opcode > LV) &&
+                    i + 1 < length) {
+                        leaders[i + 1] = 1;
+                }
+        }
+        return leaders;
+}
+
+static inline void forget(Known *known)
+{
+        memset(known, 0, sizeof(*known));
+}
+
+static inline void learn(Known *known, unsigned r, int isKnown, uint32_t value)
+{
+        known->isKnown[r] = isKnown;
+        known->value[r] = value;
+}
+
+/* writes the C for word i of the image, which is in block number block */
+static inline void emitInstruction(uint32_t inst, uint32_t i, uint32_t block,
+                                   Known *k, char *leaders, uint32_t length)
+{
+        unsigned a = a(inst);
+        unsigned b = b(inst);
+        unsigned c = c(inst);
+        Um_opcode opcode = opcode(inst);
+        int both = k->isKnown[b] && k->isKnown[c];
+
+        switch(opcode) {
+                case CMOV:
+                        if (k->isKnown[c] && k->value[c] == 0) {
+                                break;
+                        }
+                        if (k->isKnown[c]) {
+                                printf("\tr%u = r%u;\n", a, b);
+                                learn(k, a, k->isKnown[b], k->value[b]);
+                        } else {
+                                printf("\tif (r%u != 0) r%u = r%u;\n", c, a, b);
+                                learn(k, a, 0, 0);
+                        }
+                        break;
+                case SLOAD:
+                        printf("\tr%u = Umrt_segs[r%u].words[r%u];\n", a, b, c);
+                        learn(k, a, 0, 0);
+                        break;
+                case SSTORE:
+                        printf("\tUmrt_segs[r%u].words[r%u] = r%u;\n", a, b, c);
+                        if ((!k->isKnown[a] || k->value[a] == 0) &&
+                            (!k->isKnown[b] || k->value[b] < length)) {
+                                printf("\tif (r%u == 0 && r%u < IMAGE_LENGTH &&"
+                                       " storedInImage(r%u, %u)) "
+                                       "FALLBACK(%u);\n", a, b, b, block, i + 1);
+                        }
+                        break;
+                case ADD:
+                        printf("\tr%u = r%u + r%u;\n", a, b, c);
+                        learn(k, a, both, k->value[b] + k->value[c]);
+                        break;
+                case MUL:
+                        printf("\tr%u = r%u * r%u;\n", a, b, c);
+                        learn(k, a, both, k->value[b] * k->value[c]);
+                        break;
+                case DIV:
+                        printf("\tr%u = r%u / r%u;\n", a, b, c);
+                        both = both && k->value[c] != 0;
+                        learn(k, a, both, both ? k->value[b] / k->value[c] : 0);
+                        break;
+                case NAND:
+                        printf("\tr%u = ~(r%u & r%u);\n", a, b, c);
+                        learn(k, a, both, ~(k->value[b] & k->value[c]));
+                        break;
+                case HALT:
+                        printf("\treturn;\n");
+                        break;
+                case ACTIVATE:
+                        printf("\tr%u = Umrt_map(r%u);\n", b, c);
+                        learn(k, b, 0, 0);
+                        break;
+                case INACTIVATE:
+                        printf("\tUmrt_unmap(r%u);\n", c);
+                        break;
+                case OUT:
+                        printf("\tputchar(r%u);\n", c);
+                        break;
+                case IN:
+                        printf("\tr%u = (uint32_t)fgetc(stdin);\n", c);
+                        learn(k, c, 0, 0);
+                        break;
+                case LOADP:
+                {
+                        int labeled = k->isKnown[c] && k->value[c] < length &&
+                                      leaders[k->value[c]];
+                        if (labeled && k->isKnown[b] && k->value[b] == 0) {
+                                printf("\tgoto L%u;\n", k->value[c]);
+                                break;
+                        }
+                        if (labeled) {
+                                printf("\tif (r%u == 0) goto L%u;\n", b,
+                                       k->value[c]);
+                        }
+                        printf("\tif (r%u != 0) {\n"
+                               "\t\tif (!Umrt_loadp(r%u)) FALLBACK(r%u);\n"
+                               "\t\tmemset(dirty, 0, sizeof(dirty));\n"
+                               "\t}\n", b, b, c);
+                        printf("\tpc = r%u;\n\tgoto dispatch;\n", c);
+                        break;
+                }
+                case LV:
+                        printf("\tr%u = %u;\n", (unsigned)(a_loadval(inst)),
+                               (unsigned)(val(inst)));
+                        learn(k, a_loadval(inst), 1, val(inst));
+                        break;
+                default:
+                        printf("\tFALLBACK(%u);\n", i);
+                        break;
+        }
+}
+
+static inline void emitProgram(uint32_t *words, uint32_t length)
+{
+        char *leaders = findLeaders(words, length);
+
+        uint32_t numBlocks = 0;
+        for (uint32_t i = 0; i < length; i++) {
+                numBlocks += leaders[i];
+        }
+
+        printf("/* compiled by um2c; build with umrt.c */\n\n");
+        printf("#include <stdio.h>\n#include <stdlib.h>\n"
+               "#include <stdint.h>\n#include <string.h>\n"
+               "#include \"umrt.h\"\n\n");
+        printf("#define IMAGE_LENGTH %u\n\n", length);
+        printf("static const uint32_t image[%u] = {", length > 0 ? length : 1);
+        for (uint32_t i = 0; i < length; i++) {
+                printf("%s0x%08x,", i % WORDS_PER_LINE == 0 ? "\n\t" : " ",
+                       (unsigned)words[i]);
+        }
+        printf("\n};\n\n");
+
+        /* which block each word of the image is in */
+        printf("static const uint32_t blockOf[%u] = {",
+               length > 0 ? length : 1);
+        for (uint32_t i = 0, block = 0; i < length; i++) {
+                block += leaders[i] && i > 0;
+                printf("%s%u,", i % (2 * WORDS_PER_LINE) == 0 ? "\n\t" : " ",
+                       (unsigned)block);
+        }
+        printf("\n};\n\n");
+        printf("static unsigned char dirty[%u];\n\n",
+               numBlocks > 0 ? numBlocks : 1);
+
+        printf("/* after a store of word word of segment 0, tells whether the "
+               "running\n * block (number block) has to stop */\n"
+               "static inline int storedInImage(uint32_t word, "
+               "uint32_t block)\n{\n"
+               "\tif (Umrt_segs[0].words[word] == image[word]) {\n"
+               "\t\treturn 0;\n\t}\n"
+               "\tdirty[blockOf[word]] = 1;\n"
+               "\treturn blockOf[word] == block;\n}\n\n");
+
+        printf("#define FALLBACK(word) do { \\\n"
+               "\tuint32_t registers[8] = {r0, r1, r2, r3, r4, r5, r6, r7}; "
+               "\\\n\tUmrt_interpret(word, registers); \\\n"
+               "\treturn; \\\n} while (0)\n\n");
+
+        printf("static void run(void)\n{\n");
+        printf("\tuint32_t r0 = 0, r1 = 0, r2 = 0, r3 = 0;\n");
+        printf("\tuint32_t r4 = 0, r5 = 0, r6 = 0, r7 = 0;\n");
+        printf("\tuint32_t pc = 0;\n\n");
+
+        /* going in through the switch means every label gets used */
+        printf("\tgoto dispatch;\n");
+        Known known;
+        uint32_t block = 0;
+        for (uint32_t i = 0; i < length; i++) {
+                if (leaders[i]) {
+                        block += i > 0;
+                        printf("L%u:\n\tif (dirty[%u]) FALLBACK(%u);\n", i,
+                               block, i);
+                        forget(&known);
+                }
+                emitInstruction(words[i], i, block, &known, leaders, length);
+        }
+        printf("\tFALLBACK(%u);\n", length);
+
+        printf("dispatch:\n\tswitch (pc) {\n");
+        for (uint32_t i = 0; i < length; i++) {
+                if (leaders[i]) {
+                        printf("\tcase %u: goto L%u;\n", i, i);
+                }
+        }
+        printf("\tdefault: FALLBACK(pc);\n\t}\n");
+        printf("}\n\n");
+
+        printf("int main(void)\n{\n"
+               "\tUmrt_init(image, IMAGE_LENGTH);\n"
+               "\trun();\n"
+               "\tUmrt_free();\n"
+               "\treturn EXIT_SUCCESS;\n}\n");
+        free(leaders);
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc != 2) {
+                fprintf(stderr, "usage: ./um2c program.um > program.c\n");
+                return EXIT_FAILURE;
+        }
+        uint32_t length;
+        uint32_t *words = readImage(argv[1], &length);
+        emitProgram(words, length);
+        free(words);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bitpack.h"
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <string.h>
+#include "assert.h"
+
+/*
+ * Same UM as um.c, but every segment lives in one big reserved arena and a
+ * segment's ID is the word offset of its data in the arena, so a segmented
+ * load or store is just arena[id + offset]. The two words before the data
+ * hold the segment's size class and length. Segment 0 always sits at the
+ * start of the arena (its length is kept in seg0Length).
+ *
+ * Freed segments go on a LIFO free list for their size class (blocks of
+ * 2^k words), the same way um.c reuses the most recently unmapped index,
+ * and are zeroed as they're freed so they can be handed out again as is.
+ */
+
+typedef enum Um_opcode {
+        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
+        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
+} Um_opcode;
+
+#define opcode(inst) inst >> 28;
+#define a(inst) (inst >> 6) & 0x7
+#define b(inst) (inst >> 3) & 0x7
+#define c(inst) inst & 0x7
+#define a_loadval(inst) (inst >> 25) & 0x7
+#define val(inst) inst << 7 >> 7
+#define incrCurrWord(cWord) cWord++;
+
+#define ARENA_WORDS ((size_t)1 << 32) /* every offset a 32-bit ID can hold */
+#define SEG0_WORDS ((uint32_t)1 << 28) /* room for segment 0 to grow into */
+#define HEADER_WORDS 2
+#define MIN_CLASS 2 /* 4 word blocks, so there's a data word for the link */
+#define NUM_CLASSES 33
+#define MMAP_WORDS 65536
+#define PAGE_WORDS 1024
+
+#define GET_WORD(inst, currWord) uint32_t inst = arena[currWord]
+#define SEG_CLASS(id) arena[(id) - 2]
+#define SEG_LENGTH(id) arena[(id) - 1]
+#define no_argc(argc) (void)argc;
+#define returnVal return EXIT_SUCCESS;
+#define stop break;
+#define newu(word, width, lsb, val)  \
+uint32_t mask = ((uint32_t)((1 << width) - 1)) << lsb; \
+word = word & ~mask; \
+word = word | (val << lsb);
+
+/* smallest k with 2^k >= words, but never less than MIN_CLASS */
+static inline uint32_t sizeClass(uint64_t words)
+{
+        uint32_t k = MIN_CLASS;
+        while (((uint64_t)1 << k) < words) {
+                k++;
+        }
+        return k;
+}
+
+/* zeroes the data of a segment that's being freed; big segments give their
+ * whole pages back to the kernel, which hands them back as zeros */
+static inline void zeroSegment(uint32_t *arena, uint32_t id, uint32_t length)
+{
+        uint32_t *data = arena + id;
+        if (length < MMAP_WORDS) {
+                memset(data, 0, (size_t)length * sizeof(uint32_t));
+                return;
+        }
+        uintptr_t start = (uintptr_t)data;
+        uintptr_t end = (uintptr_t)(data + length);
+        uintptr_t pageBytes = PAGE_WORDS * sizeof(uint32_t);
+        uintptr_t firstPage = (start + pageBytes - 1) & ~(pageBytes - 1);
+        uintptr_t lastPage = end & ~(pageBytes - 1);
+        memset(data, 0, firstPage - start);
+        madvise((void *)firstPage, lastPage - firstPage, MADV_DONTNEED);
+        memset((void *)lastPage, 0, end - lastPage);
+}
+
+static inline void commandLoop(char *filename)
+{
+        FILE *f = fopen(filename, "r");
+        uint32_t *arena = (uint32_t *)mmap(NULL,
+                                           ARENA_WORDS * sizeof(uint32_t),
+                                           PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS |
+                                           MAP_NORESERVE, -1, 0);
+        assert(arena != MAP_FAILED);
+        uint32_t freeLists[NUM_CLASSES] = {0}; /* 0 means empty */
+        uint64_t nextFree = SEG0_WORDS;
+        uint32_t registers[8] = {0};
+        uint32_t currWord = 0;
+
+        struct stat sb;
+        stat(filename, &sb);
+        long long byteSize = (long long)sb.st_size;
+        uint32_t seg0Length = byteSize / 4;
+        assert(seg0Length <= SEG0_WORDS);
+        for (uint32_t j = 0; j < seg0Length; j++) {
+                uint32_t word = 0;
+                for (int i = 24; i >= 0; i -= 8) {
+                        newu(word, 8, i, getc(f));
+                }
+                arena[j] = word;
+        }
+        while (1) {
+                GET_WORD(instruction, currWord);
+                uint8_t a = a(instruction);
+                uint8_t b = b(instruction);
+                uint8_t c = c(instruction);
+                Um_opcode opcode = opcode(instruction);
+                switch(opcode) {
+                        case CMOV:
+                                switch(registers[c]) {
+                                        case 0:
+                                                stop
+                                        default:
+                                                registers[a] = registers[b];
+                                                stop
+                                }
+                                incrCurrWord(currWord);
+                                stop
+                        case SLOAD:
+                                registers[a] = arena[registers[b] + registers[c]];
+                                incrCurrWord(currWord);
+                                stop
+                        case SSTORE:
+                                arena[registers[a] + registers[b]] = registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        case ADD:
+                        {
+                                registers[a] = (registers[b] + registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case MUL:
+                        {
+                                registers[a] = (registers[b] * registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case DIV:
+                        {
+                                registers[a] = registers[b] / registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case NAND:
+                                registers[a] = ~(registers[b] & registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        case ACTIVATE:
+                        {
+                                uint32_t size = registers[c];
+                                uint32_t k = sizeClass((uint64_t)size + HEADER_WORDS);
+                                uint32_t id = freeLists[k];
+                                switch(id) {
+                                        case 0:
+                                        {
+                                                /* fresh arena pages are already 0s */
+                                                assert(nextFree + ((uint64_t)1 << k) <= ARENA_WORDS);
+                                                id = nextFree + HEADER_WORDS;
+                                                nextFree += (uint64_t)1 << k;
+                                                stop
+                                        }
+                                        default:
+                                        {
+                                                /* the link is the only nonzero word */
+                                                freeLists[k] = arena[id];
+                                                arena[id] = 0;
+                                                stop
+                                        }
+                                }
+                                SEG_CLASS(id) = k;
+                                SEG_LENGTH(id) = size;
+                                registers[b] = id;
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case INACTIVATE:
+                        {
+                                uint32_t id = registers[c];
+                                uint32_t k = SEG_CLASS(id);
+                                zeroSegment(arena, id, SEG_LENGTH(id));
+                                SEG_LENGTH(id) = 0;
+                                arena[id] = freeLists[k];
+                                freeLists[k] = id;
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case HALT:
+                                goto cleanup;
+                        case OUT:
+                                putchar(registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        case IN:
+                        {
+                                FILE *f = stdin;
+                                registers[c] = (uint32_t)fgetc(f);
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        case LOADP:
+                        {
+                                uint32_t bVal = registers[b];
+                                switch(registers[b])
+                                {
+                                        default:
+                                        {
+                                                uint32_t length = SEG_LENGTH(bVal);
+                                                assert(length <= SEG0_WORDS);
+                                                memcpy(arena, arena + bVal, length * 4);
+                                                seg0Length = length;
+                                                stop
+                                        }
+                                        case 0:
+                                                stop
+                                }
+                                currWord = registers[c];
+                                stop
+                        }
+                        case LV:
+                        {
+                                uint32_t val = val(instruction);
+                                uint8_t a = a_loadval(instruction);
+                                registers[a] = val;
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        default:
+                                stop
+                }
+        }
+
+cleanup:
+        (void)seg0Length;
+        munmap(arena, ARENA_WORDS * sizeof(uint32_t));
+        fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+        no_argc(argc);
+        commandLoop(argv[1]);
+        returnVal;
+}
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <string.h>
+#include "assert.h"
+#include "umrt.h"
+
+typedef enum Um_opcode {
+        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
+        NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
+} Um_opcode;
+
+#define opcode(inst) inst >> 28;
+#define a(inst) (inst >> 6) & 0x7
+#define b(inst) (inst >> 3) & 0x7
+#define c(inst) inst & 0x7
+#define a_loadval(inst) (inst >> 25) & 0x7
+#define val(inst) inst << 7 >> 7
+#define incrCurrWord(cWord) cWord++;
+
+#define INITSIZE 35000
+#define GET_WORD(inst, currWord) uint32_t inst = segs[0].words[currWord]
+#define stop break;
+
+/* same as um.c: big segments get their own lazily zeroed mapping */
+#define MMAP_WORDS 65536
+
+Seg *Umrt_segs = NULL;
+
+static const uint32_t *image = NULL;
+static uint32_t imageLength = 0;
+static uint32_t allocSize = 0;
+static uint32_t currSize = 0;
+static uint32_t *unusedIndexes = NULL;
+static uint32_t unusedSize = 0;
+static uint32_t unusedAllocSize = 0;
+
+static inline uint32_t *newSegWords(uint32_t size)
+{
+        if (size < MMAP_WORDS) {
+                return (uint32_t *)calloc(size, sizeof(uint32_t));
+        }
+        void *words = mmap(NULL, (size_t)size * sizeof(uint32_t),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(words != MAP_FAILED);
+        return (uint32_t *)words;
+}
+
+static inline void freeSegWords(Seg seg)
+{
+        if (seg.length < MMAP_WORDS) {
+                free(seg.words);
+        } else {
+                munmap(seg.words, (size_t)seg.length * sizeof(uint32_t));
+        }
+}
+
+/* segment 0 starts out as a copy of the image, which has to stay around
+ * so Umrt_loadp can check new programs against it */
+void Umrt_init(const uint32_t *words, uint32_t length)
+{
+        image = words;
+        imageLength = length;
+        allocSize = INITSIZE;
+        Umrt_segs = (Seg *)calloc(allocSize, sizeof(Seg));
+        unusedAllocSize = INITSIZE;
+        unusedIndexes = (uint32_t *)malloc(unusedAllocSize * sizeof(uint32_t));
+        assert(Umrt_segs != NULL && unusedIndexes != NULL);
+
+        Umrt_segs[0].length = length;
+        Umrt_segs[0].words = (uint32_t *)malloc(length * sizeof(uint32_t));
+        assert(Umrt_segs[0].words != NULL);
+        memcpy(Umrt_segs[0].words, words, length * sizeof(uint32_t));
+        currSize = 1;
+}
+
+void Umrt_free(void)
+{
+        /* segment 0 is always malloc'd, even when it's been replaced */
+        free(Umrt_segs[0].words);
+        for (uint32_t i = 1; i < allocSize; i++) {
+                if (Umrt_segs[i].words != NULL) {
+                        freeSegWords(Umrt_segs[i]);
+                }
+        }
+        free(unusedIndexes);
+        free(Umrt_segs);
+}
+
+uint32_t Umrt_map(uint32_t size)
+{
+        if (allocSize == currSize) {
+                allocSize *= 2;
+                Umrt_segs = (Seg *)realloc(Umrt_segs, allocSize * sizeof(Seg));
+                for (uint32_t i = currSize; i < allocSize; i++) {
+                        Umrt_segs[i].length = 0;
+                        Umrt_segs[i].words = NULL;
+                }
+        }
+        Seg newSeg = {size, newSegWords(size)};
+        if (unusedSize == 0) {
+                Umrt_segs[currSize] = newSeg;
+                return currSize++;
+        }
+        uint32_t validIndex = unusedIndexes[--unusedSize];
+        Umrt_segs[validIndex] = newSeg;
+        return validIndex;
+}
+
+void Umrt_unmap(uint32_t id)
+{
+        if (unusedSize == unusedAllocSize) {
+                unusedAllocSize *= 2;
+                unusedIndexes = (uint32_t *)realloc(unusedIndexes,
+                                        unusedAllocSize * sizeof(uint32_t));
+        }
+        freeSegWords(Umrt_segs[id]);
+        Umrt_segs[id].length = 0;
+        Umrt_segs[id].words = NULL;
+        unusedIndexes[unusedSize++] = id;
+}
+
+/* replaces segment 0 with a copy of segment id (which isn't 0) and tells
+ * whether the compiled code still matches it, i.e. whether the new program
+ * is the image plus whatever the loader put after it */
+int Umrt_loadp(uint32_t id)
+{
+        Seg wantedSegment = Umrt_segs[id];
+        Umrt_segs[0].length = wantedSegment.length;
+        Umrt_segs[0].words = (uint32_t *)realloc(Umrt_segs[0].words,
+                                                 wantedSegment.length * 4);
+        memcpy(Umrt_segs[0].words, wantedSegment.words,
+               wantedSegment.length * 4);
+        return wantedSegment.length >= imageLength &&
+               memcmp(Umrt_segs[0].words, image,
+                      imageLength * sizeof(uint32_t)) == 0;
+}
+
+/* runs the machine from currWord until it halts, the same way um.c does;
+ * the registers and segs are kept local (segs is only reloaded when mapping
+ * a segment might have moved it) so stores into segments can't touch them */
+void Umrt_interpret(uint32_t currWord, uint32_t start[8])
+{
+        uint32_t registers[8];
+        memcpy(registers, start, sizeof(registers));
+        Seg *segs = Umrt_segs;
+        while (1) {
+                GET_WORD(instruction, currWord);
+                uint8_t a = a(instruction);
+                uint8_t b = b(instruction);
+                uint8_t c = c(instruction);
+                Um_opcode opcode = opcode(instruction);
+                switch(opcode) {
+                        case CMOV:
+                                if (registers[c] != 0) {
+                                        registers[a] = registers[b];
+                                }
+                                incrCurrWord(currWord);
+                                stop
+                        case SLOAD:
+                                registers[a] = segs[registers[b]].words[registers[c]];
+                                incrCurrWord(currWord);
+                                stop
+                        case SSTORE:
+                                segs[registers[a]].words[registers[b]] = registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        case ADD:
+                                registers[a] = registers[b] + registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        case MUL:
+                                registers[a] = registers[b] * registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        case DIV:
+                                registers[a] = registers[b] / registers[c];
+                                incrCurrWord(currWord);
+                                stop
+                        case NAND:
+                                registers[a] = ~(registers[b] & registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        case ACTIVATE:
+                                registers[b] = Umrt_map(registers[c]);
+                                segs = Umrt_segs;
+                                incrCurrWord(currWord);
+                                stop
+                        case INACTIVATE:
+                                Umrt_unmap(registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        case HALT:
+                                return;
+                        case OUT:
+                                putchar(registers[c]);
+                                incrCurrWord(currWord);
+                                stop
+                        case IN:
+                                registers[c] = (uint32_t)fgetc(stdin);
+                                incrCurrWord(currWord);
+                                stop
+                        case LOADP:
+                                if (registers[b] != 0) {
+                                        Umrt_loadp(registers[b]);
+                                }
+                                currWord = registers[c];
+                                stop
+                        case LV:
+                        {
+                                uint32_t val = val(instruction);
+                                uint8_t a = a_loadval(instruction);
+                                registers[a] = val;
+                                incrCurrWord(currWord);
+                                stop
+                        }
+                        default:
+                                stop
+                }
+        }
+}
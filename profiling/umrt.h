@@ -0,0 +1,31 @@
+#ifndef UMRT_INCLUDED
+#define UMRT_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Runtime for UM programs compiled to C by um2c: the segments, map/unmap,
+ * load program and an interpreter (the same one as um.c) to fall back on
+ * when the compiled code can't keep going.
+ *
+ * The compiled code is only right while segment 0 starts with the image
+ * it was compiled from. The compiled code keeps track of stores into the
+ * image itself; a load program of a segment that doesn't start with the
+ * image hands the machine over to Umrt_interpret for good.
+ */
+
+typedef struct Seg {
+        uint32_t length;
+        uint32_t *words;
+} Seg;
+
+extern Seg *Umrt_segs;
+
+void Umrt_init(const uint32_t *image, uint32_t length);
+void Umrt_free(void);
+uint32_t Umrt_map(uint32_t size);
+void Umrt_unmap(uint32_t id);
+int Umrt_loadp(uint32_t id);
+void Umrt_interpret(uint32_t currWord, uint32_t start[8]);
+
+#endif
@@ -396,7 +396,8 @@ void unmap_seg(Um_register c, SegmentData *sd)
 
 /********** input ********
  *
- * Takes input in from stdin and stores it in register c
+ * Takes input in from stdin (or the machine's input buffer) and stores it
+ * in register c
  *
  * Parameters:
  *      Um_register c:          register c
@@ -412,19 +413,28 @@ void unmap_seg(Um_register c, SegmentData *sd)
  *
  * Notes: 
  *      - Edits the value in register c
+ *      - A machine with an inFd only reads what has already been put in
+ *        its buffer; the command loop makes sure there is a byte (or that
+ *        the input is closed) before running IN
  *      
  ************************/
 void input(Um_register c, SegmentData *sd)
 {
         assert(sd != NULL);
 
-        FILE *f = stdin;
         uint32_t val;
-        /* if stdin is not at the end of the file, get the char */
-        if (feof(f)) {
+        if (sd->inFd != -1) {
+                if (sd->inStart < sd->inEnd) {
+                        val = sd->inBuffer[sd->inStart++];
+                } else {
+                        assert(sd->inClosed);
+                        val = ~(0);
+                }
+        } else if (feof(stdin)) {
+                /* if stdin is not at the end of the file, get the char */
                 val = ~(0);
         } else {
-                val = fgetc(f);
+                val = fgetc(stdin);
         }
 
         uint32_t *cVal = (uint32_t *)UArray_at(sd->registers, c);
@@ -433,7 +443,8 @@ void input(Um_register c, SegmentData *sd)
 
 /********** output ********
  *
- * Sends the value register c in stdout
+ * Sends the value register c to the machine's output (stdout unless
+ * the scheduler gave it a file of its own)
  *
  * Parameters:
  *      Um_register c:          register c
@@ -448,7 +459,7 @@ void input(Um_register c, SegmentData *sd)
  *      - The value to be output is between 0-255
  *
  * Notes: 
- *      - Writes to stdout
+ *      - Writes to sd->out
  *      
  ************************/
 void output(Um_register c, SegmentData *sd)
@@ -461,7 +472,7 @@ void output(Um_register c, SegmentData *sd)
                 RAISE(invalidOutput);
         }
 
-        putchar(*cVal);
+        putc(*cVal, sd->out);
 }
 
 /********** load_program ********
@@ -0,0 +1,384 @@
+/****************************************************************************
+ *             machine.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file implements the machine module. It reads in the instructions
+ * from a .um file, initializes the SegmentData struct that holds all of a
+ * machine's state, reads through each instruction in segment 0 and frees
+ * all used memory. Since all of a machine's state lives in its SegmentData,
+ * the command loop can stop after any instruction and pick up again later.
+ * As it goes, the command loop keeps a trace of the last instructions run.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "seq.h"
+#include "segmentData.h"
+#include <stdint.h>
+#include "memory.h"
+#include "instructions.h"
+#include "machine.h"
+#include "trace.h"
+#include "bitpack.h"
+#include <sys/stat.h>
+#include "assert.h"
+
+Except_T invalidInstruction;
+
+typedef struct instructionParts {
+        Um_register a;
+        Um_register b;
+        Um_register c;
+        Um_opcode op;
+} ips;
+
+static ips deconstructInstruction(uint32_t inst);
+
+/* for each opcode, where the register holding the value it leaves behind
+ * is in the instruction: the register it sets, the word it stores, the
+ * char it outputs, the segment it unmaps or the word it jumps to */
+static const unsigned traceShift[16] = {
+        6, 6, 0, 6, 6, 6, 6, 0, 3, 0, 0, 0, 0, 25, 0, 0
+};
+static Seq_T read_in(FILE *f, struct stat sb);
+static Seq_T initSegments(long long length);
+
+/********** newMachine ********
+ *
+ * Sets up a machine to run the instructions in a file
+ *
+ * Parameters:
+ *      FILE *f:                file pointer (already opened)
+ *      struct stat sb *sd:     stat struct containing the size of the
+ *                              instructions file
+ *
+ * Return:
+ *      SegmentData *sd:        the new machine, with all registers 0 and
+ *                              the program counter at the first word
+ *
+ * Expects:
+ *      - The file is already open
+ *
+ * Notes:
+ *      - Calls read_in to get the instructions
+ *      - The machine reads from stdin and writes to stdout until its
+ *        inFd and out are changed
+ *      - The caller frees the machine with freeData
+ *
+ ************************/
+SegmentData *newMachine(FILE *f, struct stat sb)
+{
+        Seq_T allSegments = read_in(f, sb);
+
+        /* initialize the registers to 0 */
+        UArray_T regs = UArray_new(8, sizeof(uint32_t));
+        for (int i = 0; i < 8; i++) {
+                uint32_t *ptr = (uint32_t *)UArray_at(regs, i);
+                *ptr = 0;
+        }
+
+        /* initialize our SegmentData struct */
+        SegmentData *sd = (SegmentData *)malloc(sizeof(struct SegmentData));
+        assert(sd != NULL);
+        sd->segmentList = allSegments;
+        sd->unusedIndexes = Seq_new(0);
+        sd->currWord = 0;
+        sd->registers = regs;
+        sd->out = stdout;
+        sd->inFd = -1;
+        sd->inClosed = 0;
+        sd->inStart = 0;
+        sd->inEnd = 0;
+        memset(&sd->trace, 0, sizeof(sd->trace));
+        return sd;
+}
+
+/********** freeData ********
+ *
+ * free all used memory
+ *
+ * Parameters:
+ *      SegmentData *sd:        pointer to struct containing all relevant
+ *                              structures, counters, and register values
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - The sequence of segments has been initialized
+ *
+ * Notes:
+ *      - Uses the unusedIndexes to determine what needs to be freed
+ *      - Doesn't close the machine's input or output
+ *
+ ************************/
+void freeData(SegmentData *sd)
+{
+        assert(sd != NULL);
+        Seq_free(&(sd->unusedIndexes));
+        for (int i = 0; i < Seq_length(sd->segmentList); i++) {
+                UArray_T seg = (UArray_T)Seq_get(sd->segmentList, i);
+                if (seg != NULL) {
+                        UArray_free(&seg);
+                }
+        }
+        Seq_free(&(sd->segmentList));
+        UArray_free(&(sd->registers));
+        free(sd);
+}
+
+/********** read_in ********
+ *
+ * Reads in the list of instructions from a file
+ *
+ * Parameters:
+ *      FILE *f:                file pointer (already opened)
+ *      struct stat sb *sd:     stat struct containing the size of the
+ *                              instructions file
+ *
+ * Return:
+ *      Seq_T allSegments:      The sequence containing the segment that has
+ *                              all the read in instructions
+ *
+ * Expects:
+ *      - The file is already open
+ *
+ * Notes:
+ *      - Uses getc and feof to handle the reading
+ *      - Uses bitpack to unpack the instructions
+ *      - Calls the iniitalizeMem function to set up the sequence of segments
+ *
+ ************************/
+static Seq_T read_in(FILE *f, struct stat sb)
+{
+        assert(f != NULL);
+
+        long long byteSize = (long long)sb.st_size;
+
+        Seq_T allSegments = initSegments(byteSize);
+        UArray_T seg0 = (UArray_T)Seq_get(allSegments, 0);
+        int byte;
+
+        /* read in each word by combining 4 bytes */
+        for (int j = 0; j < byteSize / 4; j++) {
+                uint32_t word = 0;
+                for (int i = 24; i >= 0; i -= 8) {
+                        byte = getc(f);
+
+                        if (feof(f)) {
+                                exit(1);
+                        }
+
+                        word = Bitpack_newu(word, 8, i, byte);
+                }
+                uint32_t *ptr = (uint32_t *)UArray_at(seg0, j);
+                *ptr = word;
+        }
+        return allSegments;
+}
+
+/********** inputReady ********
+ *
+ * Tells whether an IN instruction could run right now without waiting
+ *
+ * Parameters:
+ *      SegmentData *sd:        pointer to struct containing all relevant
+ *                              structures, counters, and register values
+ *
+ * Return:
+ *      1 if there is a buffered byte, the input is closed (IN gives all 1s)
+ *      or the machine reads straight from stdin; 0 otherwise
+ *
+ * Expects:
+ *      - sd is not NULL
+ *
+ * Notes:
+ *      - Machines reading from stdin are always ready since IN just
+ *        blocks in fgetc
+ *
+ ************************/
+int inputReady(SegmentData *sd)
+{
+        assert(sd != NULL);
+        return sd->inFd == -1 || sd->inStart < sd->inEnd || sd->inClosed;
+}
+
+/********** commandLoop ********
+ *
+ * Runs the command loop to read through instructions and execute them
+ *
+ * Parameters:
+ *      SegmentData *sd:        pointer to struct containing all relevant
+ *                              structures, counters, and register values
+ *      unsigned quantum:       the most instructions to run before
+ *                              returning, or 0 to run until the machine
+ *                              halts
+ *
+ * Return:
+ *      UM_HALTED if the machine halted, UM_BLOCKED if it stopped at an IN
+ *      instruction with no input ready, UM_RUNNING if it ran quantum
+ *      instructions and can keep going
+ *
+ * Expects:
+ *      - The SegmentData struct along with all of its elements
+ *        have been initialized
+ *
+ * Notes:
+ *      - Calls the instruction functions to execute the instructions
+ *      - Uses the decnstructInstruction function to unpack instructions
+ *      - A blocked machine hasn't run the IN yet; calling commandLoop
+ *        again once inputReady runs it
+ *      - Each instruction goes in the trace before it runs, and is only
+ *        counted (with the value it left) once it's done and the next
+ *        word is in segment 0, so if it fails (or runs or jumps off the
+ *        end of the program) the trace ends with it
+ *
+ ************************/
+Um_status commandLoop(SegmentData *sd, unsigned quantum)
+{
+        assert(sd != NULL);
+
+        /* a UArray's elements are stored one after another, so the
+         * trace can read registers without going through UArray_at */
+        uint32_t *registers = (uint32_t *)UArray_at(sd->registers, 0);
+        for (unsigned n = 0; quantum == 0 || n < quantum; n++) {
+                if (sd->currWord == -1) {
+                        return UM_HALTED;
+                }
+                uint32_t *instruction = (uint32_t *)
+                                        UArray_at(Seq_get(sd->segmentList, 0),
+                                                  sd->currWord);
+                ips parts = deconstructInstruction(*instruction);
+                Um_traceEntry *entry = &sd->trace.entries[sd->trace.count &
+                                                          (TRACE_LENGTH - 1)];
+                entry->word = sd->currWord;
+                entry->instruction = *instruction;
+                Um_register a = parts.a;
+                Um_register b = parts.b;
+                Um_register c = parts.c;
+                switch(parts.op) {
+                        case CMOV:
+                                cmov(a, b, c, sd);
+                                break;
+                        case SLOAD:
+                                sload(a, b, c, sd);
+                                break;
+                        case SSTORE:
+                                sstore(a, b, c, sd);
+                                break;
+                        case ADD:
+                                add(a, b, c, sd);
+                                break;
+                        case MUL:
+                                mult(a, b, c, sd);
+                                break;
+                        case DIV:
+                                divide(a, b, c, sd);
+                                break;
+                        case NAND:
+                                nand(a, b, c, sd);
+                                break;
+                        case HALT:
+                                halt(sd);
+                                break;
+                        case ACTIVATE:
+                                map_seg(b, c, sd);
+                                break;
+                        case INACTIVATE:
+                                unmap_seg(c, sd);
+                                break;
+                        case OUT:
+                                output(c, sd);
+                                break;
+                        case IN:
+                                if (!inputReady(sd)) {
+                                        return UM_BLOCKED;
+                                }
+                                input(c, sd);
+                                break;
+                        case LOADP:
+                                load_program(b, c, sd);
+                                break;
+                        case LV:
+                                load_val(*instruction, sd);
+                                break;
+                        default:
+                                RAISE(invalidInstruction);
+                }
+                if ((parts.op != LOADP) && (parts.op != HALT)) {
+                        sd->currWord++;
+                }
+
+                if (sd->currWord >= UArray_length(Seq_get
+                                                 (sd->segmentList, 0))) {
+                        RAISE(invalidInstruction);
+                }
+
+                entry->value = registers[(*instruction >>
+                                          traceShift[parts.op]) & 0x7];
+                sd->trace.count++;
+        }
+        return sd->currWord == -1 ? UM_HALTED : UM_RUNNING;
+}
+
+/********** deconstructInstruction ********
+ *
+ * Unpacks a uint32_t instruction and returns its various parts
+ *
+ * Parameters:
+ *      uint32_t inst:          the instruction to unpacked
+ *
+ * Return:
+ *      ips parts:              struct containing the parts of the
+ *                              broken down instruction
+ *
+ * Expects:
+ *
+ * Notes:
+ *      - Uses the bitpack interface to unpack the instruction
+ *
+ ************************/
+static ips deconstructInstruction(uint32_t inst)
+{
+        uint64_t opCode = Bitpack_getu(inst, 4, 28);
+        uint64_t a = Bitpack_getu(inst, 3, 6);
+        uint64_t b = Bitpack_getu(inst, 3, 3);
+        uint64_t c = Bitpack_getu(inst, 3, 0);
+
+        ips parts = {a, b, c, opCode};
+        return parts;
+}
+
+/********** initSegments ********
+ *
+ * Initializes the sequence of UArrays that represent the segments
+ * being used throughout the UM
+ *
+ * Parameters:
+ *      long long length:       The total size in bytes of the collection
+ *                              of segment 0 instructions
+ *
+ * Return:
+ *      Seq_T segments:         The sequence to contain all the segments
+ *
+ * Expects:
+ *      -
+ *
+ * Notes:
+ *      - Initializes a new Seq_T and allocates the memory for segment 0
+ *
+ ************************/
+static Seq_T initSegments(long long length)
+{
+        Seq_T segments = Seq_new(0);
+        UArray_T uarray = UArray_new(length / sizeof(uint32_t),
+                                     sizeof(uint32_t));
+        Seq_addlo(segments, uarray);
+
+        return segments;
+}
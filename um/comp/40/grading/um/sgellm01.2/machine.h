@@ -0,0 +1,30 @@
+/****************************************************************************
+ *             machine.h
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file defines the interface for the machine module, which sets up a
+ * universal machine from a .um file and runs its command loop. The command
+ * loop can run a machine to completion or for a fixed number of
+ * instructions at a time, so more than one machine can be run side by side
+ * (see umsched.c).
+****************************************************************************/
+
+#ifndef MACHINE_INCLUDED
+#define MACHINE_INCLUDED
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include "segmentData.h"
+
+typedef enum Um_status { UM_RUNNING = 0, UM_BLOCKED, UM_HALTED } Um_status;
+
+SegmentData *newMachine(FILE *f, struct stat sb);
+Um_status commandLoop(SegmentData *sd, unsigned quantum);
+int inputReady(SegmentData *sd);
+void freeData(SegmentData *sd);
+
+#endif
@@ -35,17 +35,15 @@ Except_T invalidIndex;
  *
  * Notes: 
  *      - Allocates memory for the new segment
+ *      - UArray_new gets its elements from CALLOC, so they're already 0s;
+ *        for big segments that memory comes straight from the kernel and
+ *        is only zeroed a page at a time as it's touched
  *      
  ************************/
 UArray_T getSegment(uint32_t size)
 {
         UArray_T newSeg = UArray_new(size, sizeof(uint32_t));
         assert(newSeg != NULL);
-        /* initialize a uarray with all 0s */
-        for (int i = 0; i < UArray_length(newSeg); i++) {
-                uint32_t *ptr = (uint32_t *)UArray_at(newSeg, i);
-                *ptr = 0;
-        }
 
         return newSeg;
 }
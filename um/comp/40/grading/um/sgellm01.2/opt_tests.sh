@@ -0,0 +1,41 @@
+# /****************************************************************************
+#             opt_tests.sh
+#  *
+#  * Assignment: um
+#  * Authors: Jack Adkins, Seth Gellman
+#  * Date: 11/17/24
+#  *
+#  * Summary:
+#  * This shell file checks umopt against every test: each .um file is run
+#  * as it is and after going through umopt, and the two outputs have to
+#  * match. Any extra arguments (like "workloads") are passed to unit_test,
+#  * so the workloads can be checked too.
+# ****************************************************************************/
+
+make um umopt unit_test
+./unit_test "$@"
+
+failed=0
+inputFiles=($(find . -type f -name "*.um" -printf "%f\n"))
+for testFile in ${inputFiles[@]}; do
+    testName=$(echo $testFile | sed -E 's/(.*).um/\1/')
+    optFile=$testName".opt"
+    expectedInput=$testName".0"
+    if [ ! -f $expectedInput ]; then
+        expectedInput=/dev/null
+    fi
+
+    echo "Optimizing test: $testName..."
+    ./umopt -v $testFile > $optFile
+    ./um $testFile < $expectedInput > $testName".out"
+    ./um $optFile < $expectedInput > $testName".optout"
+
+    if ! cmp -s $testName".out" $testName".optout"; then
+        echo "$testName: optimized output differs"
+        failed=1
+    fi
+    rm -f $optFile $testName".optout"
+done
+
+echo "Testing completed."
+exit $failed
@@ -20,12 +20,26 @@
 #include "table.h"
 #include "uarray.h"
 #include "list.h"
+#include <stdio.h>
+#include "trace.h"
+
+#define INPUT_BUFFER_SIZE 4096
 
 typedef struct SegmentData {
         Seq_T segmentList;
         Seq_T unusedIndexes;
         int currWord;
         UArray_T registers;
+        FILE *out;
+
+        /* inFd is -1 when IN reads straight from stdin */
+        int inFd;
+        int inClosed;
+        int inStart;
+        int inEnd;
+        unsigned char inBuffer[INPUT_BUFFER_SIZE];
+
+        Um_trace trace;
 } SegmentData;
 
 #endif
\ No newline at end of file
@@ -20,42 +20,67 @@
 
 #include "assert.h"
 #include "fmt.h"
-#include "seq.h"
-
-extern void Um_write_sequence(FILE *output, Seq_T instructions);
-
-extern void build_halt_test(Seq_T instructions);
-extern void build_verbose_halt_test(Seq_T instructions);
-extern void build_output_test(Seq_T stream);
-extern void build_add_test(Seq_T stream);
-extern void build_mult_test(Seq_T stream);
-extern void build_div_test(Seq_T stream);
-extern void build_multdiv_test(Seq_T stream);
-extern void build_allmath_test(Seq_T stream);
-extern void build_bnand_test(Seq_T stream);
-extern void build_double_bnand_test(Seq_T stream);
-extern void build_map_test(Seq_T stream);
-extern void build_unmap_test(Seq_T stream);
-extern void build_unmap_many_test(Seq_T stream);
-extern void build_io_test(Seq_T stream);
-extern void build_io_eof_test(Seq_T stream);
-extern void build_cmov_execute_test(Seq_T stream);
-extern void build_cmov_no_execute_test(Seq_T stream);
-extern void build_lp_not0_test(Seq_T stream);
-extern void build_lp_0_test(Seq_T stream);
-extern void build_segload_test(Seq_T stream);
-extern void build_mil50_test(Seq_T stream);
-extern void build_sstore_test(Seq_T stream);
-extern void build_sstore_0_test(Seq_T stream);
-extern void build_long_test(Seq_T stream);
+#include "umstream.h"
+
+extern void build_halt_test(Um_stream instructions);
+extern void build_verbose_halt_test(Um_stream instructions);
+extern void build_output_test(Um_stream stream);
+extern void build_add_test(Um_stream stream);
+extern void build_mult_test(Um_stream stream);
+extern void build_div_test(Um_stream stream);
+extern void build_multdiv_test(Um_stream stream);
+extern void build_allmath_test(Um_stream stream);
+extern void build_bnand_test(Um_stream stream);
+extern void build_double_bnand_test(Um_stream stream);
+extern void build_map_test(Um_stream stream);
+extern void build_unmap_test(Um_stream stream);
+extern void build_unmap_many_test(Um_stream stream);
+extern void build_io_test(Um_stream stream);
+extern void build_io_eof_test(Um_stream stream);
+extern void build_cmov_execute_test(Um_stream stream);
+extern void build_cmov_no_execute_test(Um_stream stream);
+extern void build_lp_not0_test(Um_stream stream);
+extern void build_lp_0_test(Um_stream stream);
+extern void build_segload_test(Um_stream stream);
+extern void build_mil50_test(Um_stream stream);
+extern void build_jump_chain_test(Um_stream stream);
+extern void build_nand_simplify_test(Um_stream stream);
+extern void build_sstore_test(Um_stream stream);
+extern void build_sstore_0_test(Um_stream stream);
+extern void build_long_test(Um_stream stream);
+
+extern void build_map_churn_fixed(Um_stream stream, unsigned size,
+                                  unsigned iterations, char **test_input,
+                                  char **expected_output);
+extern void build_map_churn_uniform(Um_stream stream, unsigned size,
+                                    unsigned iterations, char **test_input,
+                                    char **expected_output);
+extern void build_map_churn_skewed(Um_stream stream, unsigned size,
+                                   unsigned iterations, char **test_input,
+                                   char **expected_output);
+extern void build_loadp_dispatch(Um_stream stream, unsigned size,
+                                 unsigned iterations, char **test_input,
+                                 char **expected_output);
+extern void build_segment_strided(Um_stream stream, unsigned size,
+                                  unsigned iterations, char **test_input,
+                                  char **expected_output);
+extern void build_segment_random(Um_stream stream, unsigned size,
+                                 unsigned iterations, char **test_input,
+                                 char **expected_output);
+extern void build_arith_loop(Um_stream stream, unsigned size,
+                             unsigned iterations, char **test_input,
+                             char **expected_output);
+extern void build_io_echo(Um_stream stream, unsigned size,
+                          unsigned iterations, char **test_input,
+                          char **expected_output);
 /* The array `tests` contains all unit tests for the lab. */
 
 static struct test_info {
         const char *name;
         const char *test_input;          /* NULL means no input needed */
         const char *expected_output;
-        /* writes instructions into sequence */
-        void (*build_test)(Seq_T stream);
+        /* writes instructions into stream */
+        void (*build_test)(Um_stream stream);
 } tests[] = {
         { "halt",         NULL, "", build_halt_test },
         { "halt-verbose", NULL, "", build_verbose_halt_test },
@@ -79,12 +104,42 @@ static struct test_info {
         {"segload", NULL, "3", build_segload_test },
         {"sstore", NULL, "", build_sstore_test},
         {"sstore-0", NULL, "", build_sstore_0_test },
-        {"long-test", "?", "f3f?", build_long_test}
+        {"long-test", "?", "f3f?", build_long_test},
+        {"mil50", NULL, "", build_mil50_test},
+        {"jump-chain", NULL, "job", build_jump_chain_test},
+        {"nand-simplify", "ab", "aaab", build_nand_simplify_test}
 };
 
   
 #define NTESTS (sizeof(tests)/sizeof(tests[0]))
 
+/*
+ * The array `workloads` contains the performance workloads. They are only
+ * written when asked for by name, as name[:size[:iterations]], or all at
+ * once (with their default sizes) with the name "workloads".
+ */
+
+static struct workload_info {
+        const char *name;
+        unsigned size;                   /* default size */
+        unsigned iterations;             /* default iterations */
+        /* writes instructions into stream, makes the input and output */
+        void (*build_workload)(Um_stream stream, unsigned size,
+                               unsigned iterations, char **test_input,
+                               char **expected_output);
+} workloads[] = {
+        { "map-churn-fixed",   1000,     2000000,  build_map_churn_fixed },
+        { "map-churn-uniform", 100000,   2000,     build_map_churn_uniform },
+        { "map-churn-skewed",  1000000,  10000,    build_map_churn_skewed },
+        { "loadp-dispatch",    256,      30000000, build_loadp_dispatch },
+        { "segment-strided",   8000000,  100,      build_segment_strided },
+        { "segment-random",    4194304,  3,        build_segment_random },
+        { "arith-loop",        64,       2000000,  build_arith_loop },
+        { "io-echo",           20000000, 1,        build_io_echo }
+};
+
+#define NWORKLOADS (sizeof(workloads)/sizeof(workloads[0]))
+
 /*
  * open file 'path' for writing, then free the pathname;
  * if anything fails, checked runtime error
@@ -99,6 +154,19 @@ static void write_or_remove_file(char *path, const char *contents);
 
 static void write_test_files(struct test_info *test);
 
+/*
+ * writes the workload with the given size and iterations; a size or
+ * iterations of 0 means use the workload's default
+ */
+static void write_workload_files(struct workload_info *workload,
+                                 unsigned size, unsigned iterations);
+
+/*
+ * if 'arg' names a workload as name[:size[:iterations]], write it and
+ * return true, otherwise return false
+ */
+static bool write_named_workload(const char *arg);
+
 
 int main (int argc, char *argv[])
 {
@@ -116,6 +184,14 @@ int main (int argc, char *argv[])
                                         tested = true;
                                         write_test_files(&tests[i]);
                                 }
+                        if (!strcmp(argv[j], "workloads")) {
+                                tested = true;
+                                for (unsigned i = 0; i < NWORKLOADS; i++)
+                                        write_workload_files(&workloads[i],
+                                                             0, 0);
+                        }
+                        if (!tested)
+                                tested = write_named_workload(argv[j]);
                         if (!tested) {
                                 failed = true;
                                 fprintf(stderr,
@@ -130,10 +206,10 @@ int main (int argc, char *argv[])
 static void write_test_files(struct test_info *test)
 {
         FILE *binary = open_and_free_pathname(Fmt_string("%s.um", test->name));
-        Seq_T instructions = Seq_new(0);
+        Um_stream instructions = Um_stream_new(0);
         test->build_test(instructions);
-        Um_write_sequence(binary, instructions);
-        Seq_free(&instructions);
+        Um_stream_write(binary, instructions);
+        Um_stream_free(&instructions);
         fclose(binary);
 
         write_or_remove_file(Fmt_string("%s.0", test->name),
@@ -143,6 +219,53 @@ static void write_test_files(struct test_info *test)
 }
 
 
+static void write_workload_files(struct workload_info *workload,
+                                 unsigned size, unsigned iterations)
+{
+        if (size == 0)
+                size = workload->size;
+        if (iterations == 0)
+                iterations = workload->iterations;
+        printf("***** Writing workload '%s' (size %u, %u iterations).\n",
+               workload->name, size, iterations);
+
+        char *test_input, *expected_output;
+        FILE *binary = open_and_free_pathname(Fmt_string("%s.um",
+                                                         workload->name));
+        Um_stream instructions = Um_stream_new(0);
+        workload->build_workload(instructions, size, iterations,
+                                 &test_input, &expected_output);
+        Um_stream_write(binary, instructions);
+        Um_stream_free(&instructions);
+        fclose(binary);
+
+        write_or_remove_file(Fmt_string("%s.0", workload->name), test_input);
+        write_or_remove_file(Fmt_string("%s.1", workload->name),
+                             expected_output);
+        free(test_input);
+        free(expected_output);
+}
+
+
+static bool write_named_workload(const char *arg)
+{
+        size_t name_length = strcspn(arg, ":");
+        for (unsigned i = 0; i < NWORKLOADS; i++) {
+                if (strlen(workloads[i].name) != name_length ||
+                    strncmp(workloads[i].name, arg, name_length) != 0)
+                        continue;
+
+                unsigned size = 0, iterations = 0;
+                if (arg[name_length] == ':')
+                        sscanf(arg + name_length + 1, "%u:%u", &size,
+                               &iterations);
+                write_workload_files(&workloads[i], size, iterations);
+                return true;
+        }
+        return false;
+}
+
+
 static void write_or_remove_file(char *path, const char *contents)
 {
         if (contents == NULL || *contents == '\0') {
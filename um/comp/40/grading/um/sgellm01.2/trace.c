@@ -0,0 +1,120 @@
+/****************************************************************************
+ *             trace.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file implements the trace module. The command loop fills in the
+ * entries itself (it's just a few stores per instruction); this file turns
+ * them back into text. Dumping writes the text with the umtext helpers
+ * and only calls write, which is async-signal-safe (snprintf isn't), so it
+ * can be done from a SIGSEGV handler, and the ring is only ever written by
+ * the machine that owns it, so nothing needs a lock.
+****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+#include "umtext.h"
+
+#define LINE_SIZE 128
+#define TEXT_WIDTH 36           /* the text is padded to this, like "%-36s" */
+
+static void writeEntry(int fd, Um_traceEntry *entry, int finished);
+
+/* n right-justified in at least 6 columns, like "%6u" */
+static inline char *putWord(char *p, uint32_t n)
+{
+        char digits[10];
+        char *end = putUnsigned(digits, n);
+        for (int pad = 6 - (end - digits); pad > 0; pad--) {
+                *p++ = ' ';
+        }
+        memcpy(p, digits, end - digits);
+        return p + (end - digits);
+}
+
+/********** traceDump ********
+ *
+ * Writes out the instructions in a trace, oldest first
+ *
+ * Parameters:
+ *      Um_trace *trace:        the trace to write out
+ *      int fd:                 file descriptor to write to
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - trace is not NULL
+ *
+ * Notes:
+ *      - Each finished instruction is followed by "-> " and the value it
+ *        left (the register it set, the word it stored, the char it
+ *        output or the word it jumped to)
+ *      - The last line is the instruction that was running when the
+ *        machine failed, marked "<- failed"
+ *
+ ************************/
+void traceDump(Um_trace *trace, int fd)
+{
+        uint32_t count = trace->count;
+        uint32_t first = count > TRACE_LENGTH - 1 ? count - (TRACE_LENGTH - 1)
+                                                  : 0;
+        char line[LINE_SIZE];
+        char *p = putUnsigned(putString(line, "last "), count - first);
+        p = putString(p, " instructions run:\n");
+        if (write(fd, line, p - line) < 0) {
+                return;
+        }
+
+        for (uint32_t i = first; i < count; i++) {
+                writeEntry(fd, &trace->entries[i & (TRACE_LENGTH - 1)], 1);
+        }
+        writeEntry(fd, &trace->entries[count & (TRACE_LENGTH - 1)], 0);
+}
+
+/********** writeEntry ********
+ *
+ * Writes out one entry of a trace as a line of a .dump listing
+ *
+ * Parameters:
+ *      int fd:                 file descriptor to write to
+ *      Um_traceEntry *entry:   the entry to write
+ *      int finished:           0 if this is the instruction that failed
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - entry is not NULL
+ *
+ * Notes:
+ *      - The longest line is well under LINE_SIZE, so nothing is cut off
+ *
+ ************************/
+static void writeEntry(int fd, Um_traceEntry *entry, int finished)
+{
+        char line[LINE_SIZE];
+        char *p = putString(putWord(line, entry->word), ": [0x");
+        p = putString(putHex(p, entry->instruction), "] ");
+
+        char *text = p;
+        p = putInstruction(p, entry->instruction);
+        while (p - text < TEXT_WIDTH) {
+                *p++ = ' ';
+        }
+
+        if (finished) {
+                p = putString(putHex(putString(p, "-> 0x"), entry->value),
+                              "\n");
+        } else {
+                p = putString(p, "<- failed\n");
+        }
+        if (write(fd, line, p - line) < 0) {
+                return;
+        }
+}
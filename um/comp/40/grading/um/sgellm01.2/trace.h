@@ -0,0 +1,41 @@
+/****************************************************************************
+ *             trace.h
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file defines the trace module, which keeps the last TRACE_LENGTH
+ * instructions a machine ran (where each one was, the instruction word and
+ * the value it left behind) in a ring buffer, so that when a program fails
+ * we can see how it got there. The trace is printed in the same format as
+ * the .dump listings.
+****************************************************************************/
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+#include <stdint.h>
+
+/* must be a power of 2; build with -DTRACE_LENGTH=n to change it */
+#ifndef TRACE_LENGTH
+#define TRACE_LENGTH 256
+#endif
+
+typedef struct Um_traceEntry {
+        uint32_t word;
+        uint32_t instruction;
+        uint32_t value;
+} Um_traceEntry;
+
+/* count is how many instructions have finished; the entry at count (mod
+ * TRACE_LENGTH) is the one running now */
+typedef struct Um_trace {
+        Um_traceEntry entries[TRACE_LENGTH];
+        volatile uint32_t count;
+} Um_trace;
+
+void traceDump(Um_trace *trace, int fd);
+
+#endif
@@ -0,0 +1,747 @@
+/****************************************************************************
+ *             umdis.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file is umdis, which disassembles a .um program into a listing in
+ * the same format as the .dump files:
+ *
+ *      ./umdis [-p] [-j threads] program.um > program.dump
+ *
+ * With -p the listing is just the words, exactly like sandmark.dump and
+ * midmark.dump. Otherwise umdis also works out where the code is and
+ * adds lines starting with ';' (grep -v '^ *;' to get the plain listing):
+ *      - a "; block" line where each basic block starts, with the load
+ *        programs seen jumping there
+ *      - "; -> n" after a load program whose target was set by a load
+ *        value earlier in the same straight run of code ("; -> n or m"
+ *        when a CMOV picks between two)
+ *      - a "; data" or "; unreached" line in front of words nothing is
+ *        seen jumping to
+ * Code is what runs straight through from word 0 or a known target. A
+ * known target is the word a load program's register was set to by a
+ * load value, or the word right after a load program when another
+ * register holds its address (the usual way to call a function). Words
+ * that aren't code are data if they have a bad instruction in them or are
+ * the same word over and over (padding); otherwise they're just unreached, which
+ * usually means code only reached through a computed jump.
+ *
+ * The program is mapped, not read, and split into one piece per thread,
+ * both to find the jumps and to write the text. Text is written with the
+ * umtext helpers instead of printf, which is most of the time it takes.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "instructions.h"
+#include "umtext.h"
+#include "assert.h"
+
+#define MAX_THREADS 64
+#define WARMUP 1024             /* words looked back over for constants */
+#define ROUND_WORDS (1u << 18)  /* words each thread writes per round */
+#define LINE_ROOM 512           /* enough for any one line */
+#define MAX_FROM 8              /* jump sources listed per block */
+#define MAX_VALUES 2            /* numbers kept track of per register */
+#define TEXT_WIDTH 36
+
+/* flags for each word */
+#define ENTRY 1                 /* something is seen jumping here */
+#define CODE 2                  /* runs straight through from an entry */
+
+typedef enum Jump_kind { GOTO, RETURNED } Jump_kind;
+
+/* the numbers a register might hold (after a CMOV it can be one of two);
+ * open means it might hold something else too */
+typedef struct Known {
+        uint32_t value[MAX_VALUES];
+        unsigned count;
+        int open;
+} Known;
+
+/* a load program at word from that goes (or returns) to word to */
+typedef struct Jump {
+        uint32_t from;
+        uint32_t to;
+        Jump_kind kind;
+} Jump;
+
+/* a stretch of words that aren't code */
+typedef struct Region {
+        uint32_t start;
+        uint32_t length;
+        int data;               /* all the same word */
+        int bad;                /* has a bad instruction in it */
+} Region;
+
+typedef struct Listing {
+        const unsigned char *image;     /* the program, big-endian */
+        uint32_t length;
+        unsigned char *flags;
+        Jump *byFrom;                   /* every jump, by source */
+        Jump *byTo;                     /* the same jumps, by target */
+        uint32_t jumpCount;
+        Region *regions;
+        uint32_t regionCount, regionAlloc;
+        int plain;
+} Listing;
+
+/* one thread's share of finding jumps or of writing a round */
+typedef struct Chunk {
+        const Listing *l;
+        uint32_t start, end;
+        Jump *jumps;
+        uint32_t jumpCount, jumpAlloc;
+        char *text;
+        size_t size, alloc;
+} Chunk;
+
+static void *findJumps(void *arg);
+static void markCode(Listing *l);
+static void *writeChunk(void *arg);
+static int compareTargets(const void *x, const void *y);
+static void runThreads(Chunk *chunks, unsigned threads,
+                       void *(*work)(void *));
+
+static inline uint32_t wordAt(const Listing *l, uint32_t i)
+{
+        const unsigned char *p = l->image + (size_t)i * 4;
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline unsigned opOf(uint32_t w) { return w >> 28; }
+
+static inline int isTerminator(uint32_t w)
+{
+        return opOf(w) == LOADP || opOf(w) == HALT || opOf(w) > LV;
+}
+
+/* the register an instruction sets (maybe, for CMOV), or -1 */
+static inline int writes(uint32_t w)
+{
+        switch (opOf(w)) {
+                case CMOV: case SLOAD: case ADD: case MUL: case DIV:
+                case NAND:
+                        return (w >> 6) & 0x7;
+                case ACTIVATE:
+                        return (w >> 3) & 0x7;
+                case IN:
+                        return w & 0x7;
+                case LV:
+                        return (w >> 25) & 0x7;
+                default:
+                        return -1;
+        }
+}
+
+/********** main ********
+ *
+ * Maps in a .um program and writes its listing to stdout
+ *
+ * Parameters:
+ *      int argc:               the number of arguments provided
+ *      char *argv[]:           array of the arguments provided
+ *
+ * Return:
+ *      - EXIT_SUCCESS if the listing was written out
+ *
+ * Expects:
+ *      - A .um file is provided, optionally after -p and -j threads
+ *
+ * Notes:
+ *      - Uses as many threads as there are processors unless -j says
+ *        otherwise
+ *      - A partial word at the end of the file is left out
+ *      - The listing is written a round at a time, so only the text for
+ *        threads * ROUND_WORDS words is ever held at once
+ *
+ ************************/
+int main(int argc, char *argv[])
+{
+        Listing l;
+        memset(&l, 0, sizeof(l));
+        long threads = sysconf(_SC_NPROCESSORS_ONLN);
+        int i = 1;
+        for (; i < argc - 1; i++) {
+                if (strcmp(argv[i], "-p") == 0) {
+                        l.plain = 1;
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc - 1) {
+                        threads = atol(argv[++i]);
+                } else {
+                        break;
+                }
+        }
+        if (i != argc - 1) {
+                fprintf(stderr, "usage: ./umdis [-p] [-j threads] "
+                                "program.um > program.dump\n");
+                return EXIT_FAILURE;
+        }
+        if (threads < 1) {
+                threads = 1;
+        } else if (threads > MAX_THREADS) {
+                threads = MAX_THREADS;
+        }
+
+        int fd = open(argv[i], O_RDONLY);
+        struct stat sb;
+        if (fd == -1 || fstat(fd, &sb) == -1) {
+                fprintf(stderr, "Could not open file.\n");
+                return EXIT_FAILURE;
+        }
+        l.length = sb.st_size / 4;
+        if (l.length == 0) {
+                close(fd);
+                return EXIT_SUCCESS;
+        }
+        void *image = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        assert(image != MAP_FAILED);
+        close(fd);
+        madvise(image, sb.st_size, MADV_SEQUENTIAL);
+        l.image = image;
+
+        Chunk chunks[MAX_THREADS];
+        memset(chunks, 0, sizeof(chunks));
+        unsigned n = (unsigned)threads;
+        for (unsigned t = 0; t < n; t++) {
+                chunks[t].l = &l;
+        }
+
+        if (!l.plain) {
+                l.flags = (unsigned char *)calloc(l.length, 1);
+                assert(l.flags != NULL);
+                uint32_t share = l.length / n + 1;
+                for (unsigned t = 0; t < n; t++) {
+                        uint64_t start = (uint64_t)share * t;
+                        uint64_t end = start + share;
+                        chunks[t].start = start < l.length ? start : l.length;
+                        chunks[t].end = end < l.length ? end : l.length;
+                }
+                runThreads(chunks, n, findJumps);
+
+                /* each piece found its jumps in order, so putting the
+                 * pieces together gives them in order of source */
+                for (unsigned t = 0; t < n; t++) {
+                        l.jumpCount += chunks[t].jumpCount;
+                }
+                l.byFrom = (Jump *)malloc((l.jumpCount + 1) * sizeof(Jump));
+                l.byTo = (Jump *)malloc((l.jumpCount + 1) * sizeof(Jump));
+                assert(l.byFrom != NULL && l.byTo != NULL);
+                uint32_t at = 0;
+                for (unsigned t = 0; t < n; t++) {
+                        memcpy(l.byFrom + at, chunks[t].jumps,
+                               chunks[t].jumpCount * sizeof(Jump));
+                        at += chunks[t].jumpCount;
+                        free(chunks[t].jumps);
+                }
+                memcpy(l.byTo, l.byFrom, l.jumpCount * sizeof(Jump));
+                qsort(l.byTo, l.jumpCount, sizeof(Jump), compareTargets);
+                markCode(&l);
+        }
+
+        for (uint64_t start = 0; start < l.length;
+             start += (uint64_t)ROUND_WORDS * n) {
+                for (unsigned t = 0; t < n; t++) {
+                        uint64_t s = start + (uint64_t)ROUND_WORDS * t;
+                        uint64_t e = s + ROUND_WORDS;
+                        chunks[t].start = s < l.length ? s : l.length;
+                        chunks[t].end = e < l.length ? e : l.length;
+                }
+                runThreads(chunks, n, writeChunk);
+                for (unsigned t = 0; t < n; t++) {
+                        size_t written = fwrite(chunks[t].text, 1,
+                                                chunks[t].size, stdout);
+                        if (written != chunks[t].size) {
+                                fprintf(stderr, "umdis: write failed\n");
+                                return EXIT_FAILURE;
+                        }
+                }
+        }
+
+        for (unsigned t = 0; t < n; t++) {
+                free(chunks[t].text);
+        }
+        free(l.flags);
+        free(l.byFrom);
+        free(l.byTo);
+        free(l.regions);
+        munmap(image, sb.st_size);
+        return EXIT_SUCCESS;
+}
+
+/********** runThreads ********
+ *
+ * Runs a function on each chunk, each in its own thread, and waits for
+ * all of them
+ *
+ * Parameters:
+ *      Chunk *chunks:          the chunks to work on
+ *      unsigned threads:       how many chunks there are
+ *      void *(*work)(void *):  what to do with each chunk
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - threads is at least 1
+ *
+ * Notes:
+ *      - The last chunk is done by the calling thread
+ *
+ ************************/
+static void runThreads(Chunk *chunks, unsigned threads,
+                       void *(*work)(void *))
+{
+        pthread_t ids[MAX_THREADS];
+        for (unsigned t = 0; t + 1 < threads; t++) {
+                int failed = pthread_create(&ids[t], NULL, work, &chunks[t]);
+                assert(!failed);
+        }
+        work(&chunks[threads - 1]);
+        for (unsigned t = 0; t + 1 < threads; t++) {
+                pthread_join(ids[t], NULL);
+        }
+}
+
+/********** addJump ********
+ *
+ * Adds a jump to the ones a chunk has found
+ *
+ * Parameters:
+ *      Chunk *ch:              the chunk
+ *      uint32_t from:          the load program
+ *      uint32_t to:            where it goes
+ *      Jump_kind kind:         GOTO or RETURNED
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - ch is not NULL
+ *
+ * Notes:
+ *
+ ************************/
+static void addJump(Chunk *ch, uint32_t from, uint32_t to, Jump_kind kind)
+{
+        if (ch->jumpCount == ch->jumpAlloc) {
+                ch->jumpAlloc = ch->jumpAlloc * 2 + 64;
+                ch->jumps = (Jump *)realloc(ch->jumps,
+                                            ch->jumpAlloc * sizeof(Jump));
+                assert(ch->jumps != NULL);
+        }
+        ch->jumps[ch->jumpCount++] = (Jump){from, to, kind};
+}
+
+static inline int mightBe(const Known *k, uint32_t n)
+{
+        for (unsigned j = 0; j < k->count; j++) {
+                if (k->value[j] == n) {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+/* after a CMOV that might not happen, a register holds what it did or
+ * what the other one does */
+static inline void merge(Known *into, const Known *from)
+{
+        into->open |= from->open;
+        for (unsigned j = 0; j < from->count; j++) {
+                if (mightBe(into, from->value[j])) {
+                        continue;
+                }
+                if (into->count == MAX_VALUES) {
+                        into->open = 1;
+                } else {
+                        into->value[into->count++] = from->value[j];
+                }
+        }
+}
+
+/********** findJumps ********
+ *
+ * Finds where the load programs in a chunk go, from the load values and
+ * CMOVs in front of them
+ *
+ * Parameters:
+ *      void *arg:              the Chunk to look through
+ *
+ * Return:
+ *      NULL
+ *
+ * Expects:
+ *      - The chunk's start and end are set
+ *
+ * Notes:
+ *      - Starts up to WARMUP words before the chunk, at the start of the
+ *        straight run it's in, so that a load value just before the chunk
+ *        is still seen
+ *      - A jump with a known, nonzero segment isn't into this program,
+ *        so it's left out
+ *      - A load program can have a jump to each number its register
+ *        might hold, even if it might hold something else
+ *
+ ************************/
+static void *findJumps(void *arg)
+{
+        Chunk *ch = (Chunk *)arg;
+        const Listing *l = ch->l;
+        uint32_t i = ch->start;
+        while (i > 0 && ch->start - i < WARMUP &&
+               !isTerminator(wordAt(l, i - 1))) {
+                i--;
+        }
+
+        Known regs[8];
+        memset(regs, 0, sizeof(regs));
+        for (unsigned r = 0; r < 8; r++) {
+                regs[r].open = 1;
+        }
+        int clean = 1;
+        for (; i < ch->end; i++) {
+                uint32_t w = wordAt(l, i);
+                unsigned a = (w >> 6) & 0x7;
+                unsigned b = (w >> 3) & 0x7;
+                unsigned c = w & 0x7;
+                if (opOf(w) == LOADP && i >= ch->start &&
+                    (regs[b].open || mightBe(&regs[b], 0))) {
+                        for (unsigned k = 0; k < regs[c].count; k++) {
+                                if (regs[c].value[k] < l->length) {
+                                        addJump(ch, i, regs[c].value[k],
+                                                GOTO);
+                                }
+                        }
+                        for (unsigned r = 0; r < 8 && i + 1 < l->length;
+                             r++) {
+                                if (r != c && mightBe(&regs[r], i + 1)) {
+                                        addJump(ch, i, i + 1, RETURNED);
+                                        break;
+                                }
+                        }
+                }
+                if (isTerminator(w)) {
+                        /* data is mostly terminators, so this is skipped
+                         * when there's nothing to forget */
+                        for (unsigned r = 0; r < 8 && !clean; r++) {
+                                regs[r] = (Known){{0, 0}, 0, 1};
+                        }
+                        clean = 1;
+                } else if (opOf(w) == LV) {
+                        clean = 0;
+                        regs[(w >> 25) & 0x7] = (Known){{w & 0x1ffffff, 0},
+                                                        1, 0};
+                } else if (opOf(w) == CMOV) {
+                        clean = 0;
+                        if (regs[c].open || mightBe(&regs[c], 0)) {
+                                merge(&regs[a], &regs[b]);
+                        } else {
+                                regs[a] = regs[b];
+                        }
+                } else if (writes(w) >= 0) {
+                        regs[writes(w)] = (Known){{0, 0}, 0, 1};
+                }
+        }
+        return NULL;
+}
+
+/* a new region starting at word i, which stays put until the next one */
+static Region *addRegion(Listing *l, uint32_t i)
+{
+        if (l->regionCount == l->regionAlloc) {
+                l->regionAlloc = l->regionAlloc * 2 + 64;
+                l->regions = (Region *)realloc(l->regions, l->regionAlloc *
+                                               sizeof(Region));
+                assert(l->regions != NULL);
+        }
+        l->regions[l->regionCount] = (Region){i, 0, 1, 0};
+        return &l->regions[l->regionCount++];
+}
+
+/********** markCode ********
+ *
+ * Marks the jump targets and the words that run straight through from
+ * them, and makes a list of the regions in between
+ *
+ * Parameters:
+ *      Listing *l:             the listing, with its jumps found
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - l->flags is all 0
+ *
+ * Notes:
+ *      - Word 0 is always an entry
+ *
+ ************************/
+static void markCode(Listing *l)
+{
+        l->flags[0] = ENTRY;
+        for (uint32_t j = 0; j < l->jumpCount; j++) {
+                l->flags[l->byTo[j].to] |= ENTRY;
+        }
+        int reached = 0;
+        Region *region = NULL;
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < l->length; i++) {
+                uint32_t w = wordAt(l, i);
+                reached |= l->flags[i] & ENTRY;
+                if (reached) {
+                        l->flags[i] |= CODE;
+                        region = NULL;
+                } else if (region == NULL) {
+                        region = addRegion(l, i);
+                        first = w;
+                } else {
+                        region->data &= w == first;
+                }
+                if (!reached && opOf(w) > LV) {
+                        region->bad = 1;
+                }
+                if (region != NULL) {
+                        region->length++;
+                }
+                if (isTerminator(w)) {
+                        reached = 0;
+                }
+        }
+}
+
+/********** compareTargets ********
+ *
+ * qsort comparison for jumps, by target and then by source
+ *
+ * Parameters:
+ *      const void *x, *y:      the Jumps to compare
+ *
+ * Return:
+ *      negative, 0 or positive, like strcmp
+ *
+ * Expects:
+ *
+ * Notes:
+ *
+ ************************/
+static int compareTargets(const void *x, const void *y)
+{
+        const Jump *p = (const Jump *)x;
+        const Jump *q = (const Jump *)y;
+        if (p->to != q->to) {
+                return p->to < q->to ? -1 : 1;
+        }
+        return p->from < q->from ? -1 : p->from > q->from;
+}
+
+/* the first jump in jumps (sorted on key) whose key isn't below n */
+static uint32_t firstAt(const Jump *jumps, uint32_t count, uint32_t n,
+                        int byTarget)
+{
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                uint32_t key = byTarget ? jumps[mid].to : jumps[mid].from;
+                if (key < n) {
+                        lo = mid + 1;
+                } else {
+                        hi = mid;
+                }
+        }
+        return lo;
+}
+
+/* the word numbers are counted up in decimal as the lines are written,
+ * rather than divided out for every line; the text is right-justified in
+ * at least 6 columns, like "%6u" */
+typedef struct Counter {
+        char text[16];
+        unsigned width;
+} Counter;
+
+static inline void setCounter(Counter *k, uint32_t n)
+{
+        char *end = putUnsigned(k->text, n);
+        unsigned count = end - k->text;
+        k->width = count > 6 ? count : 6;
+        memmove(k->text + k->width - count, k->text, count);
+        memset(k->text, ' ', k->width - count);
+}
+
+static inline void countUp(Counter *k)
+{
+        int j = k->width - 1;
+        while (j >= 0 && k->text[j] == '9') {
+                k->text[j--] = '0';
+        }
+        if (j >= 0 && k->text[j] != ' ') {
+                k->text[j]++;
+        } else if (j >= 0) {
+                k->text[j] = '1';
+        } else {
+                memmove(k->text + 1, k->text, k->width++);
+                k->text[0] = '1';
+        }
+}
+
+/********** putBlock ********
+ *
+ * Writes the "; block" line for a block of code, with the jumps seen
+ * going there
+ *
+ * Parameters:
+ *      char *p:                where to write the line
+ *      const Listing *l:       the listing
+ *      uint32_t i:             the word the block starts at
+ *
+ * Return:
+ *      the end of the line written
+ *
+ * Expects:
+ *      - There's room for LINE_ROOM chars at p
+ *
+ * Notes:
+ *      - Lists at most MAX_FROM jumps, then "..."
+ *
+ ************************/
+static char *putBlock(char *p, const Listing *l, uint32_t i)
+{
+        p = putUnsigned(putString(p, "      ; block "), i);
+        uint32_t j = firstAt(l->byTo, l->jumpCount, i, 1);
+        const char *sep[] = {", jumped to from ", ", returned to from "};
+        Jump_kind last = RETURNED + 1;
+        for (unsigned listed = 0; j < l->jumpCount && l->byTo[j].to == i;
+             j++, listed++) {
+                if (listed == MAX_FROM) {
+                        p = putString(p, " ...");
+                        break;
+                }
+                Jump_kind kind = l->byTo[j].kind;
+                p = putString(p, kind == last ? " " : sep[kind]);
+                p = putUnsigned(p, l->byTo[j].from);
+                last = kind;
+        }
+        return putString(p, "\n");
+}
+
+/********** putRegion ********
+ *
+ * Writes the line in front of words that aren't code, saying how many
+ * there are and whether they look like data
+ *
+ * Parameters:
+ *      char *p:                where to write the line
+ *      const Listing *l:       the listing
+ *      uint32_t i:             the first word that isn't code
+ *
+ * Return:
+ *      the end of the line written
+ *
+ * Expects:
+ *      - There's room for LINE_ROOM chars at p
+ *
+ * Notes:
+ *      - The region was found by markCode
+ *
+ ************************/
+static char *putRegion(char *p, const Listing *l, uint32_t i)
+{
+        uint32_t lo = 0, hi = l->regionCount;
+        while (hi - lo > 1) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (l->regions[mid].start <= i) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+        Region *region = &l->regions[lo];
+        int data = region->bad || (region->data && region->length > 1);
+        p = putString(p, data ? "      ; data, " : "      ; unreached, ");
+        p = putUnsigned(p, region->length);
+        return putString(p, region->length == 1 ? " word\n" : " words\n");
+}
+
+/********** writeChunk ********
+ *
+ * Writes the listing for the words in a chunk into its text
+ *
+ * Parameters:
+ *      void *arg:              the Chunk to write
+ *
+ * Return:
+ *      NULL
+ *
+ * Expects:
+ *      - The chunk's start and end are set, and the jumps and flags are
+ *        worked out unless the listing is plain
+ *
+ * Notes:
+ *      - Replaces whatever text the chunk had, keeping its buffer
+ *
+ ************************/
+static void *writeChunk(void *arg)
+{
+        Chunk *ch = (Chunk *)arg;
+        const Listing *l = ch->l;
+        ch->size = 0;
+        uint32_t jump = l->plain ? 0 : firstAt(l->byFrom, l->jumpCount,
+                                               ch->start, 0);
+        Counter word;
+        setCounter(&word, ch->start);
+        for (uint32_t i = ch->start; i < ch->end; i++) {
+                if (ch->alloc - ch->size < 3 * LINE_ROOM) {
+                        ch->alloc = ch->alloc * 2 + 64 * ROUND_WORDS;
+                        ch->text = (char *)realloc(ch->text, ch->alloc);
+                        assert(ch->text != NULL);
+                }
+                char *p = ch->text + ch->size;
+                uint32_t w = wordAt(l, i);
+
+                if (!l->plain) {
+                        int code = l->flags[i] & CODE;
+                        int wasCode = i > 0 && (l->flags[i - 1] & CODE);
+                        if (code && (!wasCode || (l->flags[i] & ENTRY) ||
+                                     isTerminator(wordAt(l, i - 1)))) {
+                                p = putBlock(p, l, i);
+                        } else if (!code && (i == 0 || wasCode)) {
+                                p = putRegion(p, l, i);
+                        }
+                }
+
+                memcpy(p, word.text, word.width);
+                p = putHex(putString(p + word.width, ": [0x"), w);
+                countUp(&word);
+                p = putString(p, "] ");
+                char *text = p;
+                p = putInstruction(p, w);
+
+                while (jump < l->jumpCount && l->byFrom[jump].from < i) {
+                        jump++;
+                }
+                const char *sep = "; -> ";
+                for (; jump < l->jumpCount && l->byFrom[jump].from == i &&
+                       l->byFrom[jump].kind == GOTO; jump++) {
+                        while (p < text + TEXT_WIDTH) {
+                                *p++ = ' ';
+                        }
+                        p = putUnsigned(putString(p, sep),
+                                        l->byFrom[jump].to);
+                        sep = " or ";
+                }
+                *p++ = '\n';
+                ch->size = p - ch->text;
+        }
+        return NULL;
+}
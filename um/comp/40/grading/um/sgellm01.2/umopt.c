@@ -0,0 +1,1190 @@
+/****************************************************************************
+ *             umopt.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file is umopt, which rewrites a .um program into one that does the
+ * same thing with fewer or cheaper instructions:
+ *
+ *      ./umopt [-v] program.um > optimized.um
+ *
+ * Jump targets are just numbers a program loads, so every block has to
+ * start where it is; instructions are only ever replaced or moved up within
+ * their block, and one that isn't needed any more becomes a no-op (word 0,
+ * "if (r0 != 0) r0 := r0;").
+ * Within each basic block umopt keeps track of what each register holds
+ * and
+ *      - folds arithmetic on known values into load values
+ *      - turns CMOVs whose condition is known to be 0 into no-ops
+ *      - simplifies NANDs: double NOTs, NAND with 0 or all 1s, NOTs and
+ *        copies of values that are already in another register
+ *      - removes instructions whose result is overwritten before it's used
+ * then threads jumps: when a load program jumps to code that only loads a
+ * new target into the same register and jumps again (or to some no-ops),
+ * the load value in front of it is changed to jump straight to the end.
+ * Last, the no-ops in a block that ends in a jump or halt are moved after
+ * it, where they never run, and any other run of MIN_SKIP or more no-ops
+ * starts with a jump past the rest of them.
+ *
+ * A program can't be told apart from its data in general, so umopt is
+ * careful about which words it changes. A block starts at every address
+ * that's left in a register when a block ends or stored, and at every
+ * address a word of the program holds, so a block can only be entered at
+ * its top. Only words run straight through from word 0 or from a known
+ * load program target are changed, and no-ops are only ever moved or
+ * changed into a jump past them. Words an SLOAD or SSTORE is seen using
+ * (with a known address in segment 0) aren't changed, and neither is any
+ * block a store writes to. Beyond that, umopt assumes a program doesn't
+ * jump to addresses it works out with arithmetic at run time, or read or
+ * write its own instructions through them; a program that does (like
+ * sandmark, which unpacks itself) can't be optimized.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "instructions.h"
+#include "assert.h"
+
+#define LOADVAL_MAX (1u << 25)
+#define MAX_HOPS 8
+#define MAX_EITHER 8
+#define MIN_SKIP 4
+#define NOP 0u
+
+typedef enum Value_kind { OPAQUE = 0, CONST, NOT, EITHER } Value_kind;
+
+/* what a register holds: a known number, the NOT of another value, one of
+ * two values (after a CMOV) or something unknown (which is still the same
+ * thing wherever its id is) */
+typedef struct Value {
+        Value_kind kind;
+        uint32_t n;             /* the number for CONST, an id otherwise */
+        uint32_t m;             /* the other id for EITHER */
+} Value;
+
+typedef struct Block {
+        uint32_t reg[8];        /* the id of the value in each register */
+        Value *values;
+        uint32_t count;
+} Block;
+
+typedef struct Optimizer {
+        uint32_t length;
+        uint32_t *in;           /* the program as it was read */
+        uint32_t *out;          /* the program being written */
+        char *leaders;          /* words a block starts at */
+        char *entries;          /* words the program is seen jumping to */
+        char *code;             /* words run straight through from an entry */
+        char *pinned;           /* words an SLOAD reads */
+        char *storedTo;         /* words an SSTORE writes */
+        char *frozen;           /* words in a block with a storedTo word */
+        int zero[8];            /* registers nothing ever writes */
+        Value *values;
+        unsigned folded, removed, simplified, threaded, skipped;
+} Optimizer;
+
+static uint32_t *read_in(FILE *f, struct stat sb, uint32_t *length);
+static void write_out(Optimizer *o, FILE *f);
+static void findLeaders(Optimizer *o);
+static void findCode(Optimizer *o);
+typedef uint32_t (*Um_split)(Optimizer *o, uint32_t start);
+
+static int analyzeAll(Optimizer *o, int rewrite, Um_split next);
+static void freeze(Optimizer *o);
+static int analyzeBlock(Optimizer *o, uint32_t start, uint32_t end,
+                        int rewrite);
+static int step(Optimizer *o, Block *blk, uint32_t i, int rewrite);
+static void replace(Optimizer *o, Block *blk, uint32_t i, unsigned dest,
+                    uint32_t result);
+static void removeDeadCode(Optimizer *o, uint32_t start, uint32_t end);
+static void threadJumps(Optimizer *o, uint32_t start, uint32_t end);
+static uint32_t follow(Optimizer *o, uint32_t target, unsigned b,
+                       unsigned c);
+static void compactBlock(Optimizer *o, uint32_t start, uint32_t end);
+static void skipNopRuns(Optimizer *o, uint32_t start, uint32_t end);
+
+static inline unsigned opOf(uint32_t w)  { return w >> 28; }
+static inline unsigned aOf(uint32_t w)   { return (w >> 6) & 0x7; }
+static inline unsigned bOf(uint32_t w)   { return (w >> 3) & 0x7; }
+static inline unsigned cOf(uint32_t w)   { return w & 0x7; }
+static inline unsigned lvReg(uint32_t w) { return (w >> 25) & 0x7; }
+static inline uint32_t lvVal(uint32_t w) { return w & (LOADVAL_MAX - 1); }
+
+static inline uint32_t threeRegister(Um_opcode op, unsigned a, unsigned b,
+                                     unsigned c)
+{
+        return ((uint32_t)op << 28) | (a << 6) | (b << 3) | c;
+}
+
+static inline uint32_t loadValue(unsigned a, uint32_t value)
+{
+        return ((uint32_t)LV << 28) | (a << 25) | value;
+}
+
+static inline int isTerminator(uint32_t w)
+{
+        return opOf(w) == LOADP || opOf(w) == HALT || opOf(w) > LV;
+}
+
+/* the register an instruction sets (maybe, for CMOV), or -1 */
+static inline int writes(uint32_t w)
+{
+        switch (opOf(w)) {
+                case CMOV: case SLOAD: case ADD: case MUL: case DIV:
+                case NAND:
+                        return aOf(w);
+                case ACTIVATE:
+                        return bOf(w);
+                case IN:
+                        return cOf(w);
+                case LV:
+                        return lvReg(w);
+                default:
+                        return -1;
+        }
+}
+
+/* the registers an instruction reads, as a mask; a CMOV counts as reading
+ * its a, since a keeps its old value when the condition is 0 */
+static inline unsigned reads(uint32_t w)
+{
+        unsigned a = 1u << aOf(w), b = 1u << bOf(w), c = 1u << cOf(w);
+        switch (opOf(w)) {
+                case CMOV: case SSTORE:
+                        return a | b | c;
+                case SLOAD: case ADD: case MUL: case DIV: case NAND:
+                case LOADP:
+                        return b | c;
+                case ACTIVATE: case INACTIVATE: case OUT:
+                        return c;
+                default:
+                        return 0;
+        }
+}
+
+/* a CMOV that can't change anything, whatever the registers hold */
+static inline int isNop(Optimizer *o, uint32_t w)
+{
+        return opOf(w) == CMOV && (aOf(w) == bOf(w) || o->zero[cOf(w)]);
+}
+
+/* the word after the block starting at start */
+static inline uint32_t blockEnd(Optimizer *o, uint32_t start)
+{
+        uint32_t end = start + 1;
+        while (end < o->length && !o->leaders[end]) {
+                end++;
+        }
+        return end;
+}
+
+/* the word after the straight run of code starting at start, which only
+ * ends at a load program, halt or bad instruction */
+static inline uint32_t runEnd(Optimizer *o, uint32_t start)
+{
+        uint32_t end = start + 1;
+        while (end < o->length && !isTerminator(o->in[end - 1])) {
+                end++;
+        }
+        return end;
+}
+
+static inline int rewritable(Optimizer *o, uint32_t i)
+{
+        return o->code[i] && !o->pinned[i] && !o->frozen[i];
+}
+
+/********** main ********
+ *
+ * Reads in a .um program, optimizes it and writes it to stdout
+ *
+ * Parameters:
+ *      int argc:               the number of arguments provided
+ *      char *argv[]:           array of the arguments provided
+ *
+ * Return:
+ *      - EXIT_SUCCESS if the program was written out
+ *
+ * Expects:
+ *      - A .um file is provided, optionally after -v
+ *
+ * Notes:
+ *      - The program is analyzed again until the known jump targets,
+ *        pinned words and stored-to words stop changing, then rewritten
+ *        a block at a time
+ *      - What happens along a straight run of code doesn't depend on
+ *        where the run was entered, so jump targets, dead code and jump
+ *        threading are worked out over whole runs, not blocks
+ *      - -v prints how many instructions each pass changed to stderr
+ *      - Blocks are compacted before jumps are threaded, since threading
+ *        can point a jump past the no-ops at the top of a block
+ *
+ ************************/
+int main(int argc, char *argv[])
+{
+        int verbose = argc == 3 && strcmp(argv[1], "-v") == 0;
+        if (argc != 2 && !verbose) {
+                fprintf(stderr, "usage: ./umopt [-v] program.um "
+                                "> optimized.um\n");
+                return EXIT_FAILURE;
+        }
+
+        FILE *f = fopen(argv[argc - 1], "r");
+        struct stat sb;
+        if (f == NULL || stat(argv[argc - 1], &sb) == -1) {
+                fprintf(stderr, "Could not open file.\n");
+                return EXIT_FAILURE;
+        }
+
+        Optimizer o;
+        memset(&o, 0, sizeof(o));
+        o.in = read_in(f, sb, &o.length);
+        fclose(f);
+
+        uint32_t n = o.length + 1;
+        o.out = (uint32_t *)malloc(n * sizeof(uint32_t));
+        o.leaders = (char *)calloc(n, 1);
+        o.entries = (char *)calloc(n, 1);
+        o.code = (char *)calloc(n, 1);
+        o.pinned = (char *)calloc(n, 1);
+        o.storedTo = (char *)calloc(n, 1);
+        o.frozen = (char *)calloc(n, 1);
+        o.values = (Value *)malloc((n + 8) * sizeof(Value));
+        assert(o.out != NULL && o.leaders != NULL && o.entries != NULL &&
+               o.code != NULL && o.pinned != NULL && o.storedTo != NULL &&
+               o.frozen != NULL && o.values != NULL);
+        memcpy(o.out, o.in, o.length * sizeof(uint32_t));
+
+        /* a register nothing writes holds 0 the whole time; a run that
+         * ends in a bad instruction can't run without failing, so it's
+         * data and doesn't count */
+        for (int r = 0; r < 8; r++) {
+                o.zero[r] = 1;
+        }
+        for (uint32_t i = 0; i < o.length; i = runEnd(&o, i)) {
+                uint32_t end = runEnd(&o, i);
+                if (opOf(o.in[end - 1]) > LV) {
+                        continue;
+                }
+                for (uint32_t j = i; j < end; j++) {
+                        if (writes(o.in[j]) >= 0) {
+                                o.zero[writes(o.in[j])] = 0;
+                        }
+                }
+        }
+
+        findLeaders(&o);
+        int changed;
+        do {
+                findCode(&o);
+                changed = analyzeAll(&o, 0, runEnd);
+                changed |= analyzeAll(&o, 0, blockEnd);
+        } while (changed);
+        freeze(&o);
+        analyzeAll(&o, 1, blockEnd);
+
+        for (uint32_t i = 0; i < o.length; i = runEnd(&o, i)) {
+                removeDeadCode(&o, i, runEnd(&o, i));
+        }
+        for (uint32_t i = 0; i < o.length; i = blockEnd(&o, i)) {
+                compactBlock(&o, i, blockEnd(&o, i));
+        }
+        for (uint32_t i = 0; i < o.length; i = runEnd(&o, i)) {
+                threadJumps(&o, i, runEnd(&o, i));
+        }
+        for (uint32_t i = 0; i < o.length; i = runEnd(&o, i)) {
+                skipNopRuns(&o, i, runEnd(&o, i));
+        }
+
+        write_out(&o, stdout);
+        if (verbose) {
+                fprintf(stderr, "%u words: %u folded, %u removed, "
+                                "%u simplified, %u jumps threaded, "
+                                "%u no-ops skipped\n",
+                        (unsigned)o.length, o.folded, o.removed,
+                        o.simplified, o.threaded, o.skipped);
+        }
+
+        free(o.in);
+        free(o.out);
+        free(o.leaders);
+        free(o.entries);
+        free(o.code);
+        free(o.pinned);
+        free(o.storedTo);
+        free(o.frozen);
+        free(o.values);
+        return EXIT_SUCCESS;
+}
+
+/********** read_in ********
+ *
+ * Reads in the words of a .um program
+ *
+ * Parameters:
+ *      FILE *f:                file pointer (already opened)
+ *      struct stat sb:         stat struct with the size of the file
+ *      uint32_t *length:       where to put the number of words
+ *
+ * Return:
+ *      the words, which the caller frees
+ *
+ * Expects:
+ *      - The file is already open
+ *
+ * Notes:
+ *      - Exits if the file ends in the middle of a word, like the um
+ *
+ ************************/
+static uint32_t *read_in(FILE *f, struct stat sb, uint32_t *length)
+{
+        *length = sb.st_size / 4;
+        uint32_t *words = (uint32_t *)malloc((*length + 1) *
+                                             sizeof(uint32_t));
+        assert(words != NULL);
+
+        for (uint32_t j = 0; j < *length; j++) {
+                uint32_t word = 0;
+                for (int i = 0; i < 4; i++) {
+                        int byte = getc(f);
+                        if (byte == EOF) {
+                                exit(1);
+                        }
+                        word = word << 8 | (uint32_t)byte;
+                }
+                words[j] = word;
+        }
+        return words;
+}
+
+/********** write_out ********
+ *
+ * Writes out the optimized program, a big-endian word at a time
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      FILE *f:                where to write it
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - o->out holds o->length words
+ *
+ * Notes:
+ *
+ ************************/
+static void write_out(Optimizer *o, FILE *f)
+{
+        for (uint32_t j = 0; j < o->length; j++) {
+                for (int i = 24; i >= 0; i -= 8) {
+                        putc((o->out[j] >> i) & 0xff, f);
+                }
+        }
+}
+
+/********** findLeaders ********
+ *
+ * Marks the words that might be jumped to, where blocks have to start
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - o->leaders is all 0
+ *
+ * Notes:
+ *      - A block starts at word 0, after every load program, halt or bad
+ *        instruction and at every word some word of the program holds the
+ *        address of (jump tables)
+ *      - The rest are added as the blocks are analyzed, wherever a known
+ *        address might be jumped to later
+ *
+ ************************/
+static void findLeaders(Optimizer *o)
+{
+        o->leaders[0] = 1;
+        o->entries[0] = 1;
+        for (uint32_t i = 0; i < o->length; i++) {
+                uint32_t w = o->in[i];
+                if (w < o->length) {
+                        o->leaders[w] = 1;
+                }
+                if (isTerminator(w) && i + 1 < o->length) {
+                        o->leaders[i + 1] = 1;
+                }
+        }
+}
+
+/********** findCode ********
+ *
+ * Marks the words that run straight through from an entry
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - o->entries holds the jump targets found so far
+ *
+ * Notes:
+ *      - Stops at every load program, halt or bad instruction
+ *
+ ************************/
+static void findCode(Optimizer *o)
+{
+        for (uint32_t i = 0; i < o->length; i++) {
+                if (!o->entries[i]) {
+                        continue;
+                }
+                for (uint32_t p = i; p < o->length && !o->code[p]; p++) {
+                        o->code[p] = 1;
+                        if (isTerminator(o->in[p])) {
+                                break;
+                        }
+                }
+        }
+}
+
+/********** analyzeAll ********
+ *
+ * Analyzes the whole program, a piece at a time
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      int rewrite:            whether to write the changes to o->out
+ *      Um_split next:          gives the end of the piece starting at a
+ *                              word (blockEnd or runEnd)
+ *
+ * Return:
+ *      1 if any new jump target, pinned word or stored-to word was found
+ *
+ * Expects:
+ *      - Only rewrites with blockEnd, after freeze
+ *
+ * Notes:
+ *
+ ************************/
+static int analyzeAll(Optimizer *o, int rewrite, Um_split next)
+{
+        int changed = 0;
+        for (uint32_t start = 0; start < o->length; start = next(o, start)) {
+                changed |= analyzeBlock(o, start, next(o, start), rewrite);
+        }
+        return changed;
+}
+
+/********** freeze ********
+ *
+ * Marks the words of every block with a stored-to word frozen, so the
+ * block is left alone
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - The leaders and stored-to words are all found
+ *
+ * Notes:
+ *
+ ************************/
+static void freeze(Optimizer *o)
+{
+        for (uint32_t start = 0; start < o->length; ) {
+                uint32_t end = blockEnd(o, start);
+                char frozen = 0;
+                for (uint32_t i = start; i < end; i++) {
+                        frozen |= o->storedTo[i];
+                }
+                memset(o->frozen + start, frozen, end - start);
+                start = end;
+        }
+}
+
+/* value numbering for one block */
+
+static uint32_t newEither(Block *blk, Value_kind kind, uint32_t n,
+                          uint32_t m)
+{
+        if (kind == EITHER && n == m) {
+                return n;
+        }
+        if (kind == NOT) {
+                Value of = blk->values[n];
+                if (of.kind == NOT) {
+                        return of.n;
+                }
+                if (of.kind == CONST) {
+                        kind = CONST;
+                        n = ~of.n;
+                }
+        }
+        blk->values[blk->count].kind = kind;
+        blk->values[blk->count].n = kind == OPAQUE ? 0 : n;
+        blk->values[blk->count].m = kind == EITHER ? m : 0;
+        return blk->count++;
+}
+
+
+static uint32_t newValue(Block *blk, Value_kind kind, uint32_t n)
+{
+        return newEither(blk, kind, n, 0);
+}
+
+static inline int known(Block *blk, unsigned r, uint32_t *n)
+{
+        Value v = blk->values[blk->reg[r]];
+        *n = v.n;
+        return v.kind == CONST;
+}
+
+static inline int same(Block *blk, uint32_t x, uint32_t y)
+{
+        Value vx = blk->values[x], vy = blk->values[y];
+        return x == y || (vx.kind == CONST && vy.kind == CONST &&
+                          vx.n == vy.n);
+}
+
+/* a register other than skip holding value id, or -1 */
+static inline int holder(Block *blk, uint32_t id, int skip)
+{
+        for (int r = 0; r < 8; r++) {
+                if (r != skip && same(blk, blk->reg[r], id)) {
+                        return r;
+                }
+        }
+        return -1;
+}
+
+/* a register known to hold 0, or -1 */
+static inline int zeroHolder(Block *blk)
+{
+        uint32_t n;
+        for (int r = 0; r < 8; r++) {
+                if (known(blk, r, &n) && n == 0) {
+                        return r;
+                }
+        }
+        return -1;
+}
+
+/* notes that value id might be jumped to later, if it's a known address
+ * (or two, after a CMOV); if word i jumps to it now it's an entry too */
+static int addEntry(Optimizer *o, Block *blk, uint32_t id, uint32_t i,
+                    int jumped, int depth)
+{
+        Value v = blk->values[id];
+        if (v.kind == EITHER && depth < MAX_EITHER) {
+                return addEntry(o, blk, v.n, i, jumped, depth + 1) |
+                       addEntry(o, blk, v.m, i, jumped, depth + 1);
+        }
+        if (v.kind != CONST || v.n >= o->length) {
+                return 0;
+        }
+        int entry = jumped && o->code[i];
+        int changed = !o->leaders[v.n] || (entry && !o->entries[v.n]);
+        o->leaders[v.n] = 1;
+        o->entries[v.n] |= entry;
+        return changed;
+}
+
+/********** analyzeBlock ********
+ *
+ * Follows the values in the registers through one block or run
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t start:         the first word of the block
+ *      uint32_t end:           the word after the block
+ *      int rewrite:            whether to write the changes to o->out
+ *
+ * Return:
+ *      1 if any new jump target, pinned word or stored-to word was found
+ *
+ * Expects:
+ *      - start is a leader, and there are none before end if rewriting
+ *
+ * Notes:
+ *      - Nothing is known at the start except the registers nothing
+ *        writes, which are 0
+ *      - Works from the original words; the rewritten ones do the same
+ *        thing, so the values come out the same either way
+ *
+ ************************/
+static int analyzeBlock(Optimizer *o, uint32_t start, uint32_t end,
+                        int rewrite)
+{
+        Block blk;
+        blk.values = o->values;
+        blk.count = 0;
+        for (int r = 0; r < 8; r++) {
+                blk.reg[r] = newValue(&blk, o->zero[r] ? CONST : OPAQUE, 0);
+        }
+
+        int changed = 0;
+        for (uint32_t i = start; i < end; i++) {
+                changed |= step(o, &blk, i, rewrite && rewritable(o, i));
+        }
+
+        /* the next block doesn't know what's in the registers, so it
+         * could jump to any address left in one */
+        if (!isTerminator(o->in[end - 1])) {
+                for (int r = 0; r < 8; r++) {
+                        changed |= addEntry(o, &blk, blk.reg[r], end - 1,
+                                            0, 0);
+                }
+        }
+        return changed;
+}
+
+/********** step ********
+ *
+ * Works out what one instruction leaves in the registers, and replaces it
+ * with something cheaper if it can
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      Block *blk:             the values in the registers before it
+ *      uint32_t i:             the word the instruction is in
+ *      int rewrite:            whether it may be replaced
+ *
+ * Return:
+ *      1 if it found a new jump target, pinned word or stored-to word
+ *
+ * Expects:
+ *      - blk is the state of the registers just before word i runs
+ *
+ * Notes:
+ *      - A DIV is only ever changed when its divisor is known not to be
+ *        0, so one that would fail still does
+ *      - Constants left in registers at a load program or the end of the
+ *        block and stored values might be jumped to later, so blocks start
+ *        there; only the target of a load program (either one, if a CMOV
+ *        picked it) is taken as code
+ *
+ ************************/
+static int step(Optimizer *o, Block *blk, uint32_t i, int rewrite)
+{
+        uint32_t inst = o->in[i];
+        unsigned a = aOf(inst), b = bOf(inst), c = cOf(inst);
+        uint32_t x, y;
+        int kb = known(blk, b, &x);
+        int kc = known(blk, c, &y);
+        int dest = -1;
+        uint32_t result = 0;
+        int changed = 0;
+
+        switch (opOf(inst)) {
+                case CMOV:
+                        dest = a;
+                        if (kc) {
+                                result = y == 0 ? blk->reg[a] : blk->reg[b];
+                        } else if (same(blk, blk->reg[a], blk->reg[b])) {
+                                result = blk->reg[a];
+                        } else {
+                                result = newEither(blk, EITHER, blk->reg[a],
+                                                   blk->reg[b]);
+                        }
+                        break;
+                case SLOAD:
+                        if (kb && x == 0 && kc && y < o->length &&
+                            !o->pinned[y]) {
+                                o->pinned[y] = 1;
+                                changed = 1;
+                        }
+                        dest = a;
+                        result = newValue(blk, OPAQUE, 0);
+                        break;
+                case SSTORE:
+                {
+                        uint32_t seg;
+                        if (known(blk, a, &seg) && seg == 0 && kb &&
+                            x < o->length && !o->storedTo[x]) {
+                                o->storedTo[x] = 1;
+                                changed = 1;
+                        }
+                        changed |= addEntry(o, blk, blk->reg[c], i, 0, 0);
+                        break;
+                }
+                case ADD:
+                        dest = a;
+                        if (kb && kc) {
+                                result = newValue(blk, CONST, x + y);
+                        } else if (kb && x == 0) {
+                                result = blk->reg[c];
+                        } else if (kc && y == 0) {
+                                result = blk->reg[b];
+                        } else {
+                                result = newValue(blk, OPAQUE, 0);
+                        }
+                        break;
+                case MUL:
+                        dest = a;
+                        if (kb && kc) {
+                                result = newValue(blk, CONST, x * y);
+                        } else if ((kb && x == 0) || (kc && y == 0)) {
+                                result = newValue(blk, CONST, 0);
+                        } else if (kb && x == 1) {
+                                result = blk->reg[c];
+                        } else if (kc && y == 1) {
+                                result = blk->reg[b];
+                        } else {
+                                result = newValue(blk, OPAQUE, 0);
+                        }
+                        break;
+                case DIV:
+                        dest = a;
+                        if (kc && y != 0 && kb) {
+                                result = newValue(blk, CONST, x / y);
+                        } else if (kc && y == 1) {
+                                result = blk->reg[b];
+                        } else {
+                                result = newValue(blk, OPAQUE, 0);
+                        }
+                        break;
+                case NAND:
+                        dest = a;
+                        if (kb && kc) {
+                                result = newValue(blk, CONST, ~(x & y));
+                        } else if ((kb && x == 0) || (kc && y == 0)) {
+                                result = newValue(blk, CONST, ~0u);
+                        } else if (same(blk, blk->reg[b], blk->reg[c])) {
+                                result = newValue(blk, NOT, blk->reg[b]);
+                        } else if (kb && x == ~0u) {
+                                result = newValue(blk, NOT, blk->reg[c]);
+                        } else if (kc && y == ~0u) {
+                                result = newValue(blk, NOT, blk->reg[b]);
+                        } else {
+                                result = newValue(blk, OPAQUE, 0);
+                        }
+                        break;
+                case ACTIVATE:
+                        dest = b;
+                        result = newValue(blk, OPAQUE, 0);
+                        break;
+                case IN:
+                        dest = c;
+                        result = newValue(blk, OPAQUE, 0);
+                        break;
+                case LOADP:
+                        for (int r = 0; r < 8; r++) {
+                                changed |= addEntry(o, blk, blk->reg[r], i,
+                                                    r == (int)c, 0);
+                        }
+                        break;
+                case LV:
+                        dest = lvReg(inst);
+                        result = newValue(blk, CONST, lvVal(inst));
+                        break;
+                default:
+                        break;
+        }
+
+        if (dest >= 0) {
+                if (rewrite) {
+                        replace(o, blk, i, dest, result);
+                }
+                blk->reg[dest] = result;
+        }
+        return changed;
+}
+
+/********** replace ********
+ *
+ * Replaces the instruction in word i with the cheapest one that leaves
+ * the same value in its register
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      Block *blk:             the values in the registers before it
+ *      uint32_t i:             the word the instruction is in
+ *      unsigned dest:          the register it sets
+ *      uint32_t result:        the id of the value it leaves there
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - Word i may be rewritten
+ *
+ * Notes:
+ *      - In order: a no-op if dest already holds the value, a load value
+ *        if the value is a small enough constant, and for anything but an
+ *        ADD, a copy (an ADD of a register that holds 0) or a NOT of a
+ *        register that already holds the value or what it's the NOT of
+ *
+ ************************/
+static void replace(Optimizer *o, Block *blk, uint32_t i, unsigned dest,
+                    uint32_t result)
+{
+        uint32_t inst = o->in[i];
+        Value v = blk->values[result];
+        uint32_t with = inst;
+        unsigned *count = &o->simplified;
+
+        if (isNop(o, inst)) {
+                return;
+        }
+        if (same(blk, blk->reg[dest], result)) {
+                with = NOP;
+                count = &o->removed;
+        } else if (v.kind == CONST && v.n < LOADVAL_MAX) {
+                with = loadValue(dest, v.n);
+                count = &o->folded;
+        } else if (opOf(inst) != ADD) {
+                int r = holder(blk, result, dest);
+                int z = zeroHolder(blk);
+                if (r >= 0 && z >= 0) {
+                        with = threeRegister(ADD, dest, r, z);
+                } else if (v.kind == NOT && opOf(inst) == NAND &&
+                           !same(blk, blk->reg[bOf(inst)], v.n) &&
+                           (r = holder(blk, v.n, -1)) >= 0) {
+                        with = threeRegister(NAND, dest, r, r);
+                }
+        }
+
+        if (with != inst) {
+                o->out[i] = with;
+                (*count)++;
+        }
+}
+
+/********** removeDeadCode ********
+ *
+ * Replaces instructions in a run whose result is never used with no-ops
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t start:         the first word of the run
+ *      uint32_t end:           the word after the run
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - analyzeAll has written o->out
+ *
+ * Notes:
+ *      - Goes backwards keeping track of which registers might still be
+ *        read; everything is live at the end of a run unless it halts
+ *      - Only CMOV, ADD, MUL, NAND and LV are removed, since the rest
+ *        have some other effect or could fail
+ *
+ ************************/
+static void removeDeadCode(Optimizer *o, uint32_t start, uint32_t end)
+{
+        unsigned live = 0xff;
+        for (uint32_t i = end; i-- > start; ) {
+                uint32_t inst = o->out[i];
+                unsigned op = opOf(inst);
+                int dest = writes(inst);
+
+                if (op == HALT) {
+                        live = 0;
+                        continue;
+                }
+                if (op > LV) {
+                        live = 0xff;
+                        continue;
+                }
+                if (isNop(o, inst)) {
+                        continue;
+                }
+                if ((op == CMOV || op == ADD || op == MUL || op == NAND ||
+                     op == LV) && !(live & (1u << dest)) &&
+                    rewritable(o, i)) {
+                        o->out[i] = NOP;
+                        o->removed++;
+                        continue;
+                }
+                if (dest >= 0 && op != CMOV) {
+                        live &= ~(1u << dest);
+                }
+                live |= reads(inst);
+        }
+}
+
+/* skips words that can't do anything, stopping at any that might change */
+static uint32_t skipNops(Optimizer *o, uint32_t p)
+{
+        while (p < o->length && !o->frozen[p] && isNop(o, o->out[p])) {
+                p++;
+        }
+        return p;
+}
+
+/* whether word p loads a new target into c and jumps there with a
+ * register holding 0 (b, or one nothing writes) */
+static int chainAt(Optimizer *o, uint32_t p, unsigned b, unsigned c)
+{
+        if (p + 1 >= o->length || o->frozen[p] || o->frozen[p + 1]) {
+                return 0;
+        }
+        uint32_t load = o->out[p], jump = o->out[p + 1];
+        return opOf(load) == LV && lvReg(load) == c &&
+               lvVal(load) < o->length && opOf(jump) == LOADP &&
+               cOf(jump) == c && (bOf(jump) == b || o->zero[bOf(jump)]);
+}
+
+/* whether register c is set before it's read, running from word p */
+static int deadAt(Optimizer *o, uint32_t p, unsigned c)
+{
+        for (; p < o->length && !o->frozen[p]; p++) {
+                uint32_t w = o->out[p];
+                if (isNop(o, w)) {
+                        continue;
+                }
+                if (reads(w) & (1u << c)) {
+                        return 0;
+                }
+                if (writes(w) == (int)c) {
+                        return 1;
+                }
+                if (isTerminator(w)) {
+                        return opOf(w) == HALT;
+                }
+        }
+        return 0;
+}
+
+/********** threadJumps ********
+ *
+ * Points the jumps in a run straight at where they end up
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t start:         the first word of the run
+ *      uint32_t end:           the word after the run
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - removeDeadCode has run on every run
+ *
+ * Notes:
+ *      - Only a load program of segment 0 whose target came from an LV
+ *        in the run (which nothing else reads) is changed, by changing
+ *        the LV; a CMOV between them can still pick the other target
+ *
+ ************************/
+static void threadJumps(Optimizer *o, uint32_t start, uint32_t end)
+{
+        int lvAt[8];
+        int zeroNow[8];
+        for (int r = 0; r < 8; r++) {
+                lvAt[r] = -1;
+                zeroNow[r] = o->zero[r];
+        }
+
+        for (uint32_t i = start; i < end; i++) {
+                uint32_t inst = o->out[i];
+                unsigned a = aOf(inst), b = bOf(inst), c = cOf(inst);
+                if (isNop(o, inst)) {
+                        continue;
+                }
+
+                switch (opOf(inst)) {
+                        case LV:
+                                lvAt[lvReg(inst)] = i;
+                                zeroNow[lvReg(inst)] = lvVal(inst) == 0;
+                                break;
+                        case CMOV:
+                                lvAt[b] = -1;
+                                lvAt[c] = -1;
+                                zeroNow[a] = zeroNow[a] && zeroNow[b];
+                                break;
+                        case LOADP:
+                        {
+                                int j = lvAt[c];
+                                if (b == c || !zeroNow[b] || j < 0 ||
+                                    !rewritable(o, j)) {
+                                        break;
+                                }
+                                uint32_t target = lvVal(o->out[j]);
+                                uint32_t land = follow(o, target, b, c);
+                                if (land != target && land < LOADVAL_MAX) {
+                                        o->out[j] = loadValue(c, land);
+                                        o->threaded++;
+                                }
+                                break;
+                        }
+                        default:
+                                for (int r = 0; r < 8; r++) {
+                                        if (reads(inst) & (1u << r)) {
+                                                lvAt[r] = -1;
+                                        }
+                                }
+                                if (writes(inst) >= 0) {
+                                        lvAt[writes(inst)] = -1;
+                                        zeroNow[writes(inst)] = 0;
+                                }
+                                break;
+                }
+        }
+}
+
+/********** follow ********
+ *
+ * Finds where a jump to target really ends up
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t target:        where the jump goes
+ *      unsigned b:             the register holding 0 it jumps with
+ *      unsigned c:             the register holding target
+ *
+ * Return:
+ *      the word to jump to instead (target if there's nothing better)
+ *
+ * Expects:
+ *      - b holds 0 and c holds target when the jump runs
+ *
+ * Notes:
+ *      - Follows up to MAX_HOPS jumps that are just an LV into c and a
+ *        load program, after which c holds the last target, the same as
+ *        if the jumps had run
+ *      - Only skips the no-ops at the last target if c is set again
+ *        before it's read, since c would hold a different address
+ *
+ ************************/
+static uint32_t follow(Optimizer *o, uint32_t target, unsigned b,
+                       unsigned c)
+{
+        for (int hop = 0; hop < MAX_HOPS && target < o->length; hop++) {
+                uint32_t p = skipNops(o, target);
+                if (!chainAt(o, p, b, c)) {
+                        break;
+                }
+                target = lvVal(o->out[p]);
+        }
+        if (target >= o->length) {
+                return target;
+        }
+        uint32_t p = skipNops(o, target);
+        return deadAt(o, p, c) ? p : target;
+}
+
+/********** compactBlock ********
+ *
+ * Moves the instructions in a block that ends in a jump or halt up over
+ * its no-ops, leaving the no-ops after the end where they never run
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t start:         the first word of the block
+ *      uint32_t end:           the word after the block
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - removeDeadCode has run on every run
+ *
+ * Notes:
+ *      - Nothing jumps into the middle of a block and no instruction
+ *        depends on the word it's in, so the block does the same thing;
+ *        if any word of it can't be rewritten, it's left alone
+ *      - The words left after the end aren't code any more, so the later
+ *        passes don't look at them
+ *
+ ************************/
+static void compactBlock(Optimizer *o, uint32_t start, uint32_t end)
+{
+        unsigned op = opOf(o->out[end - 1]);
+        if (op != LOADP && op != HALT) {
+                return;
+        }
+        for (uint32_t i = start; i < end; i++) {
+                if (!rewritable(o, i)) {
+                        return;
+                }
+        }
+
+        uint32_t to = start;
+        for (uint32_t i = start; i < end; i++) {
+                if (!isNop(o, o->out[i])) {
+                        o->out[to++] = o->out[i];
+                }
+        }
+        o->skipped += end - to;
+        for (; to < end; to++) {
+                o->out[to] = NOP;
+                o->code[to] = 0;
+        }
+}
+
+/********** skipNopRuns ********
+ *
+ * Starts every run of MIN_SKIP or more no-ops in a run of code with a jump
+ * to the word after it
+ *
+ * Parameters:
+ *      Optimizer *o:           the optimizer holding the program
+ *      uint32_t start:         the first word of the run of code
+ *      uint32_t end:           the word after the run of code
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - threadJumps has run on every run
+ *
+ * Notes:
+ *      - The jump is an LV of the address into a register that's set
+ *        again before it's read, then a load program with a register
+ *        nothing writes (so it holds 0); a program that writes all 8
+ *        registers doesn't get any
+ *      - The second no-op can't be a leader, since jumping straight to
+ *        the load program would go wherever the register happened to
+ *        point; the others can, they just run the no-ops left after them
+ *
+ ************************/
+static void skipNopRuns(Optimizer *o, uint32_t start, uint32_t end)
+{
+        int zero = -1;
+        for (int r = 0; r < 8 && zero < 0; r++) {
+                if (o->zero[r]) {
+                        zero = r;
+                }
+        }
+        if (zero < 0) {
+                return;
+        }
+
+        for (uint32_t i = start; i < end; ) {
+                uint32_t after = i;
+                while (after < end && rewritable(o, after) &&
+                       isNop(o, o->out[after])) {
+                        after++;
+                }
+                if (after - i >= MIN_SKIP && after < o->length &&
+                    after < LOADVAL_MAX && !o->leaders[i + 1]) {
+                        for (int r = 0; r < 8; r++) {
+                                if (o->zero[r] || !deadAt(o, after, r)) {
+                                        continue;
+                                }
+                                o->out[i] = loadValue(r, after);
+                                o->out[i + 1] = threeRegister(LOADP, 0, zero,
+                                                              r);
+                                o->skipped += after - i - 2;
+                                break;
+                        }
+                }
+                i = after > i ? after : i + 1;
+        }
+}
@@ -0,0 +1,505 @@
+/****************************************************************************
+ *             umsched.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file runs many universal machines (guests) on one thread. Each
+ * runnable guest gets a quantum of instructions in turn, round robin, and
+ * a guest that reaches an IN instruction with no input waiting is parked
+ * until its input (a pipe, FIFO or file) is readable, which we find out
+ * with epoll. A guest that fails is stopped without stopping the others.
+ * When every guest has halted, the share of the CPU each one got and how
+ * long each one waited to run once it was ready are printed to stderr.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include "seq.h"
+#include "except.h"
+#include "assert.h"
+#include "segmentData.h"
+#include "machine.h"
+#include "trace.h"
+
+#define DEFAULT_QUANTUM 10000
+#define MAX_EVENTS 64
+
+typedef struct Guest {
+        char *program;
+        SegmentData *sd;
+        int failed;
+        double cpuSeconds;
+        double readySince;
+
+        /* seconds from becoming runnable to being run, one per quantum */
+        float *waits;
+        size_t numWaits;
+        size_t waitsSize;
+} Guest;
+
+static Guest *newGuest(char *spec);
+static void freeGuest(Guest *g);
+static void schedule(Guest *guests, int numGuests, unsigned quantum);
+static Um_status runGuest(Guest *g, unsigned quantum);
+static void parkGuest(Guest *g, int epfd, Seq_T runQueue);
+static void fillInput(SegmentData *sd);
+static void recordWait(Guest *g, double wait);
+static void report(Guest *guests, int numGuests);
+static double now(void);
+
+/********** main ********
+ *
+ * Sets up a guest for each program named on the command line and runs
+ * them all until they halt
+ *
+ * Parameters:
+ *      int argc:               the number of arguments provided
+ *      char *argv[]:           array of the arguments provided
+ *
+ * Return:
+ *      - EXIT_SUCCESS if every guest halted, EXIT_FAILURE if any failed
+ *
+ * Expects:
+ *      - Arguments of the form [-q quantum] program.um[:input[:output]]...
+ *
+ * Notes:
+ *      - A guest with no input sees end of file on its first IN, and a
+ *        guest with no output writes to stdout
+ *
+ ************************/
+int main(int argc, char *argv[])
+{
+        unsigned quantum = DEFAULT_QUANTUM;
+        int first = 1;
+        if (argc > 2 && strcmp(argv[1], "-q") == 0) {
+                quantum = (unsigned)strtoul(argv[2], NULL, 10);
+                first = 3;
+        }
+        if (first >= argc || quantum == 0) {
+                fprintf(stderr, "usage: ./umsched [-q quantum] "
+                                "program.um[:input[:output]]...\n");
+                return EXIT_FAILURE;
+        }
+
+        int numGuests = argc - first;
+        Guest *guests = malloc(numGuests * sizeof(*guests));
+        assert(guests != NULL);
+        for (int i = 0; i < numGuests; i++) {
+                Guest *g = newGuest(argv[first + i]);
+                if (g == NULL) {
+                        return EXIT_FAILURE;
+                }
+                guests[i] = *g;
+                free(g);
+        }
+
+        schedule(guests, numGuests, quantum);
+        report(guests, numGuests);
+
+        int failed = 0;
+        for (int i = 0; i < numGuests; i++) {
+                failed |= guests[i].failed;
+                freeGuest(&guests[i]);
+        }
+        free(guests);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/********** newGuest ********
+ *
+ * Sets up a guest from a program.um[:input[:output]] argument
+ *
+ * Parameters:
+ *      char *spec:             the argument naming the guest's program,
+ *                              input and output
+ *
+ * Return:
+ *      the new guest, or NULL (after printing why) if any of its files
+ *      couldn't be opened
+ *
+ * Expects:
+ *      - spec is not NULL
+ *
+ * Notes:
+ *      - The input is opened nonblocking so reading it never holds up
+ *        the other guests
+ *
+ ************************/
+static Guest *newGuest(char *spec)
+{
+        assert(spec != NULL);
+        char *program = strdup(spec);
+        assert(program != NULL);
+        char *inPath = strchr(program, ':');
+        char *outPath = NULL;
+        if (inPath != NULL) {
+                *inPath++ = '\0';
+                outPath = strchr(inPath, ':');
+                if (outPath != NULL) {
+                        *outPath++ = '\0';
+                }
+        }
+
+        struct stat sb;
+        FILE *f = fopen(program, "r");
+        if (f == NULL || stat(program, &sb) == -1) {
+                fprintf(stderr, "Could not open file %s.\n", program);
+                return NULL;
+        }
+        SegmentData *sd = newMachine(f, sb);
+        fclose(f);
+
+        sd->inFd = open(inPath != NULL && *inPath != '\0' ? inPath
+                                                          : "/dev/null",
+                        O_RDONLY | O_NONBLOCK);
+        if (sd->inFd == -1) {
+                fprintf(stderr, "Could not open input %s.\n", inPath);
+                return NULL;
+        }
+        if (outPath != NULL && *outPath != '\0') {
+                sd->out = fopen(outPath, "w");
+                if (sd->out == NULL) {
+                        fprintf(stderr, "Could not open output %s.\n",
+                                outPath);
+                        return NULL;
+                }
+        }
+
+        Guest *g = calloc(1, sizeof(*g));
+        assert(g != NULL);
+        g->program = program;
+        g->sd = sd;
+        return g;
+}
+
+/********** freeGuest ********
+ *
+ * Closes a guest's input and output and frees its machine
+ *
+ * Parameters:
+ *      Guest *g:               the guest to free
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - g was set up by newGuest
+ *
+ * Notes:
+ *      - Doesn't free g itself, which lives in the array of guests
+ *
+ ************************/
+static void freeGuest(Guest *g)
+{
+        assert(g != NULL);
+        close(g->sd->inFd);
+        if (g->sd->out != stdout) {
+                fclose(g->sd->out);
+        }
+        freeData(g->sd);
+        free(g->waits);
+        free(g->program);
+}
+
+/********** schedule ********
+ *
+ * Runs every guest until it halts or fails
+ *
+ * Parameters:
+ *      Guest *guests:          array of the guests to run
+ *      int numGuests:          the number of guests
+ *      unsigned quantum:       how many instructions a guest runs before
+ *                              the next guest gets a turn
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - Every guest was set up by newGuest
+ *
+ * Notes:
+ *      - Runnable guests wait in a queue and go to the back of it after
+ *        their quantum, so each gets the same number of turns
+ *      - Parked guests are only checked between quanta, without waiting;
+ *        once nothing is runnable we wait in epoll_wait until a parked
+ *        guest's input comes in
+ *
+ ************************/
+static void schedule(Guest *guests, int numGuests, unsigned quantum)
+{
+        int epfd = epoll_create1(0);
+        assert(epfd != -1);
+        Seq_T runQueue = Seq_new(numGuests);
+        double start = now();
+        for (int i = 0; i < numGuests; i++) {
+                guests[i].readySince = start;
+                Seq_addhi(runQueue, &guests[i]);
+        }
+
+        int live = numGuests;
+        struct epoll_event events[MAX_EVENTS];
+        while (live > 0) {
+                int timeout = Seq_length(runQueue) > 0 ? 0 : -1;
+                int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+                if (n == -1 && errno != EINTR) {
+                        perror("epoll_wait");
+                        exit(EXIT_FAILURE);
+                }
+
+                /* unpark every guest whose input came in */
+                for (int i = 0; i < n; i++) {
+                        Guest *g = (Guest *)events[i].data.ptr;
+                        fillInput(g->sd);
+                        if (inputReady(g->sd)) {
+                                epoll_ctl(epfd, EPOLL_CTL_DEL, g->sd->inFd,
+                                          NULL);
+                                g->readySince = now();
+                                Seq_addhi(runQueue, g);
+                        }
+                }
+                if (Seq_length(runQueue) == 0) {
+                        continue;
+                }
+
+                Guest *g = (Guest *)Seq_remlo(runQueue);
+                double began = now();
+                recordWait(g, began - g->readySince);
+                Um_status status = runGuest(g, quantum);
+                double ended = now();
+                g->cpuSeconds += ended - began;
+                fflush(g->sd->out);
+
+                switch (status) {
+                        case UM_RUNNING:
+                                g->readySince = ended;
+                                Seq_addhi(runQueue, g);
+                                break;
+                        case UM_BLOCKED:
+                                parkGuest(g, epfd, runQueue);
+                                break;
+                        case UM_HALTED:
+                                live--;
+                                break;
+                }
+        }
+
+        Seq_free(&runQueue);
+        close(epfd);
+}
+
+/********** runGuest ********
+ *
+ * Runs one quantum of a guest's instructions
+ *
+ * Parameters:
+ *      Guest *g:               the guest to run
+ *      unsigned quantum:       the most instructions to run
+ *
+ * Return:
+ *      the status commandLoop stopped with, or UM_HALTED if the guest
+ *      failed
+ *
+ * Expects:
+ *      - g is not NULL
+ *
+ * Notes:
+ *      - A guest's exceptions (bad instruction, bad segment, failed
+ *        assertion) are caught here, so the guest is stopped and
+ *        marked as failed but the others keep running
+ *      - Prints the failed guest's trace to stderr
+ *
+ ************************/
+static Um_status runGuest(Guest *g, unsigned quantum)
+{
+        assert(g != NULL);
+        volatile Um_status status = UM_HALTED;
+        TRY
+                status = commandLoop(g->sd, quantum);
+        ELSE
+                fprintf(stderr, "umsched: %s failed at word %d\n",
+                        g->program, g->sd->currWord);
+                traceDump(&g->sd->trace, STDERR_FILENO);
+                g->failed = 1;
+                status = UM_HALTED;
+        END_TRY;
+        return status;
+}
+
+/********** parkGuest ********
+ *
+ * Sets aside a guest that is waiting on input until the input comes in
+ *
+ * Parameters:
+ *      Guest *g:               the guest that stopped at an IN
+ *      int epfd:               the epoll instance parked guests wait on
+ *      Seq_T runQueue:         the queue of runnable guests
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - The guest's input buffer is empty and its input isn't closed
+ *
+ * Notes:
+ *      - epoll can't watch regular files (or /dev/null), but those never
+ *        make us wait, so they are just read and the guest goes straight
+ *        back in the run queue
+ *      - A FIFO is only read once epoll says it's ready, since reading a
+ *        FIFO before anyone has opened it to write gives end of file
+ *
+ ************************/
+static void parkGuest(Guest *g, int epfd, Seq_T runQueue)
+{
+        assert(g != NULL);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = g;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, g->sd->inFd, &ev) == 0) {
+                return;
+        }
+        assert(errno == EPERM);
+
+        fillInput(g->sd);
+        g->readySince = now();
+        Seq_addhi(runQueue, g);
+}
+
+/********** fillInput ********
+ *
+ * Reads whatever input is waiting for a machine into its input buffer
+ *
+ * Parameters:
+ *      SegmentData *sd:        pointer to struct containing all relevant
+ *                              structures, counters, and register values
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - sd->inFd is open and nonblocking
+ *
+ * Notes:
+ *      - Marks the input closed on end of file or a read error
+ *      - Does nothing if the buffer still has bytes the machine hasn't
+ *        read
+ *
+ ************************/
+static void fillInput(SegmentData *sd)
+{
+        assert(sd != NULL);
+        if (sd->inStart < sd->inEnd || sd->inClosed) {
+                return;
+        }
+        sd->inStart = 0;
+        sd->inEnd = 0;
+
+        ssize_t n = read(sd->inFd, sd->inBuffer, INPUT_BUFFER_SIZE);
+        if (n > 0) {
+                sd->inEnd = n;
+        } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                sd->inClosed = 1;
+        }
+}
+
+/********** recordWait ********
+ *
+ * Keeps track of how long a guest waited for its turn
+ *
+ * Parameters:
+ *      Guest *g:               the guest about to run
+ *      double wait:            seconds since it became runnable
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - g is not NULL
+ *
+ * Notes:
+ *      - Doubles the size of the array of waits when it fills up
+ *
+ ************************/
+static void recordWait(Guest *g, double wait)
+{
+        assert(g != NULL);
+        if (g->numWaits == g->waitsSize) {
+                g->waitsSize = g->waitsSize == 0 ? 64 : g->waitsSize * 2;
+                g->waits = realloc(g->waits,
+                                   g->waitsSize * sizeof(*g->waits));
+                assert(g->waits != NULL);
+        }
+        g->waits[g->numWaits++] = (float)wait;
+}
+
+static int compareWaits(const void *a, const void *b)
+{
+        float x = *(const float *)a;
+        float y = *(const float *)b;
+        return (x > y) - (x < y);
+}
+
+/********** report ********
+ *
+ * Prints each guest's share of the CPU and how long it waited to run
+ *
+ * Parameters:
+ *      Guest *guests:          array of the guests that were run
+ *      int numGuests:          the number of guests
+ *
+ * Return:
+ *      void
+ *
+ * Expects:
+ *      - schedule has run every guest to completion
+ *
+ * Notes:
+ *      - Writes to stderr, so it doesn't mix with guests writing to
+ *        stdout
+ *      - Waits are given as the median, 99th percentile and max, in
+ *        milliseconds
+ *
+ ************************/
+static void report(Guest *guests, int numGuests)
+{
+        double total = 0;
+        for (int i = 0; i < numGuests; i++) {
+                total += guests[i].cpuSeconds;
+        }
+
+        fprintf(stderr, "%-5s %-24s %9s %7s %8s %9s %9s %9s\n", "guest",
+                "program", "cpu (s)", "share", "turns", "p50 (ms)",
+                "p99 (ms)", "max (ms)");
+        for (int i = 0; i < numGuests; i++) {
+                Guest *g = &guests[i];
+                double p50 = 0, p99 = 0, max = 0;
+                if (g->numWaits > 0) {
+                        qsort(g->waits, g->numWaits, sizeof(*g->waits),
+                              compareWaits);
+                        p50 = g->waits[(g->numWaits - 1) / 2];
+                        p99 = g->waits[(g->numWaits - 1) * 99 / 100];
+                        max = g->waits[g->numWaits - 1];
+                }
+                fprintf(stderr, "%-5d %-24s %9.3f %6.1f%% %8zu %9.3f "
+                        "%9.3f %9.3f%s\n", i, g->program, g->cpuSeconds,
+                        total > 0 ? 100 * g->cpuSeconds / total : 0,
+                        g->numWaits, 1000 * p50, 1000 * p99, 1000 * max,
+                        g->failed ? "  (failed)" : "");
+        }
+}
+
+static double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,166 @@
+/****************************************************************************
+ *             umstream.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file implements the UM instruction stream interface. Instructions
+ * are kept in one array that doubles in size when it fills up, so appending
+ * is cheap and big tests don't need a boxed pointer per instruction.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include "assert.h"
+#include "umstream.h"
+
+struct Um_stream {
+        unsigned length;
+        unsigned capacity;
+        Um_instruction *words;
+};
+
+/********** Um_stream_new ********
+ *
+ * Creates a new, empty instruction stream
+ *
+ * Parameters:
+ *      unsigned hint:          how many instructions the stream is expected
+ *                              to hold (0 if unknown)
+ *
+ * Return:
+ *      the new stream
+ *
+ * Expects:
+ *
+ * Notes: 
+ *      - Allocates memory that is freed by Um_stream_free
+ *      
+ ************************/
+Um_stream Um_stream_new(unsigned hint)
+{
+        Um_stream stream = malloc(sizeof(*stream));
+        assert(stream != NULL);
+
+        stream->length = 0;
+        stream->capacity = (hint > 0) ? hint : 64;
+        stream->words = malloc(stream->capacity * sizeof(Um_instruction));
+        assert(stream->words != NULL);
+
+        return stream;
+}
+
+/********** Um_stream_free ********
+ *
+ * Frees a stream and all of its instructions
+ *
+ * Parameters:
+ *      Um_stream *stream:      pointer to the stream to free
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - stream and *stream are not NULL
+ *
+ * Notes: 
+ *      - Sets *stream to NULL
+ *      
+ ************************/
+void Um_stream_free(Um_stream *stream)
+{
+        assert(stream != NULL && *stream != NULL);
+        free((*stream)->words);
+        free(*stream);
+        *stream = NULL;
+}
+
+/********** Um_stream_append ********
+ *
+ * Adds an instruction to the end of a stream
+ *
+ * Parameters:
+ *      Um_stream stream:       the stream to add to
+ *      Um_instruction inst:    the instruction to add
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - stream is not NULL
+ *
+ * Notes: 
+ *      - Doubles the capacity of the stream when it is full
+ *      
+ ************************/
+void Um_stream_append(Um_stream stream, Um_instruction inst)
+{
+        assert(stream != NULL);
+        if (stream->length == stream->capacity) {
+                stream->capacity *= 2;
+                stream->words = realloc(stream->words, stream->capacity *
+                                        sizeof(Um_instruction));
+                assert(stream->words != NULL);
+        }
+        stream->words[stream->length++] = inst;
+}
+
+/********** Um_stream_length ********
+ *
+ * Returns the number of instructions in a stream
+ *
+ * Parameters:
+ *      Um_stream stream:       the stream
+ *
+ * Return:
+ *      the number of instructions in the stream
+ *
+ * Expects:
+ *      - stream is not NULL
+ *
+ * Notes: 
+ *      
+ ************************/
+unsigned Um_stream_length(Um_stream stream)
+{
+        assert(stream != NULL);
+        return stream->length;
+}
+
+/********** Um_stream_write ********
+ *
+ * Writes every instruction in a stream to a file in big-endian order
+ *
+ * Parameters:
+ *      FILE *output:           file to write to (already opened)
+ *      Um_stream stream:       the stream to write out
+ *
+ * Return:
+ *      void function
+ *
+ * Expects:
+ *      - output and stream are not NULL
+ *
+ * Notes: 
+ *      - Converts the words to big-endian in place and writes them with
+ *        a single fwrite, so the stream is empty afterwards (like draining
+ *        a sequence)
+ *      
+ ************************/
+void Um_stream_write(FILE *output, Um_stream stream)
+{
+        assert(output != NULL && stream != NULL);
+        for (unsigned i = 0; i < stream->length; i++) {
+                stream->words[i] = htonl(stream->words[i]);
+        }
+
+        size_t written = fwrite(stream->words, sizeof(Um_instruction),
+                                stream->length, output);
+        assert(written == stream->length);
+
+        stream->length = 0;
+}
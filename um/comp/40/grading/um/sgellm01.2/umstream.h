@@ -0,0 +1,30 @@
+/****************************************************************************
+ *             umstream.h
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file defines the interface for a UM instruction stream, which the
+ * unit tests are written into. A stream is a growable, contiguous array of
+ * 32-bit instruction words that can be written out as a .um file with a
+ * single fwrite.
+****************************************************************************/
+
+#ifndef UMSTREAM_INCLUDED
+#define UMSTREAM_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef uint32_t Um_instruction;
+typedef struct Um_stream *Um_stream;
+
+Um_stream Um_stream_new(unsigned hint);
+void Um_stream_free(Um_stream *stream);
+void Um_stream_append(Um_stream stream, Um_instruction inst);
+unsigned Um_stream_length(Um_stream stream);
+void Um_stream_write(FILE *output, Um_stream stream);
+
+#endif
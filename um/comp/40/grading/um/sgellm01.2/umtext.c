@@ -0,0 +1,98 @@
+/****************************************************************************
+ *             umtext.c
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file implements putInstruction, which writes one instruction the
+ * way it appears in the .dump listings; the rest of the umtext helpers are
+ * inline in umtext.h.
+****************************************************************************/
+
+#include <stdint.h>
+#include "instructions.h"
+#include "umtext.h"
+
+/********** putInstruction ********
+ *
+ * Writes the text for one instruction, as it appears in the .dump listings
+ *
+ * Parameters:
+ *      char *p:                where to write the text
+ *      uint32_t inst:          the instruction word
+ *
+ * Return:
+ *      the end of the text written
+ *
+ * Expects:
+ *      - There's room for INSTRUCTION_ROOM chars at p
+ *
+ * Notes:
+ *      - Doesn't write a '\0'
+ *      - Words with opcodes 14 and 15 are shown as data
+ *
+ ************************/
+char *putInstruction(char *p, uint32_t inst)
+{
+        unsigned op = inst >> 28;
+        unsigned a = (inst >> 6) & 0x7;
+        unsigned b = (inst >> 3) & 0x7;
+        unsigned c = inst & 0x7;
+        static const char *const ops[] = {
+                [ADD] = " + ", [MUL] = " * ", [DIV] = " / ",
+                [NAND] = " nand "
+        };
+
+        switch (op) {
+                case CMOV:
+                        p = putRegister(putString(p, "if ("), c);
+                        p = putRegister(putString(p, " != 0) "), a);
+                        p = putRegister(putString(p, " := "), b);
+                        return putString(p, ";");
+                case SLOAD:
+                        p = putRegister(p, a);
+                        p = putRegister(putString(p, " := m["), b);
+                        p = putRegister(putString(p, "]["), c);
+                        return putString(p, "];");
+                case SSTORE:
+                        p = putRegister(putString(p, "m["), a);
+                        p = putRegister(putString(p, "]["), b);
+                        p = putRegister(putString(p, "] := "), c);
+                        return putString(p, ";");
+                case ADD: case MUL: case DIV: case NAND:
+                        p = putRegister(p, a);
+                        p = putRegister(putString(p, " := "), b);
+                        p = putRegister(putString(p, ops[op]), c);
+                        return putString(p, ";");
+                case HALT:
+                        return putString(p, "halt;");
+                case ACTIVATE:
+                        p = putRegister(p, b);
+                        p = putRegister(putString(p, " := map segment ("),
+                                        c);
+                        return putString(p, " words);");
+                case INACTIVATE:
+                        p = putRegister(putString(p, "unmap m["), c);
+                        return putString(p, "];");
+                case OUT:
+                        p = putRegister(putString(p, "output "), c);
+                        return putString(p, ";");
+                case IN:
+                        p = putRegister(p, c);
+                        return putString(p, " := input();");
+                case LOADP:
+                        p = putRegister(putString(p, "goto "), c);
+                        p = putRegister(putString(p, " in program m["), b);
+                        return putString(p, "];");
+                case LV:
+                        p = putRegister(p, (inst >> 25) & 0x7);
+                        p = putUnsigned(putString(p, " := "),
+                                        inst & 0x1ffffff);
+                        return putString(p, ";");
+                default:
+                        p = putHex(putString(p, ".data 0x"), inst);
+                        return putString(p, ";");
+        }
+}
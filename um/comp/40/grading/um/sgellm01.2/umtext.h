@@ -0,0 +1,76 @@
+/****************************************************************************
+ *             umtext.h
+ *
+ * Assignment: um
+ * Authors: Jack Adkins, Seth Gellman
+ * Date: 11/17/24
+ *
+ * Summary:
+ * This file defines the helpers that write UM text (strings, numbers,
+ * registers and whole instructions) straight into a buffer instead of
+ * going through printf. Each one writes at p and returns the end of what
+ * it wrote, so calls nest, and none of them writes a '\0'. They only touch
+ * the buffer, so they're safe to call from a signal handler. The small
+ * ones are inline here since umdis calls them for every word; the trace,
+ * umdis and the profiling um's fault report all share them.
+****************************************************************************/
+
+#ifndef UMTEXT_INCLUDED
+#define UMTEXT_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+
+#define INSTRUCTION_ROOM 48     /* enough for any one instruction */
+
+static inline char *putString(char *p, const char *s)
+{
+        size_t n = strlen(s);
+        memcpy(p, s, n);
+        return p + n;
+}
+
+static inline char *putUnsigned(char *p, uint64_t n)
+{
+        char digits[20];
+        int count = 0;
+        do {
+                digits[count++] = '0' + n % 10;
+                n /= 10;
+        } while (n != 0);
+        while (count > 0) {
+                *p++ = digits[--count];
+        }
+        return p;
+}
+
+#define HEX_ROW(d) d "0" d "1" d "2" d "3" d "4" d "5" d "6" d "7" \
+                   d "8" d "9" d "a" d "b" d "c" d "d" d "e" d "f"
+
+/* the two hex digits of each byte, one pair after another */
+static const char hexPairs[] =
+        HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+        HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+        HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b")
+        HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+
+/* n as 8 hex digits, like "%08x" */
+static inline char *putHex(char *p, uint32_t n)
+{
+        for (int shift = 24; shift >= 0; shift -= 8) {
+                memcpy(p, &hexPairs[2 * ((n >> shift) & 0xff)], 2);
+                p += 2;
+        }
+        return p;
+}
+
+static inline char *putRegister(char *p, unsigned r)
+{
+        *p++ = 'r';
+        *p++ = '0' + r;
+        return p;
+}
+
+char *putInstruction(char *p, uint32_t inst);
+
+#endif
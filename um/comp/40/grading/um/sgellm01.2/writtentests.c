@@ -9,17 +9,17 @@
  * Summary:
  * This file implements functions in a unit_testing framework, which is
  * defined in testing.c. A unit test is a stream of UM instructions,
- * represented as a Hanson sequence of 32-bit words adhering to the
+ * represented as a Um_stream of 32-bit words adhering to the
  * UM's instruction format. 
 ****************************************************************************/
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
-#include <seq.h>
-#include <bitpack.h>
+#include "umstream.h"
 
-typedef uint32_t Um_instruction;
 typedef enum Um_opcode {
         CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
         NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
@@ -72,7 +72,8 @@ static inline Um_instruction mult(Um_register a, Um_register b, Um_register c)
         return three_register(MUL, a, b, c);
 }
 
-static inline Um_instruction div(Um_register a, Um_register b, Um_register c) 
+static inline Um_instruction divide(Um_register a, Um_register b,
+                                    Um_register c) 
 {
         return three_register(DIV, a, b, c);
 }
@@ -104,25 +105,9 @@ Um_instruction output(Um_register c)
 
 /* Functions for working with streams */
 
-static inline void append(Seq_T stream, Um_instruction inst)
-{
-        assert(sizeof(inst) <= sizeof(uintptr_t));
-        Seq_addhi(stream, (void *)(uintptr_t)inst);
-}
-
-const uint32_t Um_word_width = 32;
-
-void Um_write_sequence(FILE *output, Seq_T stream)
+static inline void append(Um_stream stream, Um_instruction inst)
 {
-        assert(output != NULL && stream != NULL);
-        int stream_length = Seq_length(stream);
-        for (int i = 0; i < stream_length; i++) {
-                Um_instruction inst = (uintptr_t)Seq_remlo(stream);
-                for (int lsb = Um_word_width - 8; lsb >= 0; lsb -= 8) {
-                        fputc(Bitpack_getu(inst, 8, lsb), output);
-                }
-        }
-      
+        Um_stream_append(stream, inst);
 }
 
 Um_instruction three_register(Um_opcode op, int ra, int rb, int rc)
@@ -156,12 +141,12 @@ Um_instruction loadval(unsigned ra, unsigned val)
 
 /* Unit tests for the UM */
 
-void build_halt_test(Seq_T stream)
+void build_halt_test(Um_stream stream)
 {
         append(stream, halt());
 }
 
-void build_verbose_halt_test(Seq_T stream)
+void build_verbose_halt_test(Um_stream stream)
 {
         append(stream, halt());
         append(stream, loadval(r1, 'B'));
@@ -176,7 +161,7 @@ void build_verbose_halt_test(Seq_T stream)
         append(stream, output(r1));
 }
 
-void build_output_test(Seq_T stream)
+void build_output_test(Um_stream stream)
 {
         append(stream, loadval(r3, 'g'));
         append(stream, output(r3));
@@ -184,7 +169,7 @@ void build_output_test(Seq_T stream)
 }
 
 /*ARITHMETIC TESTS*/
-extern void build_add_test(Seq_T stream)
+extern void build_add_test(Um_stream stream)
 {
         append(stream, loadval(r1, 25));
         append(stream, loadval(r3, 29));
@@ -193,7 +178,7 @@ extern void build_add_test(Seq_T stream)
         append(stream, halt());
 }
 
-extern void build_mult_test(Seq_T stream)
+extern void build_mult_test(Um_stream stream)
 {
         append(stream, loadval(r0, 5));
         append(stream, loadval(r1, 9));
@@ -202,26 +187,26 @@ extern void build_mult_test(Seq_T stream)
         append(stream, halt());
 }
 
-extern void build_div_test(Seq_T stream)
+extern void build_div_test(Um_stream stream)
 {
         append(stream, loadval(r0, 800));
         append(stream, loadval(r1, 20));
-        append(stream, div(r2, r0, r1));
+        append(stream, divide(r2, r0, r1));
         append(stream, output(r2));
         append(stream, halt());
 }
 
-extern void build_multdiv_test(Seq_T stream)
+extern void build_multdiv_test(Um_stream stream)
 {
         append(stream, loadval(r0, 45));
         append(stream, loadval(r1, 72));
         append(stream, mult(r2, r0, r1));
-        append(stream, div(r3, r2, r0));
+        append(stream, divide(r3, r2, r0));
         append(stream, output(r3));
         append(stream, halt());
 }
 
-extern void build_allmath_test(Seq_T stream)
+extern void build_allmath_test(Um_stream stream)
 {
         append(stream, loadval(r0, 20));
         append(stream, loadval(r1, 10));
@@ -230,26 +215,26 @@ extern void build_allmath_test(Seq_T stream)
         append(stream, mult(r4, r1, r3));
         append(stream, add(r5, r4, r2));
         append(stream, add(r6, r5, r2));
-        append(stream, div(r7, r6, r2));
+        append(stream, divide(r7, r6, r2));
         append(stream, output(r7));
         append(stream, halt());
 }
 
 /*BNAND TESTS*/
-extern void build_bnand_test(Seq_T stream)
+extern void build_bnand_test(Um_stream stream)
 {
         append(stream, loadval(r0, 33554431));
         append(stream, loadval(r1, 33554430));
         append(stream, nand(r2, r0, r1));
         append(stream, loadval(r3, 17980645));
-        append(stream, div(r4, r2, r3));
+        append(stream, divide(r4, r2, r3));
         append(stream, loadval(r5, 3));
-        append(stream, div(r6, r4, r5));
+        append(stream, divide(r6, r4, r5));
         append(stream, output(r6));
         append(stream, halt());
 }
 
-extern void build_double_bnand_test(Seq_T stream)
+extern void build_double_bnand_test(Um_stream stream)
 {
         append(stream, loadval(r0, 127));
         append(stream, loadval(r1, 97));
@@ -260,20 +245,20 @@ extern void build_double_bnand_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_map_test(Seq_T stream)
+void build_map_test(Um_stream stream)
 {
         append(stream, map(r2, r3));
         append(stream, halt());
 }
 
-void build_unmap_test(Seq_T stream)
+void build_unmap_test(Um_stream stream)
 {
         append(stream, map(r2, r3));
         append(stream, unmap(r2));
         append(stream, halt());
 }
 
-void build_unmap_many_test(Seq_T stream)
+void build_unmap_many_test(Um_stream stream)
 {
         append(stream, map(r4, r5));
         for (int i = 0; i < 5000; i++) {
@@ -285,14 +270,14 @@ void build_unmap_many_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_io_test(Seq_T stream)
+void build_io_test(Um_stream stream)
 {
         append(stream, input(r3));
         append(stream, output(r3));
         append(stream, halt());
 }
 
-void build_io_eof_test(Seq_T stream)
+void build_io_eof_test(Um_stream stream)
 {
         append(stream, input(r3));
         append(stream, output(r3));
@@ -305,7 +290,7 @@ void build_io_eof_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_cmov_execute_test(Seq_T stream)
+void build_cmov_execute_test(Um_stream stream)
 {
         append(stream, loadval(r1, 58));
         append(stream, loadval(r2, 33));
@@ -315,7 +300,7 @@ void build_cmov_execute_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_cmov_no_execute_test(Seq_T stream)
+void build_cmov_no_execute_test(Um_stream stream)
 {
         append(stream, loadval(r1, 58));
         append(stream, loadval(r2, 100));
@@ -324,7 +309,7 @@ void build_cmov_no_execute_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_lp_not0_test(Seq_T stream)
+void build_lp_not0_test(Um_stream stream)
 {
         append(stream, loadval(r1, 4));
         append(stream, halt());
@@ -335,7 +320,7 @@ void build_lp_not0_test(Seq_T stream)
         append(stream, lp(r0, r2)); // word 2 in index 0
 }
 
-void build_lp_0_test(Seq_T stream)
+void build_lp_0_test(Um_stream stream)
 {
         append(stream, loadval(r1, 4));
         append(stream, loadval(r5, 7));
@@ -347,7 +332,7 @@ void build_lp_0_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_segload_test(Seq_T stream)
+void build_segload_test(Um_stream stream)
 {
         append(stream, loadval(r0, 6));
         append(stream, loadval(r0, 6));
@@ -356,16 +341,16 @@ void build_segload_test(Seq_T stream)
 
         append(stream, sload(r1, r2, r0));
         append(stream, loadval(r7, 2430126));
-        append(stream, div(r1, r1, r7));
+        append(stream, divide(r1, r1, r7));
         append(stream, loadval(r7, 359));
-        append(stream, div(r1, r1, r7));
+        append(stream, divide(r1, r1, r7));
         append(stream, loadval(r7, 48));
         append(stream, add(r1, r1, r7));
         append(stream, output(r1));
         append(stream, halt());
 }
 
-void build_sstore_test(Seq_T stream)
+void build_sstore_test(Um_stream stream)
 {
         for (int i = 0; i < 12; i++) {
                 append(stream, loadval(r3, 3));
@@ -375,7 +360,7 @@ void build_sstore_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_sstore_0_test(Seq_T stream)
+void build_sstore_0_test(Um_stream stream)
 {
         for (int i = 0; i < 12; i++) {
                 append(stream, loadval(r3, 3));
@@ -385,14 +370,14 @@ void build_sstore_0_test(Seq_T stream)
         append(stream, halt());
 }
 
-void build_long_test(Seq_T stream)
+void build_long_test(Um_stream stream)
 {
         append(stream, loadval(r0, 100));
         append(stream, loadval(r1, 2));
         append(stream, add(r0, r1, r0));
         append(stream, map(r7, r0));
         append(stream, output(r0));
-        append(stream, div(r0, r0, r1));
+        append(stream, divide(r0, r0, r1));
         append(stream, output(r0));
         append(stream, mult(r0, r0, r1));
         append(stream, output(r0));
@@ -406,4 +391,533 @@ void build_long_test(Seq_T stream)
         append(stream, lp(r6, r7));
         append(stream, output(r1)); // never outputs
         append(stream, halt());
-}
\ No newline at end of file
+}
+
+void build_mil50_test(Um_stream stream)
+{
+        /* r3 = -1, r1 counts down from 10 million */
+        append(stream, nand(r3, r0, r0));
+        append(stream, loadval(r1, 10000000));
+
+        /* 5 instructions per pass, so 50 million in total */
+        append(stream, add(r1, r1, r3));
+        append(stream, loadval(r5, 2)); // start of the loop
+        append(stream, loadval(r6, 7)); // halt
+        append(stream, cmov(r6, r5, r1));
+        append(stream, lp(r0, r6));
+        append(stream, halt());
+}
+
+/*
+ * Jumps through chains of gotos and works out "job" with NAND idioms,
+ * constant arithmetic and CMOVs that never move anything, all of which
+ * umopt can simplify (r5 is never written, so it's always 0)
+ */
+void build_jump_chain_test(Um_stream stream)
+{
+        append(stream, loadval(r1, 3));
+        append(stream, lp(r0, r1)); // goto 3, which goes to 6
+        append(stream, halt()); // never runs
+        append(stream, loadval(r1, 6));
+        append(stream, lp(r0, r1));
+        append(stream, halt()); // never runs
+        append(stream, cmov(r2, r1, r5));
+        append(stream, loadval(r2, 106));
+        append(stream, nand(r3, r2, r2));
+        append(stream, nand(r4, r3, r3)); // r4 = r2
+        append(stream, output(r4));
+        append(stream, nand(r6, r0, r0)); // r6 = ~0
+        append(stream, nand(r3, r2, r6));
+        append(stream, nand(r3, r3, r3)); // r3 = r2 & ~0
+        append(stream, loadval(r7, 5));
+        append(stream, add(r3, r3, r7));
+        append(stream, output(r3));
+        append(stream, loadval(r1, 20));
+        append(stream, lp(r0, r1)); // goto 20, which goes to 24
+        append(stream, halt()); // never runs
+        append(stream, cmov(r1, r1, r6));
+        append(stream, loadval(r1, 24));
+        append(stream, lp(r0, r1));
+        append(stream, halt()); // never runs
+        append(stream, loadval(r7, 2));
+        append(stream, mult(r4, r7, r7));
+        append(stream, loadval(r2, 24));
+        append(stream, mult(r4, r4, r2));
+        append(stream, add(r4, r4, r7));
+        append(stream, output(r4));
+        append(stream, halt());
+}
+
+/*
+ * Works out "aaab" from the input "ab" with NANDs and a multiply by 1 on
+ * values umopt can't know, so instead of folding them it has to turn them
+ * into copies (an ADD of r0, which is never written) or a NOT of the
+ * register that holds what they're the NOT of
+ */
+void build_nand_simplify_test(Um_stream stream)
+{
+        append(stream, input(r1));
+        append(stream, nand(r2, r1, r1)); // r2 = ~r1
+        append(stream, nand(r3, r2, r2)); // r3 = r1, a copy
+        append(stream, output(r3));
+        append(stream, nand(r6, r0, r0)); // r6 = ~0
+        append(stream, nand(r4, r1, r6)); // r4 = ~r1
+        append(stream, nand(r4, r4, r4)); // r4 = r1, a copy
+        append(stream, output(r4));
+        append(stream, input(r2)); // nothing holds ~r1 now
+        append(stream, nand(r5, r6, r1)); // r5 = ~r1, a NOT of r1
+        append(stream, nand(r5, r5, r5)); // r5 = r1, a copy
+        append(stream, output(r5));
+        append(stream, loadval(r7, 1));
+        append(stream, mult(r3, r2, r7)); // r3 = r2, a copy
+        append(stream, output(r3));
+        append(stream, halt());
+}
+
+/* Performance workloads for benchmarking the UM
+ *
+ * Each builder takes a size and an iteration count and, along with the
+ * instructions, fills in the input it needs (test_input, or NULL) and the
+ * output it should produce (expected_output) as malloc'd strings. Apart
+ * from io-echo, a workload ends by outputting a 32-bit checksum, as 8 hex
+ * digits, that the builder works out in C.
+ */
+
+typedef enum Map_size_dist { SIZE_FIXED, SIZE_UNIFORM, SIZE_SKEWED }
+        Map_size_dist;
+
+/* the biggest value a loadval can hold */
+#define LOADVAL_MAX ((1u << 25) - 1)
+
+/* deterministic generator so a workload is the same every time */
+static uint32_t workload_rand(uint32_t *state)
+{
+        *state = *state * 1664525 + 1013904223;
+        return *state >> 8;
+}
+
+/* the 8 lowercase hex digits output_checksum prints for a value */
+static char *checksum_string(uint32_t checksum)
+{
+        char *out = malloc(9);
+        assert(out != NULL);
+        snprintf(out, 9, "%08x", (unsigned)checksum);
+        return out;
+}
+
+/*
+ * outputs r as 8 lowercase hex digits, most significant first, using t1,
+ * t2 and t3 as temporaries; each digit d is (r / 16^k) & 15, and becomes
+ * d + 48, plus 39 more when (d + 6) / 16 says it is 10 or over
+ */
+static void output_checksum(Um_stream stream, Um_register r, Um_register t1,
+                            Um_register t2, Um_register t3)
+{
+        for (int shift = 28; shift >= 0; shift -= 4) {
+                if ((1u << shift) > LOADVAL_MAX) {
+                        append(stream, loadval(t1, 1u << (shift - 4)));
+                        append(stream, loadval(t2, 16));
+                        append(stream, mult(t1, t1, t2));
+                } else {
+                        append(stream, loadval(t1, 1u << shift));
+                }
+                append(stream, divide(t2, r, t1));
+                append(stream, loadval(t1, 15));
+                append(stream, nand(t2, t2, t1));
+                append(stream, nand(t2, t2, t2));
+
+                append(stream, loadval(t1, 6));
+                append(stream, add(t1, t2, t1));
+                append(stream, loadval(t3, 16));
+                append(stream, divide(t1, t1, t3));
+                append(stream, loadval(t3, 39));
+                append(stream, mult(t1, t1, t3));
+                append(stream, add(t2, t2, t1));
+                append(stream, loadval(t1, 48));
+                append(stream, add(t2, t2, t1));
+                append(stream, output(t2));
+        }
+}
+
+/*
+ * decrements counter (minus_one must hold ~0) and jumps to loop_start in
+ * segment 0 while it is nonzero, otherwise falls through; uses t1 and t2
+ * as temporaries
+ */
+static void loop_back(Um_stream stream, Um_register counter,
+                      Um_register minus_one, unsigned loop_start,
+                      Um_register t1, Um_register t2)
+{
+        unsigned loop_exit = Um_stream_length(stream) + 5;
+        assert(loop_exit <= LOADVAL_MAX);
+
+        append(stream, add(counter, counter, minus_one));
+        append(stream, loadval(t1, loop_start));
+        append(stream, loadval(t2, loop_exit));
+        append(stream, cmov(t2, t1, counter));
+        append(stream, lp(r0, t2));
+}
+
+/*
+ * Each round maps 8 segments (sizes up to 'size', drawn from 'dist'),
+ * writes the last word of each, then reads those words back and unmaps the
+ * segments in a different order than they were mapped. The segment IDs and
+ * the running sum live in a 9 word bookkeeping segment.
+ */
+static void build_map_churn(Um_stream stream, unsigned size,
+                            unsigned iterations, Map_size_dist dist,
+                            char **test_input, char **expected_output)
+{
+        static const unsigned unmap_order[8] = { 1, 3, 5, 7, 0, 2, 4, 6 };
+        assert(size > 0 && size <= LOADVAL_MAX && iterations > 0);
+        assert(iterations <= LOADVAL_MAX);
+
+        unsigned sizes[8];
+        uint32_t seed = size;
+        for (unsigned k = 0; k < 8; k++) {
+                switch (dist) {
+                case SIZE_FIXED:
+                        sizes[k] = size;
+                        break;
+                case SIZE_UNIFORM:
+                        sizes[k] = workload_rand(&seed) % size + 1;
+                        break;
+                case SIZE_SKEWED:
+                        /* mostly tiny segments with one big one */
+                        sizes[k] = (k == 5) ? size : workload_rand(&seed) %
+                                   (size < 16 ? size : 16) + 1;
+                        break;
+                }
+        }
+
+        append(stream, nand(r6, r0, r0));
+        append(stream, loadval(r1, 9));
+        append(stream, map(r7, r1));
+        append(stream, loadval(r5, iterations));
+
+        unsigned round = Um_stream_length(stream);
+        for (unsigned k = 0; k < 8; k++) {
+                append(stream, loadval(r1, sizes[k]));
+                append(stream, map(r2, r1));
+                append(stream, loadval(r3, k));
+                append(stream, sstore(r7, r3, r2));
+                append(stream, loadval(r4, sizes[k] - 1));
+                append(stream, sstore(r2, r4, r3));
+        }
+        for (unsigned n = 0; n < 8; n++) {
+                unsigned k = unmap_order[n];
+                append(stream, loadval(r3, k));
+                append(stream, sload(r2, r7, r3));
+                append(stream, loadval(r4, sizes[k] - 1));
+                append(stream, sload(r1, r2, r4));
+                append(stream, loadval(r4, 8));
+                append(stream, sload(r3, r7, r4));
+                append(stream, add(r3, r3, r1));
+                append(stream, sstore(r7, r4, r3));
+                append(stream, unmap(r2));
+        }
+        loop_back(stream, r5, r6, round, r1, r2);
+
+        append(stream, loadval(r4, 8));
+        append(stream, sload(r3, r7, r4));
+        output_checksum(stream, r3, r1, r2, r4);
+        append(stream, halt());
+
+        /* every round adds 0 + 1 + ... + 7 */
+        *test_input = NULL;
+        *expected_output = checksum_string(iterations * 28);
+}
+
+void build_map_churn_fixed(Um_stream stream, unsigned size,
+                           unsigned iterations, char **test_input,
+                           char **expected_output)
+{
+        build_map_churn(stream, size, iterations, SIZE_FIXED, test_input,
+                        expected_output);
+}
+
+void build_map_churn_uniform(Um_stream stream, unsigned size,
+                             unsigned iterations, char **test_input,
+                             char **expected_output)
+{
+        build_map_churn(stream, size, iterations, SIZE_UNIFORM, test_input,
+                        expected_output);
+}
+
+void build_map_churn_skewed(Um_stream stream, unsigned size,
+                            unsigned iterations, char **test_input,
+                            char **expected_output)
+{
+        build_map_churn(stream, size, iterations, SIZE_SKEWED, test_input,
+                        expected_output);
+}
+
+/*
+ * Dispatches 'iterations' times through a jump table of 'size' handlers
+ * stored after the code in segment 0. Each handler adds to a running sum
+ * and picks the next handler, following one random cycle through all of
+ * them, then jumps back to the loop.
+ */
+void build_loadp_dispatch(Um_stream stream, unsigned size,
+                          unsigned iterations, char **test_input,
+                          char **expected_output)
+{
+        enum { HEAD = 4, TAIL = 8, HANDLERS = 136, HANDLER_LEN = 5 };
+        unsigned table = HANDLERS + size * HANDLER_LEN;
+        assert(size > 0 && table + size <= LOADVAL_MAX);
+        assert(iterations > 0 && iterations <= LOADVAL_MAX);
+
+        /* Sattolo's shuffle gives a single cycle through every handler */
+        unsigned *next = malloc(size * sizeof(unsigned));
+        assert(next != NULL);
+        for (unsigned k = 0; k < size; k++) {
+                next[k] = k;
+        }
+        uint32_t seed = size;
+        for (unsigned k = size - 1; k > 0; k--) {
+                unsigned other = workload_rand(&seed) % k;
+                unsigned tmp = next[k];
+                next[k] = next[other];
+                next[other] = tmp;
+        }
+
+        append(stream, nand(r6, r0, r0));
+        append(stream, loadval(r5, iterations));
+        append(stream, loadval(r4, 0));
+        append(stream, loadval(r3, 0));
+
+        assert(Um_stream_length(stream) == HEAD);
+        append(stream, loadval(r1, table));
+        append(stream, add(r1, r1, r3));
+        append(stream, sload(r2, r0, r1));
+        append(stream, lp(r0, r2));
+
+        assert(Um_stream_length(stream) == TAIL);
+        loop_back(stream, r5, r6, HEAD, r1, r2);
+        output_checksum(stream, r4, r1, r2, r3);
+        append(stream, halt());
+
+        assert(Um_stream_length(stream) == HANDLERS);
+        for (unsigned k = 0; k < size; k++) {
+                append(stream, loadval(r1, k + 1));
+                append(stream, add(r4, r4, r1));
+                append(stream, loadval(r3, next[k]));
+                append(stream, loadval(r2, TAIL));
+                append(stream, lp(r0, r2));
+        }
+
+        assert(Um_stream_length(stream) == table);
+        for (unsigned k = 0; k < size; k++) {
+                append(stream, HANDLERS + k * HANDLER_LEN);
+        }
+
+        uint32_t sum = 0;
+        unsigned k = 0;
+        for (unsigned i = 0; i < iterations; i++) {
+                sum += k + 1;
+                k = next[k];
+        }
+        free(next);
+
+        *test_input = NULL;
+        *expected_output = checksum_string(sum);
+}
+
+/*
+ * Maps a 'size' word segment and makes 'iterations' passes over it; each
+ * access does seg[i] += i + 1. The strided version visits every stride'th
+ * word in order, the random one makes 'size' accesses per pass at indexes
+ * from an LCG (so size is rounded down to a power of 2 for the mask).
+ * The checksum is the sum of every word in the segment.
+ */
+static void build_segment_access(Um_stream stream, unsigned size,
+                                 unsigned iterations, unsigned stride,
+                                 char **test_input, char **expected_output)
+{
+        static const uint32_t lcg_mult = 1664525;
+        static const uint32_t lcg_add = 12345;
+        assert(size > 0 && size <= LOADVAL_MAX);
+        assert(iterations > 0 && iterations <= LOADVAL_MAX);
+
+        unsigned accesses = size;
+        if (stride > 0) {
+                accesses = (size + stride - 1) / stride;
+        } else {
+                while ((size & (size - 1)) != 0) {
+                        size &= size - 1;
+                }
+        }
+
+        append(stream, nand(r6, r0, r0));
+        append(stream, loadval(r1, size));
+        append(stream, map(r7, r1));
+        append(stream, loadval(r5, iterations));
+        append(stream, loadval(r3, 0));
+
+        unsigned pass = Um_stream_length(stream);
+        append(stream, loadval(r4, accesses));
+        if (stride > 0) {
+                append(stream, loadval(r3, 0));
+        }
+
+        unsigned access = Um_stream_length(stream);
+        if (stride == 0) {
+                append(stream, loadval(r1, lcg_mult));
+                append(stream, mult(r2, r3, r1));
+                append(stream, loadval(r1, lcg_add));
+                append(stream, add(r2, r2, r1));
+                append(stream, loadval(r1, size - 1));
+                append(stream, nand(r3, r2, r1));
+                append(stream, nand(r3, r3, r3));
+        }
+        append(stream, sload(r1, r7, r3));
+        append(stream, add(r1, r1, r3));
+        append(stream, loadval(r2, 1));
+        append(stream, add(r1, r1, r2));
+        append(stream, sstore(r7, r3, r1));
+        if (stride > 0) {
+                append(stream, loadval(r2, stride));
+                append(stream, add(r3, r3, r2));
+        }
+        loop_back(stream, r4, r6, access, r1, r2);
+        loop_back(stream, r5, r6, pass, r1, r2);
+
+        /* sum every word, from the last down to seg[0] */
+        append(stream, loadval(r4, size));
+        append(stream, loadval(r5, 0));
+        unsigned sum = Um_stream_length(stream);
+        append(stream, add(r2, r4, r6));
+        append(stream, sload(r1, r7, r2));
+        append(stream, add(r5, r5, r1));
+        loop_back(stream, r4, r6, sum, r1, r2);
+        output_checksum(stream, r5, r1, r2, r3);
+        append(stream, halt());
+
+        uint32_t *seg = calloc(size, sizeof(uint32_t));
+        assert(seg != NULL);
+        uint32_t i = 0;
+        for (unsigned p = 0; p < iterations; p++) {
+                if (stride > 0) {
+                        i = 0;
+                }
+                for (unsigned n = 0; n < accesses; n++) {
+                        if (stride == 0) {
+                                i = (i * lcg_mult + lcg_add) & (size - 1);
+                        }
+                        seg[i] += i + 1;
+                        if (stride > 0 && n + 1 < accesses) {
+                                i += stride;
+                        }
+                }
+        }
+        uint32_t checksum = 0;
+        for (unsigned k = 0; k < size; k++) {
+                checksum += seg[k];
+        }
+        free(seg);
+
+        *test_input = NULL;
+        *expected_output = checksum_string(checksum);
+}
+
+void build_segment_strided(Um_stream stream, unsigned size,
+                           unsigned iterations, char **test_input,
+                           char **expected_output)
+{
+        build_segment_access(stream, size, iterations, 16, test_input,
+                             expected_output);
+}
+
+void build_segment_random(Um_stream stream, unsigned size,
+                          unsigned iterations, char **test_input,
+                          char **expected_output)
+{
+        build_segment_access(stream, size, iterations, 0, test_input,
+                             expected_output);
+}
+
+/*
+ * Runs 'iterations' passes of a loop whose body is 'size' copies of a
+ * multiply/add/divide/nand chain on one value
+ */
+void build_arith_loop(Um_stream stream, unsigned size, unsigned iterations,
+                      char **test_input, char **expected_output)
+{
+        assert(size > 0 && iterations > 0 && iterations <= LOADVAL_MAX);
+
+        append(stream, nand(r6, r0, r0));
+        append(stream, loadval(r5, iterations));
+        append(stream, loadval(r1, 1));
+        append(stream, loadval(r2, 1664525));
+        append(stream, loadval(r3, 12345));
+
+        unsigned body = Um_stream_length(stream);
+        append(stream, loadval(r7, 7));
+        for (unsigned n = 0; n < size; n++) {
+                append(stream, mult(r1, r1, r2));
+                append(stream, add(r1, r1, r3));
+                append(stream, divide(r4, r1, r7));
+                append(stream, nand(r1, r1, r4));
+                append(stream, add(r1, r1, r4));
+        }
+        /* r4 and r7 are both set again before they're used in the body */
+        loop_back(stream, r5, r6, body, r4, r7);
+        output_checksum(stream, r1, r2, r3, r4);
+        append(stream, halt());
+
+        uint32_t x = 1;
+        for (unsigned p = 0; p < iterations; p++) {
+                for (unsigned n = 0; n < size; n++) {
+                        x = x * 1664525 + 12345;
+                        uint32_t q = x / 7;
+                        x = ~(x & q) + q;
+                }
+        }
+
+        *test_input = NULL;
+        *expected_output = checksum_string(x);
+}
+
+/*
+ * Echoes its input back a byte at a time until EOF. The input is 'size'
+ * bytes of text; iterations is unused.
+ */
+void build_io_echo(Um_stream stream, unsigned size, unsigned iterations,
+                   char **test_input, char **expected_output)
+{
+        enum { HEAD = 1, BODY = 7, EXIT = 10 };
+        static const char line[] = "the quick brown fox jumps over the lazy "
+                                   "dog 0123456789\n";
+        (void) iterations;
+        assert(size > 0);
+
+        append(stream, loadval(r6, 1));
+
+        assert(Um_stream_length(stream) == HEAD);
+        append(stream, input(r1));
+        append(stream, add(r2, r1, r6)); /* 0 only at EOF */
+        append(stream, loadval(r3, BODY));
+        append(stream, loadval(r4, EXIT));
+        append(stream, cmov(r4, r3, r2));
+        append(stream, lp(r0, r4));
+
+        assert(Um_stream_length(stream) == BODY);
+        append(stream, output(r1));
+        append(stream, loadval(r4, HEAD));
+        append(stream, lp(r0, r4));
+
+        assert(Um_stream_length(stream) == EXIT);
+        append(stream, halt());
+
+        char *text = malloc(size + 1);
+        assert(text != NULL);
+        for (unsigned i = 0; i < size; i++) {
+                text[i] = line[i % (sizeof(line) - 1)];
+        }
+        text[size] = '\0';
+
+        *test_input = text;
+        *expected_output = malloc(size + 1);
+        assert(*expected_output != NULL);
+        memcpy(*expected_output, text, size + 1);
+}
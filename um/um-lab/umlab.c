@@ -5,8 +5,8 @@
  * should be augmented and then linked against umlabwrite.c to produce
  * a unit test writing program.
  *  
- * A unit test is a stream of UM instructions, represented as a Hanson
- * Seq_T of 32-bit words adhering to the UM's instruction format.  
+ * A unit test is a stream of UM instructions, represented as a
+ * Um_stream of 32-bit words adhering to the UM's instruction format.  
  * 
  * Any additional functions and unit tests written for the lab go
  * here. 
@@ -17,11 +17,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <assert.h>
-#include <seq.h>
-#include <bitpack.h>
+#include "umstream.h"
 
 
-typedef uint32_t Um_instruction;
 typedef enum Um_opcode {
         CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
         NAND, HALT, ACTIVATE, INACTIVATE, OUT, IN, LOADP, LV
@@ -52,36 +50,20 @@ Um_instruction output(Um_register c);
 
 /* Functions for working with streams */
 
-static inline void append(Seq_T stream, Um_instruction inst)
+static inline void append(Um_stream stream, Um_instruction inst)
 {
-        assert(sizeof(inst) <= sizeof(uintptr_t));
-        Seq_addhi(stream, (void *)(uintptr_t)inst);
-}
-
-const uint32_t Um_word_width = 32;
-
-void Um_write_sequence(FILE *output, Seq_T stream)
-{
-        assert(output != NULL && stream != NULL);
-        int stream_length = Seq_length(stream);
-        for (int i = 0; i < stream_length; i++) {
-                Um_instruction inst = (uintptr_t)Seq_remlo(stream);
-                for (int lsb = Um_word_width - 8; lsb >= 0; lsb -= 8) {
-                        fputc(Bitpack_getu(inst, 8, lsb), output);
-                }
-        }
-      
+        Um_stream_append(stream, inst);
 }
 
 
 /* Unit tests for the UM */
 
-void build_halt_test(Seq_T stream)
+void build_halt_test(Um_stream stream)
 {
         append(stream, halt());
 }
 
-void build_verbose_halt_test(Seq_T stream)
+void build_verbose_halt_test(Um_stream stream)
 {
         append(stream, halt());
         append(stream, loadval(r1, 'B'));
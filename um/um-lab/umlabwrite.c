@@ -5,12 +5,10 @@
 
 #include "assert.h"
 #include "fmt.h"
-#include "seq.h"
+#include "umstream.h"
 
-extern void Um_write_sequence(FILE *output, Seq_T instructions);
-
-extern void build_halt_test(Seq_T instructions);
-extern void build_verbose_halt_test(Seq_T instructions);
+extern void build_halt_test(Um_stream instructions);
+extern void build_verbose_halt_test(Um_stream instructions);
 
 
 /* The array `tests` contains all unit tests for the lab. */
@@ -19,8 +17,8 @@ static struct test_info {
         const char *name;
         const char *test_input;          /* NULL means no input needed */
         const char *expected_output;
-        /* writes instructions into sequence */
-        void (*build_test)(Seq_T stream);
+        /* writes instructions into stream */
+        void (*build_test)(Um_stream stream);
 } tests[] = {
         { "halt",         NULL, "", build_halt_test },
         { "halt-verbose", NULL, "", build_verbose_halt_test }
@@ -74,10 +72,10 @@ int main (int argc, char *argv[])
 static void write_test_files(struct test_info *test)
 {
         FILE *binary = open_and_free_pathname(Fmt_string("%s.um", test->name));
-        Seq_T instructions = Seq_new(0);
+        Um_stream instructions = Um_stream_new(0);
         test->build_test(instructions);
-        Um_write_sequence(binary, instructions);
-        Seq_free(&instructions);
+        Um_stream_write(binary, instructions);
+        Um_stream_free(&instructions);
         fclose(binary);
 
         write_or_remove_file(Fmt_string("%s.0", test->name),